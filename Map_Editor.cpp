@@ -4,26 +4,283 @@
 // ============================================================================
 #include <iostream>
 #include <string>
+#include <sys/stat.h>
+#include <algorithm>
+#include <iomanip>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <cstring>
+#include <sstream>
+#include <limits>
+#include <cerrno>
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <poll.h>
+#endif
 
 #include "Map_Editor.h"
 
 bool Layout_Process();
 bool Process_Keys();
 
+Codeloader::cMap_Editor* map_editor = NULL;
+Codeloader::cCommand_Pipe* command_pipe = NULL;
+
 // **************************************************************************
 // Program Entry Point
 // **************************************************************************
 
 int main(int argc, char** argv) {
-  if (argc == 2) {
+  if ((argc >= 3) && (std::string(argv[1]) == "--batch")) { // Headless map checks.
+    try {
+      Codeloader::cMap_Checker checker("Editor_Screen", "Config", "Resources");
+      Codeloader::cArray<std::string> files;
+      int worker_count = std::thread::hardware_concurrency();
+      std::string catalog = argv[2];
+      std::string output_name = "";
+      for (int arg_index = 3; arg_index < argc; arg_index++) {
+        std::string arg = argv[arg_index];
+        if ((arg == "--convert") && (arg_index + 1 < argc)) {
+          checker.convert_folder = argv[++arg_index];
+        }
+        else if ((arg == "--jobs") && (arg_index + 1 < argc)) {
+          worker_count = Codeloader::Text_To_Number(argv[++arg_index]);
+          Codeloader::cJob_System::worker_count = worker_count;
+        }
+        else if (arg == "--overlaps") {
+          checker.find_overlaps = true;
+        }
+        else if ((arg == "--output") && (arg_index + 1 < argc)) {
+          output_name = argv[++arg_index];
+        }
+        else {
+          files.Add(arg);
+        }
+      }
+      Codeloader::sCheck_Result catalog_result = checker.Load_Catalog(catalog);
+      std::ofstream output_file;
+      if (output_name != "") {
+        output_file.open(output_name);
+      }
+      std::ostream& output = (output_name != "") ? output_file : std::cout;
+      checker.Write_Result(catalog_result, output);
+      checker.Run(files, worker_count, output);
+    }
+    catch (Codeloader::cError error) {
+      error.Print();
+      return 1;
+    }
+    return 0;
+  }
+  else if ((argc >= 3) && (std::string(argv[1]) == "--benchmark")) { // Timings on generated data.
+    try {
+      std::vector<int> sizes = { 1000, 10000, 100000, 1000000 };
+      std::vector<int> layout_sizes = { 100, 1000, 5000 };
+      int runs = 5;
+      std::string output_name = "";
+      for (int arg_index = 3; arg_index < argc; arg_index++) {
+        std::string arg = argv[arg_index];
+        if (((arg == "--sizes") || (arg == "--layout-sizes")) && (arg_index + 1 < argc)) {
+          Codeloader::cArray<std::string> values = Codeloader::Parse_Sausage_Text(argv[++arg_index], ",");
+          std::vector<int>& list = (arg == "--sizes") ? sizes : layout_sizes;
+          list.clear();
+          for (int value_index = 0; value_index < values.Count(); value_index++) {
+            list.push_back(Codeloader::Text_To_Number(values[value_index]));
+          }
+        }
+        else if ((arg == "--runs") && (arg_index + 1 < argc)) {
+          runs = Codeloader::Text_To_Number(argv[++arg_index]);
+        }
+        else if ((arg == "--output") && (arg_index + 1 < argc)) {
+          output_name = argv[++arg_index];
+        }
+      }
+      Codeloader::cBenchmark benchmark(argv[2], runs);
+      benchmark.Run_Layouts(layout_sizes);
+      benchmark.Run_Maps(sizes);
+      benchmark.Run_Overlaps(Codeloader::OVERLAP_BENCH_SPRITES, Codeloader::OVERLAP_BENCH_BUDGET_MS);
+      std::ofstream output_file;
+      if (output_name != "") {
+        output_file.open(output_name);
+      }
+      benchmark.Write_Results((output_name != "") ? output_file : std::cout);
+    }
+    catch (Codeloader::cError error) {
+      error.Print();
+      return 1;
+    }
+    return 0;
+  }
+  else if ((argc == 4) && (std::string(argv[1]) == "--diff")) { // Structural diff of two maps.
+    try {
+      std::vector<Codeloader::sMap_Record> old_records;
+      std::vector<Codeloader::sMap_Record> new_records;
+      std::vector<Codeloader::sProperty_Change> changes;
+      Codeloader::cMap_Diff::Read_Map(argv[2], old_records);
+      Codeloader::cMap_Diff::Read_Map(argv[3], new_records);
+      Codeloader::cMap_Diff::Diff(old_records, new_records, changes);
+      Codeloader::cMap_Diff::Write_Changes(changes, std::cout);
+    }
+    catch (Codeloader::cError error) {
+      error.Print();
+      return 2;
+    }
+    return 0;
+  }
+  else if ((argc == 6) && (std::string(argv[1]) == "--merge")) { // Three-way merge of two copies of a map.
+    try {
+      std::vector<Codeloader::sMap_Record> base;
+      std::vector<Codeloader::sMap_Record> ours;
+      std::vector<Codeloader::sMap_Record> theirs;
+      std::vector<Codeloader::sMap_Record> merged;
+      std::vector<Codeloader::sProperty_Change> conflicts;
+      Codeloader::cMap_Diff::Read_Map(argv[2], base);
+      Codeloader::cMap_Diff::Read_Map(argv[3], ours);
+      Codeloader::cMap_Diff::Read_Map(argv[4], theirs);
+      Codeloader::cMap_Diff::Merge(base, ours, theirs, merged, conflicts);
+      Codeloader::cMap_Diff::Write_Map(argv[5], merged);
+      Codeloader::cMap_Diff::Write_Changes(conflicts, std::cout);
+      return conflicts.empty() ? 0 : 1;
+    }
+    catch (Codeloader::cError error) {
+      error.Print();
+      return 2;
+    }
+  }
+  else if ((argc >= 4) && (std::string(argv[1]) == "--encode")) { // Rewrites maps in another encoding.
+    try {
+      Codeloader::eMap_Encoding encoding = Codeloader::cMap_Codec::Get_Encoding(argv[2]);
+      for (int arg_index = 3; arg_index < argc; arg_index++) {
+        std::string file_name = std::string(argv[arg_index]) + ".map";
+        struct stat before;
+        struct stat after;
+        std::vector<Codeloader::tObject> records;
+        Codeloader::cMap_Codec::Read_Map(file_name, records);
+        stat(file_name.c_str(), &before);
+        Codeloader::cMap_Codec::Write_Map(file_name, records, encoding);
+        stat(file_name.c_str(), &after);
+        std::cout << file_name << ": " << before.st_size << " -> " << after.st_size << " bytes" << std::endl;
+      }
+    }
+    catch (Codeloader::cError error) {
+      error.Print();
+      return 1;
+    }
+  }
+  else if ((argc == 4) && (std::string(argv[1]) == "--slice")) { // Cuts a background into streamed tiles.
+    try {
+      al_init();
+      al_init_image_addon();
+      std::string name = std::filesystem::path(argv[2]).stem().string();
+      int tile_count = Codeloader::cResource_Loader::Slice_Image(argv[2], name, Codeloader::Text_To_Number(argv[3]));
+      std::cout << name << ": " << tile_count << " tiles" << std::endl;
+    }
+    catch (Codeloader::cError error) {
+      error.Print();
+      return 1;
+    }
+  }
+  else if ((argc >= 3) && (std::string(argv[1]) == "--replay")) { // Plays a recorded session without a window.
+    try {
+      Codeloader::cReplay_IO io(argv[2]);
+      io.Load_Image_Sizes("Resources"); // Sprites and backgrounds keep their recorded sizes.
+      Codeloader::cMap_Editor editor("Editor_Screen", "Config", &io, NULL);
+      editor.uid_source.seed(0); // Placed sprites get the same ids on every run.
+      std::ofstream output_file;
+      if ((argc >= 5) && (std::string(argv[3]) == "--output")) {
+        output_file.open(argv[4]);
+      }
+      std::ostream& output = output_file.is_open() ? output_file : std::cout;
+      output << std::fixed << std::setprecision(3);
+      double total_ms = 0;
+      double worst_ms = 0;
+      while (io.Has_More_Frames()) {
+        int frame = io.frame;
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        editor.Render();
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+        total_ms += elapsed.count();
+        worst_ms = std::max(worst_ms, elapsed.count());
+        std::vector<std::string>& commands = io.frames[frame].commands;
+        bool quit = false;
+        for (int command_index = 0; command_index < (int)commands.size(); command_index++) { // Run between frames like Layout_Process.
+          editor.Run_Command(commands[command_index], quit);
+        }
+        Codeloader::cJob_System::Shared().Drain(); // Results land in the next frame on every run, not when the workers get to them.
+        output << "{\"frame\":" << frame << ",\"recorded-ms\":" << io.frames[frame].time_ms << ",\"frame-ms\":" << elapsed.count() << "}\n";
+      }
+      output << "{\"frames\":" << io.frames.size() << ",\"total-ms\":" << total_ms << ",\"worst-ms\":" << worst_ms << ",\"map-hash\":\"" << editor.Get_Map_Hash() << "\"}\n";
+    }
+    catch (Codeloader::cError error) {
+      error.Print();
+      return 1;
+    }
+  }
+  else if ((argc >= 2) && (std::string(argv[1]) == "--headless")) { // Commands without a window.
+    try {
+      Codeloader::cHeadless_IO io;
+      Codeloader::cMap_Editor editor("Editor_Screen", "Config", &io, NULL);
+      Codeloader::cCommand_Pipe pipe;
+      if ((argc >= 4) && (std::string(argv[2]) == "--socket")) {
+        pipe.Open_Socket(argv[3]);
+      }
+      else {
+        pipe.Open_Stdin();
+      }
+      std::vector<Codeloader::sCommand> batch;
+      bool quit = false;
+      while (!quit && pipe.Take_Commands(batch, true, Codeloader::COMMAND_BATCH)) {
+        int command_count = batch.size();
+        for (int command_index = 0; (command_index < command_count) && !quit; command_index++) {
+          pipe.Reply(batch[command_index], editor.Run_Command(batch[command_index].line, quit));
+        }
+      }
+    }
+    catch (Codeloader::cError error) {
+      error.Print();
+      return 1;
+    }
+    return 0;
+  }
+  else if (argc >= 2) {
     std::string map_name = argv[1];
     try {
       Codeloader::cConfig config("Config");
       int width = config.Get_Property("width");
       int height = config.Get_Property("height");
       Codeloader::cAllegro_IO allegro(map_name, width, height, 1, "Game");
-      allegro.Load_Resources("Resources");
+      Codeloader::cResource_Loader loader(&allegro, "Resources");
+      loader.Load_Sounds_And_Fonts(); // Images are decoded when a map or the palette first needs them.
+      Codeloader::cMap_Editor editor("Editor_Screen", "Config", &allegro, &loader);
+      map_editor = &editor;
+      Codeloader::cCommand_Pipe pipe;
+      std::unique_ptr<Codeloader::cSession_Recorder> recorder;
+      for (int arg_index = 2; arg_index < argc; arg_index++) {
+        std::string arg = argv[arg_index];
+        if ((arg == "--socket") && (arg_index + 1 < argc)) {
+          pipe.Open_Socket(argv[++arg_index]);
+          command_pipe = &pipe;
+        }
+        else if (arg == "--stdin") {
+          pipe.Open_Stdin();
+          command_pipe = &pipe;
+        }
+        else if ((arg == "--record") && (arg_index + 1 < argc)) { // Input of the session for replay runs.
+          recorder.reset(new Codeloader::cSession_Recorder(argv[++arg_index]));
+          editor.input.recorder = recorder.get();
+        }
+        else if ((arg == "--tile-cache") && (arg_index + 1 < argc)) { // Memory budget of background tiles in megabytes.
+          editor.tile_cache.budget = (long long)Codeloader::Text_To_Number(argv[++arg_index]) * 1024 * 1024;
+        }
+      }
       allegro.Process_Messages(Layout_Process, Process_Keys);
+      loader.Write_Load_Report("Load_Times");
+      command_pipe = NULL;
+      map_editor = NULL;
     }
     catch (Codeloader::cError error) {
       error.Print();
@@ -31,11 +288,98 @@ int main(int argc, char** argv) {
   }
   else {
     std::cout << "Usage: " << argv[0] << " <program>" << std::endl;
+    std::cout << "       " << argv[0] << " --batch <catalog> [--convert <folder>] [--jobs <count>] [--overlaps] [--output <file>] <map>..." << std::endl;
+    std::cout << "       " << argv[0] << " <program> [--stdin | --socket <path>] [--record <session>] [--tile-cache <MB>]" << std::endl;
+    std::cout << "       " << argv[0] << " --replay <session> [--output <file>]" << std::endl;
+    std::cout << "       " << argv[0] << " --headless [--socket <path>]" << std::endl;
+    std::cout << "       " << argv[0] << " --slice <image> <tile size>" << std::endl;
+    std::cout << "       " << argv[0] << " --encode <text | compact | packed> <map>..." << std::endl;
+    std::cout << "       " << argv[0] << " --diff <old map> <new map>" << std::endl;
+    std::cout << "       " << argv[0] << " --merge <base map> <our map> <their map> <merged map>" << std::endl;
+    std::cout << "       " << argv[0] << " --benchmark <folder> [--sizes <n,...>] [--layout-sizes <n,...>] [--runs <count>] [--output <file>]" << std::endl;
   }
   std::cout << "Done." << std::endl;
   return 0;
 }
 
+// ****************************************************************************
+// Allocation Counting
+// ****************************************************************************
+
+#ifndef NO_MEMORY_STATS
+
+const size_t MEMORY_HEADER = 16; // Keeps blocks aligned for any type.
+
+/**
+ * Allocates a block and counts it in the memory stats.
+ * @param size The size of the block.
+ * @return The block or NULL if there was no memory.
+ */
+static void* Counted_Alloc(size_t size) {
+  char* block = (char*)std::malloc(size + MEMORY_HEADER);
+  if (block) {
+    *(size_t*)block = size;
+    Codeloader::memory_stats.allocations++;
+    Codeloader::memory_stats.allocated_bytes += size;
+    long long live = (Codeloader::memory_stats.live_bytes += size);
+    long long peak = Codeloader::memory_stats.peak_bytes.load();
+    while ((live > peak) && !Codeloader::memory_stats.peak_bytes.compare_exchange_weak(peak, live));
+    block += MEMORY_HEADER;
+  }
+  return block;
+}
+
+/**
+ * Frees a block from Counted_Alloc.
+ * @param memory The block to free.
+ */
+static void Counted_Free(void* memory) {
+  if (memory) {
+    char* block = (char*)memory - MEMORY_HEADER;
+    Codeloader::memory_stats.frees++;
+    Codeloader::memory_stats.live_bytes -= *(size_t*)block;
+    std::free(block);
+  }
+}
+
+void* operator new(size_t size) {
+  void* memory = Counted_Alloc(size);
+  if (!memory) {
+    throw std::bad_alloc();
+  }
+  return memory;
+}
+
+void* operator new[](size_t size) {
+  return operator new(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t& tag) noexcept {
+  return Counted_Alloc(size);
+}
+
+void* operator new[](size_t size, const std::nothrow_t& tag) noexcept {
+  return Counted_Alloc(size);
+}
+
+void operator delete(void* memory) noexcept {
+  Counted_Free(memory);
+}
+
+void operator delete[](void* memory) noexcept {
+  Counted_Free(memory);
+}
+
+void operator delete(void* memory, size_t size) noexcept {
+  Counted_Free(memory);
+}
+
+void operator delete[](void* memory, size_t size) noexcept {
+  Counted_Free(memory);
+}
+
+#endif
+
 // ****************************************************************************
 // Layout Processor
 // ****************************************************************************
@@ -45,7 +389,21 @@ int main(int argc, char** argv) {
  * @return True if the app needs to exit, false otherwise.
  */
 bool Layout_Process() {
-  return false;
+  bool quit = false;
+  if (command_pipe) { // Run queued commands for a few milliseconds between frames.
+    std::vector<Codeloader::sCommand> batch;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    while (!quit && (std::chrono::steady_clock::now() - start < std::chrono::milliseconds(Codeloader::COMMAND_FRAME_MS)) && command_pipe->Take_Commands(batch, false, 1) && !batch.empty()) {
+      if (map_editor->input.recorder) { // Replays need the catalog and maps loaded by commands.
+        map_editor->input.recorder->Add_Command(batch[0].line);
+      }
+      command_pipe->Reply(batch[0], map_editor->Run_Command(batch[0].line, quit));
+    }
+  }
+  if (map_editor) {
+    map_editor->Render();
+  }
+  return quit;
 }
 
 /**
@@ -59,1190 +417,8291 @@ bool Process_Keys() {
 namespace Codeloader {
 
   // **************************************************************************
-  // Layout Implementation
+  // Arena Implementation
   // **************************************************************************
 
   /**
-   * Creates a new layout module.
-   * @param name The name of the layout file.
-   * @param config The name of the config file.
-   * @param io The I/O control.
-   * @throws An error if the layout could not be loaded.
+   * Creates an empty arena. Blocks are allocated on first use.
    */
-  cLayout::cLayout(std::string name, std::string config, cIO_Control* io) {
-    this->io = io;
-    // Load the config file.
-    cConfig layout_config(config + ".txt");
-    this->width = layout_config.Get_Property("width");
-    this->height = layout_config.Get_Property("height");
-    this->cell_w = layout_config.Get_Property("cell-w");
-    this->cell_h = layout_config.Get_Property("cell-h");
-    this->red = layout_config.Get_Property("red");
-    this->green = layout_config.Get_Property("green");
-    this->blue = layout_config.Get_Property("blue");
-    this->mouse_coords.x = 0;
-    this->mouse_coords.y = 0;
-    this->not_clicked = true;
-    // Recalculate dimensions to grid dimensions.
-    this->width /= this->cell_w;
-    this->height /= this->cell_h;
-    // Create the grid.
-    this->grid = new char* [this->height];
-    for (int row_index = 0; row_index < this->height; row_index++) {
-      this->grid[row_index] = new char[this->width];
-      for (int col_index = 0; col_index < this->width; col_index++) {
-        this->grid[row_index][col_index] = ' ';
-      }
-    }
-    // Load the layout.
-    this->Parse_Layout(name);
+  cArena::cArena() {
+    this->block_size = 65536;
+    this->used = 0;
+    this->capacity = 0;
+    this->allocations = 0;
+    this->free_bytes = 0;
   }
 
   /**
-   * Frees the layout module.
+   * Frees all blocks of the arena.
    */
-  cLayout::~cLayout() {
-    for (int row_index = 0; row_index < this->height; row_index++) {
-      delete[] this->grid[row_index];
+  cArena::~cArena() {
+    this->Clear();
+  }
+
+  /**
+   * Allocates memory from the current block, starting a new block when it
+   * is full. Memory is only returned by Clear.
+   * @param size The number of bytes.
+   * @return The memory aligned for any property type.
+   */
+  void* cArena::Allocate(size_t size) {
+    size = (size + 7) & ~(size_t)7;
+    if ((this->blocks.empty()) || (this->used + size > this->capacity)) {
+      this->capacity = std::max(this->block_size, size);
+      this->blocks.push_back(new char[this->capacity]);
+      this->block_sizes.push_back(this->capacity);
+      this->used = 0;
     }
-    delete[] this->grid;
+    void* memory = this->blocks.back() + this->used;
+    this->used += size;
+    this->allocations++;
+    return memory;
   }
 
   /**
-   * Clears out the grid.
+   * Allocates memory, reusing memory of the same size that was released.
+   * @param size The number of bytes.
+   * @return The memory aligned for any property type.
    */
-  void cLayout::Clear_Grid() {
-    for (int row_index = 0; row_index < this->height; row_index++) {
-      for (int col_index = 0; col_index < this->width; col_index++) {
-        this->grid[row_index][col_index] = ' ';
-      }
+  void* cArena::Reuse(size_t size) {
+    size_t slot = (size + 7) >> 3;
+    if ((slot < this->free_lists.size()) && !this->free_lists[slot].empty()) {
+      void* memory = this->free_lists[slot].back();
+      this->free_lists[slot].pop_back();
+      this->free_bytes -= slot << 3;
+      return memory;
     }
+    return this->Allocate(size);
   }
 
   /**
-   * Parses the grid given the layout.
-   * @param file The instance of the layout file.
-   * @throws An error if the grid could not be loaded.
+   * Keeps memory that is no longer used for the next Reuse of the same size.
+   * @param memory The memory from Allocate or Reuse.
+   * @param size The number of bytes it was allocated with.
    */
-  void cLayout::Parse_Grid(cFile& file) {
-    for (int row_index = 0; row_index < this->height; row_index++) {
-      std::string line = file.Get_Line();
-      int col_count = (line.length() > this->width) ? this->width : line.length();
-      for (int col_index = 0; col_index < col_count; col_index++) {
-        char letter = line[col_index];
-        this->grid[row_index][col_index] = letter;
+  void cArena::Release(void* memory, size_t size) {
+    size_t slot = (size + 7) >> 3;
+    if (memory && (slot > 0)) {
+      if (slot >= this->free_lists.size()) {
+        this->free_lists.resize(slot + 1);
       }
+      this->free_lists[slot].push_back(memory);
+      this->free_bytes += slot << 3;
     }
   }
 
   /**
-   * Parses the layout.
-   * @param name The name of the layout.
-   * @throws An error if something went wrong.
+   * Keeps a string until the arena is cleared.
+   * @param text The string.
+   * @return The index of the string.
    */
-  void cLayout::Parse_Layout(std::string name) {
-    cFile layout_file(name + ".txt");
-    layout_file.Read();
-    // Parse grid first.
-    this->Parse_Grid(layout_file);
-    // Parse the entities.
-    while (this->Has_Entity()) {
-      this->Parse_Entity();
+  int cArena::Add_Text(const std::string& text) {
+    this->texts.push_back(text);
+    return this->texts.size() - 1;
+  }
+
+  /**
+   * Gets a string kept by the arena.
+   * @param index The index of the string.
+   * @return The string.
+   */
+  const std::string& cArena::Get_Text(int index) {
+    return this->texts[index];
+  }
+
+  /**
+   * Copies a string into the arena.
+   * @param text The string to copy.
+   * @return The null terminated copy.
+   */
+  const char* cArena::Copy_String(const std::string& text) {
+    char* copy = (char*)this->Allocate(text.length() + 1);
+    std::copy(text.begin(), text.end(), copy);
+    copy[text.length()] = '\0';
+    return copy;
+  }
+
+  /**
+   * Releases every block at once. Anything pointing into the arena is
+   * invalid afterwards.
+   */
+  void cArena::Clear() {
+    int block_count = this->blocks.size();
+    for (int block_index = 0; block_index < block_count; block_index++) {
+      delete[] this->blocks[block_index];
     }
-    // Parse the properties here!
-    this->Parse_Properties(layout_file);
-    // Run all component initializers.
-    int comp_count = this->components.Count();
-    for (int comp_index = 0; comp_index < comp_count; comp_index++) {
-      this->On_Component_Init(this->components.values[comp_index]);
+    this->blocks.clear();
+    this->block_sizes.clear();
+    this->texts.clear();
+    this->free_lists.clear();
+    this->free_bytes = 0;
+    this->used = 0;
+    this->capacity = 0;
+    this->allocations = 0;
+  }
+
+  /**
+   * Gets the number of bytes reserved by the arena.
+   * @return The size of all blocks.
+   */
+  long long cArena::Get_Bytes() {
+    long long bytes = 0;
+    int block_count = this->block_sizes.size();
+    for (int block_index = 0; block_index < block_count; block_index++) { // Any block can be oversized.
+      bytes += this->block_sizes[block_index];
     }
-    // Run layout initializer.
-    this->On_Init();
+    return bytes;
   }
 
   /**
-   * Checks to see if there is an entity to parse.
-   * @return True if there is an entity, false otherwise.
+   * Swaps the blocks of two arenas.
+   * @param other The other arena.
    */
-  bool cLayout::Has_Entity() {
-    bool has_entity = false;
-    for (int cell_y = 0; cell_y < this->height; cell_y++) {
-      for (int cell_x = 0; cell_x < this->width; cell_x++) {
-        char cell = this->grid[cell_y][cell_x];
-        if ((cell == '[') || (cell == '{') || (cell == '(') || (cell == '+')) { // Entity identifier.
-          has_entity = true;
-          break;
+  void cArena::Swap(cArena& other) {
+    std::swap(this->blocks, other.blocks);
+    std::swap(this->block_sizes, other.block_sizes);
+    std::swap(this->texts, other.texts);
+    std::swap(this->free_lists, other.free_lists);
+    std::swap(this->free_bytes, other.free_bytes);
+    std::swap(this->block_size, other.block_size);
+    std::swap(this->used, other.used);
+    std::swap(this->capacity, other.capacity);
+    std::swap(this->allocations, other.allocations);
+  }
+
+  // **************************************************************************
+  // Sprite Implementation
+  // **************************************************************************
+
+  /**
+   * Creates an empty sprite with no prototype.
+   */
+  cSprite::cSprite() {
+    this->catalog = NULL;
+    this->arena = NULL;
+    this->proto = NO_VALUE_FOUND;
+    this->overrides = NULL;
+    this->override_count = 0;
+    this->override_capacity = 0;
+    this->alive = true;
+  }
+
+  /**
+   * Creates a sprite that references a catalog prototype.
+   * @param catalog The catalog index holding the parsed prototype.
+   * @param arena The arena holding the overrides of the map.
+   * @param proto The index of the prototype in the catalog or NO_VALUE_FOUND.
+   */
+  cSprite::cSprite(cCatalog_Index* catalog, cArena* arena, int proto) {
+    this->catalog = catalog;
+    this->arena = arena;
+    this->proto = proto;
+    this->overrides = NULL;
+    this->override_count = 0;
+    this->override_capacity = 0;
+    this->alive = true;
+  }
+
+  /**
+   * Determines if the sprite or its prototype has a property.
+   * @param key The name of the property.
+   * @return True if the property exists, false otherwise.
+   */
+  bool cSprite::Does_Key_Exist(std::string key) {
+    int id = string_table.Find(key);
+    return (id != NO_VALUE_FOUND) && this->Does_Key_Exist(id); // Stored keys are always interned.
+  }
+
+  /**
+   * Determines if the sprite or its prototype has a property.
+   * @param key The interned name of the property.
+   * @return True if the property exists, false otherwise.
+   */
+  bool cSprite::Does_Key_Exist(int key) {
+    return (this->Find_Property(key) != NULL);
+  }
+
+  /**
+   * Gets a property. Reads fall through to the prototype when not overridden.
+   * @param key The name of the property.
+   * @return The value of the property.
+   * @throws An error if the property does not exist.
+   */
+  cValue cSprite::Get(std::string key) {
+    int id = string_table.Find(key);
+    Check_Condition((id != NO_VALUE_FOUND), "Property " + key + " not found in sprite.");
+    return this->Get(id);
+  }
+
+  /**
+   * Gets a property by its interned name.
+   * @param key The interned name of the property.
+   * @return The value of the property.
+   * @throws An error if the property does not exist.
+   */
+  cValue cSprite::Get(int key) {
+    sSprite_Property* property = this->Find_Property(key);
+    Check_Condition((property != NULL), "Property " + string_table.Get_String(key) + " not found in sprite.");
+    return this->Get_Value(*property);
+  }
+
+  /**
+   * Gets a string property without copying it.
+   * @param key The interned name of the property.
+   * @return The text of the property. It is valid until the property changes.
+   * @throws An error if the property does not exist or is a number.
+   */
+  const std::string& cSprite::Get_Text(int key) {
+    sSprite_Property* property = this->Find_Property(key);
+    Check_Condition((property != NULL), "Property " + string_table.Get_String(key) + " not found in sprite.");
+    Check_Condition((property->text != NO_VALUE_FOUND), "Property " + string_table.Get_String(key) + " is not a string.");
+    return this->Get_Text(*property);
+  }
+
+  /**
+   * Finds a property in the overrides, then in the prototype.
+   * @param key The interned name of the property.
+   * @return The property or NULL if there is none.
+   */
+  sSprite_Property* cSprite::Find_Property(int key) {
+    int index = this->Find_Override(key);
+    if (index != NO_VALUE_FOUND) {
+      return &this->overrides[index];
+    }
+    if (this->proto != NO_VALUE_FOUND) {
+      std::vector<sSprite_Property>& properties = this->catalog->entries[this->proto].properties;
+      int prop_count = properties.size();
+      for (int prop_index = 0; prop_index < prop_count; prop_index++) {
+        if (properties[prop_index].key == key) {
+          return &properties[prop_index];
         }
       }
     }
-    return has_entity;
+    return NULL;
   }
 
   /**
-   * Parses an entity and adds it to the component stack.
+   * Sets a property on this instance only. The prototype is never modified.
+   * An existing override is changed in place. A new one grows the array and
+   * the old array is released to the arena for reuse.
+   * @param key The name of the property.
+   * @param value The value to set.
+   * @throws An error if the sprite has no arena.
+   */
+  void cSprite::Set(std::string key, cValue value) {
+    Check_Condition((this->arena != NULL), "Sprite has no arena for property " + key + ".");
+    int id = string_table.Intern(key);
+    int index = this->Find_Override(id);
+    if (index == NO_VALUE_FOUND) {
+      if (this->override_count == this->override_capacity) {
+        int capacity = this->override_capacity + 1;
+        sSprite_Property* properties = (sSprite_Property*)this->arena->Reuse(capacity * sizeof(sSprite_Property));
+        std::copy(this->overrides, this->overrides + this->override_count, properties);
+        this->arena->Release(this->overrides, this->override_capacity * sizeof(sSprite_Property));
+        this->overrides = properties;
+        this->override_capacity = capacity;
+      }
+      index = this->override_count++;
+    }
+    this->overrides[index] = this->Make_Override(id, value, index);
+  }
+
+  /**
+   * Gives the sprite its own copy of its overrides. Copies of a sprite share
+   * the array, so a copy that is kept in another slot must be detached
+   * before it is changed.
+   * @throws An error if the sprite has overrides but no arena.
+   */
+  void cSprite::Detach() {
+    if (this->override_count > 0) {
+      Check_Condition((this->arena != NULL), "Sprite has no arena.");
+      sSprite_Property* properties = (sSprite_Property*)this->arena->Reuse(this->override_count * sizeof(sSprite_Property));
+      std::copy(this->overrides, this->overrides + this->override_count, properties);
+      for (int prop_index = 0; prop_index < this->override_count; prop_index++) { // Ids in the arena are changed in place too.
+        if (properties[prop_index].text <= ARENA_TEXT) {
+          properties[prop_index].text = ARENA_TEXT - this->arena->Add_Text(this->Get_Text(properties[prop_index]));
+        }
+      }
+      this->overrides = properties;
+    }
+    else {
+      this->overrides = NULL;
+    }
+    this->override_capacity = this->override_count;
+  }
+
+  /**
+   * Sets all overrides from a map record in one allocation.
+   * @param record The record. The sprite-id key is skipped.
+   * @throws An error if the sprite has no arena.
+   */
+  void cSprite::Set_Overrides(tObject& record) {
+    Check_Condition((this->arena != NULL), "Sprite has no arena.");
+    int prop_count = record.Count();
+    this->overrides = (sSprite_Property*)this->arena->Allocate(prop_count * sizeof(sSprite_Property));
+    this->override_count = 0;
+    this->override_capacity = prop_count;
+    for (int prop_index = 0; prop_index < prop_count; prop_index++) {
+      int key = string_table.Intern(record.keys[prop_index]);
+      if (key != eKEY_SPRITE_ID) {
+        this->overrides[this->override_count] = this->Make_Override(key, record.values[prop_index], this->override_count);
+        this->override_count++;
+      }
+    }
+  }
+
+  /**
+   * Finds an overridden property.
+   * @param key The interned name of the property.
+   * @return The index of the override or NO_VALUE_FOUND.
+   */
+  int cSprite::Find_Override(int key) {
+    int index = NO_VALUE_FOUND;
+    for (int prop_index = 0; prop_index < this->override_count; prop_index++) {
+      if (this->overrides[prop_index].key == key) {
+        index = prop_index;
+        break;
+      }
+    }
+    return index;
+  }
+
+  /**
+   * Determines if this instance overrides a property.
+   * @param key The name of the property.
+   * @return True if the property is overridden.
+   */
+  bool cSprite::Has_Override(std::string key) {
+    int id = string_table.Find(key);
+    return (id != NO_VALUE_FOUND) && (this->Find_Override(id) != NO_VALUE_FOUND);
+  }
+
+  /**
+   * Removes an override so reads fall back to the prototype. The array keeps
+   * its capacity for the next new override.
+   * @param key The name of the property.
+   */
+  void cSprite::Remove_Override(std::string key) {
+    int id = string_table.Find(key);
+    int index = (id != NO_VALUE_FOUND) ? this->Find_Override(id) : NO_VALUE_FOUND;
+    if (index != NO_VALUE_FOUND) {
+      std::copy(this->overrides + index + 1, this->overrides + this->override_count, this->overrides + index);
+      this->override_count--;
+    }
+  }
+
+  /**
+   * Gets the catalog name of the prototype.
+   * @return The catalog name or an empty string if there is no prototype.
+   */
+  std::string cSprite::Get_Sprite_Id() {
+    return (this->proto != NO_VALUE_FOUND) ? this->catalog->entries[this->proto].name : "";
+  }
+
+  /**
+   * Gets the record that is written to the map file.
+   * @return The overrides with the prototype reference.
+   */
+  tObject cSprite::Get_Record() {
+    tObject record;
+    for (int prop_index = 0; prop_index < this->override_count; prop_index++) {
+      record[string_table.Get_String(this->overrides[prop_index].key)] = this->Get_Value(this->overrides[prop_index]);
+    }
+    if (this->proto != NO_VALUE_FOUND) {
+      record["sprite-id"].Set_String(this->Get_Sprite_Id());
+    }
+    return record;
+  }
+
+  /**
+   * Flattens the prototype and overrides into one object.
+   * @return The object with all properties.
+   */
+  tObject cSprite::Flatten() {
+    tObject object;
+    if (this->proto != NO_VALUE_FOUND) {
+      std::vector<sSprite_Property>& properties = this->catalog->entries[this->proto].properties;
+      int prop_count = properties.size();
+      for (int prop_index = 0; prop_index < prop_count; prop_index++) {
+        object[string_table.Get_String(properties[prop_index].key)] = this->Get_Value(properties[prop_index]);
+      }
+    }
+    for (int prop_index = 0; prop_index < this->override_count; prop_index++) {
+      object[string_table.Get_String(this->overrides[prop_index].key)] = this->Get_Value(this->overrides[prop_index]);
+    }
+    return object;
+  }
+
+  /**
+   * Counts the bytes held by this instance and its overrides. Interned
+   * strings are shared and counted with the string table.
+   * @return The size in bytes.
+   */
+  int cSprite::Measure() {
+    return sizeof(cSprite) + this->override_count * sizeof(sSprite_Property);
+  }
+
+  /**
+   * Converts a property to a value.
+   * @param property The property.
+   * @return The number or string value.
+   */
+  cValue cSprite::Get_Value(sSprite_Property& property) {
+    return (property.text != NO_VALUE_FOUND) ? cValue(this->Get_Text(property)) : cValue(property.number);
+  }
+
+  /**
+   * Gets the text of a string property. Ids are kept in the arena of the map,
+   * other strings in the string table.
+   * @param property The property.
+   * @return The text.
+   */
+  const std::string& cSprite::Get_Text(sSprite_Property& property) {
+    return (property.text <= ARENA_TEXT) ? this->arena->Get_Text(ARENA_TEXT - property.text) : string_table.Get_String(property.text);
+  }
+
+  /**
+   * Converts a value to an override of this sprite. Ids are unique, so they
+   * are kept in the arena of the map instead of the shared string table.
+   * @param key The interned name of the property.
+   * @param value The value.
+   * @param index The index of the override being replaced or added.
+   * @return The property.
+   */
+  sSprite_Property cSprite::Make_Override(int key, cValue& value, int index) {
+    if ((key != eKEY_UID) || (value.type == eVALUE_NUMBER) || (this->arena == NULL)) {
+      return Make_Property(key, value);
+    }
+    int text = NO_VALUE_FOUND;
+    if ((index < this->override_count) && (this->overrides[index].text <= ARENA_TEXT)) { // Replaced in place.
+      text = ARENA_TEXT - this->overrides[index].text;
+      this->arena->texts[text] = value.string;
+    }
+    else {
+      text = this->arena->Add_Text(value.string);
+    }
+    sSprite_Property property = { key, ARENA_TEXT - text, 0 };
+    return property;
+  }
+
+  /**
+   * Converts a value to a prototype property, interning string values.
+   * @param key The interned name of the property.
+   * @param value The value.
+   * @return The property.
+   */
+  sSprite_Property cSprite::Make_Property(int key, cValue& value) {
+    sSprite_Property property = { key, (value.type == eVALUE_NUMBER) ? NO_VALUE_FOUND : string_table.Intern(value.string), value.number };
+    return property;
+  }
+
+  // **************************************************************************
+  // String Table Implementation
+  // **************************************************************************
+
+  cString_Table string_table;
+
+  /**
+   * Creates the string table with the keys used by the editor hot paths at
+   * fixed ids so they can be looked up without hashing.
+   */
+  cString_Table::cString_Table() {
+    const char* keys[] = { "x", "y", "layer", "icon", "width", "height", "bump-map", "sprite-id", "uid" };
+    for (int key_index = 0; key_index <= eKEY_UID; key_index++) {
+      this->Intern(keys[key_index]);
+    }
+  }
+
+  /**
+   * Gets the id of a string, adding it to the table if it is new. Strings are
+   * only interned on the main thread.
+   * @param text The string.
+   * @return The id of the string.
+   */
+  int cString_Table::Intern(const std::string& text) {
+    std::unordered_map<std::string, int>::iterator entry = this->ids.find(text);
+    if (entry != this->ids.end()) {
+      return entry->second;
+    }
+    int id = this->strings.size();
+    this->strings.push_back(text);
+    this->ids[text] = id;
+    return id;
+  }
+
+  /**
+   * Gets the id of a string without adding it.
+   * @param text The string.
+   * @return The id or NO_VALUE_FOUND if the string was never interned.
+   */
+  int cString_Table::Find(const std::string& text) {
+    std::unordered_map<std::string, int>::iterator entry = this->ids.find(text);
+    return (entry != this->ids.end()) ? entry->second : NO_VALUE_FOUND;
+  }
+
+  /**
+   * Gets the string of an id.
+   * @param id The id of the string.
+   * @return The string.
+   */
+  const std::string& cString_Table::Get_String(int id) {
+    return this->strings[id];
+  }
+
+  // **************************************************************************
+  // History Implementation
+  // **************************************************************************
+
+  /**
+   * Creates an empty edit history.
+   */
+  cHistory::cHistory() {
+    this->next_group = 0;
+    this->open_group = NO_VALUE_FOUND;
+  }
+
+  /**
+   * Records an edit that was applied. New edits discard the redo stack.
+   * @param edit The edit to record.
+   */
+  void cHistory::Record(sEdit edit) {
+    edit.group = (this->open_group != NO_VALUE_FOUND) ? this->open_group : this->next_group++;
+    this->undo_stack.push_back(edit);
+    this->redo_stack.clear();
+  }
+
+  /**
+   * Starts a group of edits that are undone together.
+   */
+  void cHistory::Begin_Group() {
+    this->open_group = this->next_group++;
+  }
+
+  /**
+   * Ends the current group of edits.
+   */
+  void cHistory::End_Group() {
+    this->open_group = NO_VALUE_FOUND;
+  }
+
+  /**
+   * Forgets every edit.
+   */
+  void cHistory::Clear() {
+    this->undo_stack.clear();
+    this->redo_stack.clear();
+    this->open_group = NO_VALUE_FOUND;
+  }
+
+  // **************************************************************************
+  // Tile Layer Implementation
+  // **************************************************************************
+
+  /**
+   * Creates an empty tile layer.
+   */
+  cTile_Layer::cTile_Layer() {
+    this->cell_w = 16;
+    this->cell_h = 16;
+    this->columns = 0;
+    this->rows = 0;
+  }
+
+  /**
+   * Resizes the layer, keeping the cells that still fit.
+   * @param columns The number of columns.
+   * @param rows The number of rows.
+   */
+  void cTile_Layer::Resize(int columns, int rows) {
+    std::vector<int> cells(columns * rows, NO_VALUE_FOUND);
+    int copy_rows = std::min(rows, this->rows);
+    int copy_cols = std::min(columns, this->columns);
+    for (int row = 0; row < copy_rows; row++) {
+      std::copy(this->cells.begin() + row * this->columns, this->cells.begin() + row * this->columns + copy_cols, cells.begin() + row * columns);
+    }
+    this->cells.swap(cells);
+    this->columns = columns;
+    this->rows = rows;
+  }
+
+  /**
+   * Determines if a cell is in the layer.
+   * @param column The column of the cell.
+   * @param row The row of the cell.
+   * @return True if the cell is inside.
+   */
+  bool cTile_Layer::Is_Inside(int column, int row) {
+    return ((column >= 0) && (column < this->columns) && (row >= 0) && (row < this->rows));
+  }
+
+  /**
+   * Gets a cell.
+   * @param column The column of the cell.
+   * @param row The row of the cell.
+   * @return The catalog index in the cell or NO_VALUE_FOUND.
+   */
+  int cTile_Layer::Get(int column, int row) {
+    return this->Is_Inside(column, row) ? this->cells[row * this->columns + column] : NO_VALUE_FOUND;
+  }
+
+  /**
+   * Sets a cell and records the change.
+   * @param column The column of the cell.
+   * @param row The row of the cell.
+   * @param value The catalog index or NO_VALUE_FOUND to erase.
+   * @param changes Receives the cell, old value and new value.
+   */
+  void cTile_Layer::Set(int column, int row, int value, std::vector<int>& changes) {
+    if (this->Is_Inside(column, row)) {
+      int cell = row * this->columns + column;
+      if (this->cells[cell] != value) {
+        changes.push_back(cell);
+        changes.push_back(this->cells[cell]);
+        changes.push_back(value);
+        this->cells[cell] = value;
+      }
+    }
+  }
+
+  /**
+   * Paints a square brush centered on a cell.
+   * @param column The column of the cell.
+   * @param row The row of the cell.
+   * @param size The width of the brush in cells.
+   * @param value The catalog index to paint.
+   * @param changes Receives the changes.
+   */
+  void cTile_Layer::Paint(int column, int row, int size, int value, std::vector<int>& changes) {
+    int half = size / 2;
+    this->Fill_Rectangle(column - half, row - half, column - half + size - 1, row - half + size - 1, value, changes);
+  }
+
+  /**
+   * Fills a rectangle of cells.
+   * @param left The first column.
+   * @param top The first row.
+   * @param right The last column.
+   * @param bottom The last row.
+   * @param value The catalog index to fill with.
+   * @param changes Receives the changes.
+   */
+  void cTile_Layer::Fill_Rectangle(int left, int top, int right, int bottom, int value, std::vector<int>& changes) {
+    for (int row = std::max(0, top); row <= std::min(this->rows - 1, bottom); row++) {
+      for (int column = std::max(0, left); column <= std::min(this->columns - 1, right); column++) {
+        this->Set(column, row, value, changes);
+      }
+    }
+  }
+
+  /**
+   * Flood fills the connected cells that match the starting cell.
+   * @param column The column of the starting cell.
+   * @param row The row of the starting cell.
+   * @param value The catalog index to fill with.
+   * @param changes Receives the changes.
+   */
+  void cTile_Layer::Flood_Fill(int column, int row, int value, std::vector<int>& changes) {
+    if (!this->Is_Inside(column, row)) {
+      return;
+    }
+    int target = this->Get(column, row);
+    if (target == value) {
+      return;
+    }
+    std::vector<int> stack;
+    stack.push_back(row * this->columns + column);
+    while (!stack.empty()) {
+      int cell = stack.back();
+      stack.pop_back();
+      int cell_x = cell % this->columns;
+      int cell_y = cell / this->columns;
+      if (this->cells[cell] != target) {
+        continue;
+      }
+      this->Set(cell_x, cell_y, value, changes);
+      if (cell_x > 0) {
+        stack.push_back(cell - 1);
+      }
+      if (cell_x < this->columns - 1) {
+        stack.push_back(cell + 1);
+      }
+      if (cell_y > 0) {
+        stack.push_back(cell - this->columns);
+      }
+      if (cell_y < this->rows - 1) {
+        stack.push_back(cell + this->columns);
+      }
+    }
+  }
+
+  // **************************************************************************
+  // Spatial Grid Implementation
+  // **************************************************************************
+
+  /**
+   * Creates an empty spatial grid that is built on first use.
+   */
+  cSpatial_Grid::cSpatial_Grid() {
+    this->cell_size = 128;
+    this->dirty = true;
+    this->stamp = 0;
+    this->margin = 0;
+  }
+
+  /**
+   * Rebuilds the bounds and cells of a layer in one pass.
+   * @param sprites The sprites of the layer.
+   */
+  void cSpatial_Grid::Build(tSprite_List& sprites) {
+    int sprite_count = sprites.Count();
+    this->bounds.assign(sprite_count, sRectangle());
+    this->has_bounds.assign(sprite_count, false);
+    this->stamps.assign(sprite_count, 0);
+    this->stamp = 0;
+    this->margin = 0;
+    this->cells.clear();
+    for (int sprite_index = 0; sprite_index < sprite_count; sprite_index++) {
+      cSprite& sprite = sprites[sprite_index];
+      if (sprite.alive && Get_Bounds(sprite, this->bounds[sprite_index])) {
+        sRectangle& box = this->bounds[sprite_index];
+        this->has_bounds[sprite_index] = true;
+        if (sprite.Does_Key_Exist(eKEY_WIDTH) && sprite.Does_Key_Exist(eKEY_HEIGHT)) { // Images can reach past the bump map.
+          this->margin = std::max(this->margin, std::max(sprite.Get(eKEY_WIDTH).number, sprite.Get(eKEY_HEIGHT).number));
+        }
+        for (int cell_y = box.top / this->cell_size; cell_y <= box.bottom / this->cell_size; cell_y++) {
+          for (int cell_x = box.left / this->cell_size; cell_x <= box.right / this->cell_size; cell_x++) {
+            this->cells[Get_Cell_Key(cell_x, cell_y)].push_back(sprite_index);
+          }
+        }
+      }
+    }
+    this->dirty = false;
+  }
+
+  /**
+   * Finds the sprites whose bounds touch an area.
+   * @param area The area in map coordinates.
+   * @param found The indices of the sprites that were found, in layer order.
+   */
+  void cSpatial_Grid::Query(sRectangle area, std::vector<int>& found) {
+    this->stamp++; // Marks sprites already reported by another cell.
+    int first = found.size();
+    for (int cell_y = area.top / this->cell_size; cell_y <= area.bottom / this->cell_size; cell_y++) {
+      for (int cell_x = area.left / this->cell_size; cell_x <= area.right / this->cell_size; cell_x++) {
+        std::unordered_map<long long, std::vector<int>>::iterator cell = this->cells.find(Get_Cell_Key(cell_x, cell_y));
+        if (cell == this->cells.end()) {
+          continue;
+        }
+        int cell_count = cell->second.size();
+        for (int cell_index = 0; cell_index < cell_count; cell_index++) {
+          int sprite_index = cell->second[cell_index];
+          sRectangle& box = this->bounds[sprite_index];
+          if ((this->stamps[sprite_index] != this->stamp) && (box.left <= area.right) && (box.right >= area.left) && (box.top <= area.bottom) && (box.bottom >= area.top)) {
+            this->stamps[sprite_index] = this->stamp;
+            found.push_back(sprite_index);
+          }
+        }
+      }
+    }
+    std::sort(found.begin() + first, found.end());
+  }
+
+  /**
+   * Gets the bounds of a sprite in map coordinates from its bump map, or
+   * from its size when it has no bump map.
+   * @param sprite The sprite.
+   * @param bounds The bounds output.
+   * @return True if the sprite has bounds.
+   */
+  bool cSpatial_Grid::Get_Bounds(cSprite& sprite, sRectangle& bounds) {
+    bool has_bounds = false;
+    if (sprite.Does_Key_Exist(eKEY_X) && sprite.Does_Key_Exist(eKEY_Y)) {
+      int x = sprite.Get(eKEY_X).number;
+      int y = sprite.Get(eKEY_Y).number;
+      if (sprite.Does_Key_Exist(eKEY_BUMP_MAP)) {
+        bounds = cMap_Editor::Parse_Rectangle(sprite.Get_Text(eKEY_BUMP_MAP));
+        has_bounds = true;
+      }
+      else if (sprite.Does_Key_Exist(eKEY_WIDTH) && sprite.Does_Key_Exist(eKEY_HEIGHT)) {
+        bounds.left = 0;
+        bounds.top = 0;
+        bounds.right = sprite.Get(eKEY_WIDTH).number - 1;
+        bounds.bottom = sprite.Get(eKEY_HEIGHT).number - 1;
+        has_bounds = true;
+      }
+      bounds.left += x;
+      bounds.right += x;
+      bounds.top += y;
+      bounds.bottom += y;
+    }
+    return has_bounds;
+  }
+
+  /**
+   * Packs cell coordinates into one key.
+   * @param cell_x The cell column.
+   * @param cell_y The cell row.
+   * @return The key of the cell.
+   */
+  long long cSpatial_Grid::Get_Cell_Key(int cell_x, int cell_y) {
+    return (long long)(((unsigned long long)(unsigned int)cell_y << 32) | (unsigned int)cell_x); // Shifting a negative row is undefined.
+  }
+
+  // **************************************************************************
+  // Z-Order Implementation
+  // **************************************************************************
+
+  /**
+   * Sorts the sprites of a layer back to front. Sprites with equal keys keep
+   * their insertion order.
+   * @param sprites The sprites of the layer.
+   * @param sort_key Either y or z.
+   */
+  void cZ_Order::Build(tSprite_List& sprites, std::string sort_key) {
+    int sprite_count = sprites.Count();
+    this->sort_key = sort_key;
+    this->keys.resize(sprite_count);
+    this->order.resize(sprite_count);
+    this->ranks.resize(sprite_count);
+    for (int sprite_index = 0; sprite_index < sprite_count; sprite_index++) {
+      this->keys[sprite_index] = Get_Key(sprites[sprite_index], sort_key);
+      this->order[sprite_index] = sprite_index;
+    }
+    std::sort(this->order.begin(), this->order.end(), [this](int a, int b) { return this->Is_Before(a, b); });
+    for (int rank = 0; rank < sprite_count; rank++) {
+      this->ranks[this->order[rank]] = rank;
+    }
+  }
+
+  /**
+   * Moves a sprite to its place after its key changed or it was added to the
+   * end of the layer. Only the sprites it passes are touched, which is few
+   * while a sprite is dragged.
+   * @param sprites The sprites of the layer.
+   * @param index The index of the sprite.
+   */
+  void cZ_Order::Update(tSprite_List& sprites, int index) {
+    if (index == (int)this->keys.size()) { // Newly added, so it starts out last in draw order and sinks into place.
+      this->keys.push_back(0);
+      this->order.push_back(index);
+      this->ranks.push_back(index);
+    }
+    this->keys[index] = Get_Key(sprites[index], this->sort_key);
+    int last = this->order.size() - 1;
+    int rank = this->ranks[index];
+    while ((rank > 0) && this->Is_Before(index, this->order[rank - 1])) {
+      this->order[rank] = this->order[rank - 1];
+      this->ranks[this->order[rank]] = rank;
+      rank--;
+    }
+    while ((rank < last) && this->Is_Before(this->order[rank + 1], index)) {
+      this->order[rank] = this->order[rank + 1];
+      this->ranks[this->order[rank]] = rank;
+      rank++;
+    }
+    this->order[rank] = index;
+    this->ranks[index] = rank;
+  }
+
+  /**
+   * Determines if a sprite is drawn before another.
+   * @param a The index of the first sprite.
+   * @param b The index of the second sprite.
+   * @return True if the first sprite is further back.
+   */
+  bool cZ_Order::Is_Before(int a, int b) {
+    return ((this->keys[a] < this->keys[b]) || ((this->keys[a] == this->keys[b]) && (a < b)));
+  }
+
+  /**
+   * Gets the sort key of a sprite.
+   * @param sprite The sprite.
+   * @param sort_key Either y or z. Sprites without a z property are at 0.
+   * @return The key.
+   */
+  int cZ_Order::Get_Key(cSprite& sprite, std::string& sort_key) {
+    if (sort_key == "y") {
+      return sprite.Does_Key_Exist(eKEY_Y) ? sprite.Get(eKEY_Y).number : 0;
+    }
+    return sprite.Does_Key_Exist("z") ? sprite.Get("z").number : 0;
+  }
+
+  // **************************************************************************
+  // Overlap Finder Implementation
+  // **************************************************************************
+
+  /**
+   * Adds a box to test.
+   * @param box The box in map coordinates.
+   * @param layer The layer of the sprite.
+   * @param index The index of the sprite.
+   */
+  void cOverlap_Finder::Add(sRectangle box, int layer, int index) {
+    sBox entry = { box, layer, index };
+    this->boxes.push_back(entry);
+  }
+
+  /**
+   * Finds every pair of overlapping boxes. The map is cut into horizontal
+   * bands that are swept in parallel.
+   * @param overlaps Receives the pairs, sorted by layer and index.
+   * @param worker_count The number of worker threads.
+   */
+  void cOverlap_Finder::Find(std::vector<sOverlap>& overlaps, int worker_count) {
+    overlaps.clear();
+    int box_count = this->boxes.size();
+    if (box_count < 2) {
+      return;
+    }
+    int top = this->boxes[0].box.top;
+    int bottom = this->boxes[0].box.bottom;
+    for (int box_index = 1; box_index < box_count; box_index++) {
+      top = std::min(top, this->boxes[box_index].box.top);
+      bottom = std::max(bottom, this->boxes[box_index].box.bottom);
+    }
+    int band_count = (worker_count > 1) ? worker_count * 4 : 1;
+    int band_height = (bottom - top) / band_count + 1;
+    std::vector<std::vector<sOverlap>> band_overlaps(band_count);
+    if (band_count == 1) {
+      this->Sweep(top, bottom, band_overlaps[0]);
+    }
+    else {
+      cJob_System& jobs = cJob_System::Shared();
+      tJob_Batch batch = cJob_System::New_Batch();
+      for (int band_index = 0; band_index < band_count; band_index++) {
+        int band_top = top + band_index * band_height;
+        std::vector<sOverlap>* found = &band_overlaps[band_index];
+        jobs.Add_Job([this, band_top, band_height, found]() {
+          this->Sweep(band_top, band_top + band_height - 1, *found);
+        }, eJOB_NORMAL, batch, tJob_Token());
+      }
+      jobs.Wait(batch);
+    }
+    for (int band_index = 0; band_index < band_count; band_index++) {
+      overlaps.insert(overlaps.end(), band_overlaps[band_index].begin(), band_overlaps[band_index].end());
+    }
+    std::sort(overlaps.begin(), overlaps.end(), [](const sOverlap& a, const sOverlap& b) {
+      if (a.layer_a != b.layer_a) {
+        return (a.layer_a < b.layer_a);
+      }
+      if (a.index_a != b.index_a) {
+        return (a.index_a < b.index_a);
+      }
+      if (a.layer_b != b.layer_b) {
+        return (a.layer_b < b.layer_b);
+      }
+      return (a.index_b < b.index_b);
+    });
+  }
+
+  /**
+   * Sorts the boxes of one band by their left edge and sweeps across them.
+   * A pair is only reported by the band holding the top of its overlap so
+   * boxes that span bands are not reported twice.
+   * @param top The top of the band.
+   * @param bottom The bottom of the band.
+   * @param overlaps Receives the pairs found in the band.
+   */
+  void cOverlap_Finder::Sweep(int top, int bottom, std::vector<sOverlap>& overlaps) {
+    std::vector<int> band;
+    int box_count = this->boxes.size();
+    for (int box_index = 0; box_index < box_count; box_index++) {
+      sRectangle& box = this->boxes[box_index].box;
+      if ((box.top <= bottom) && (box.bottom >= top)) {
+        band.push_back(box_index);
+      }
+    }
+    std::sort(band.begin(), band.end(), [this](int a, int b) {
+      return (this->boxes[a].box.left < this->boxes[b].box.left);
+    });
+    std::vector<int> active;
+    int band_count = band.size();
+    for (int band_index = 0; band_index < band_count; band_index++) {
+      sBox& current = this->boxes[band[band_index]];
+      int active_count = active.size();
+      int kept = 0;
+      for (int active_index = 0; active_index < active_count; active_index++) {
+        sBox& other = this->boxes[active[active_index]];
+        if (other.box.right < current.box.left) { // Passed by the sweep.
+          continue;
+        }
+        active[kept++] = active[active_index];
+        int overlap_top = std::max(current.box.top, other.box.top);
+        if ((other.box.top <= current.box.bottom) && (other.box.bottom >= current.box.top) && (overlap_top >= top) && (overlap_top <= bottom)) {
+          bool other_first = (other.layer < current.layer) || ((other.layer == current.layer) && (other.index < current.index));
+          sBox& first = other_first ? other : current;
+          sBox& second = other_first ? current : other;
+          sOverlap overlap = { first.layer, first.index, second.layer, second.index };
+          overlaps.push_back(overlap);
+        }
+      }
+      active.resize(kept);
+      active.push_back(band[band_index]);
+    }
+  }
+
+  // **************************************************************************
+  // Catalog Index Implementation
+  // **************************************************************************
+
+  /**
+   * Loads the index of a catalog. The index is rebuilt if the catalog changed.
+   * @param name The name of the catalog.
+   * @throws An error if the catalog could not be opened.
+   */
+  void cCatalog_Index::Load(std::string name) {
+    this->name = name;
+    this->entries.clear();
+    if (this->catalog_file.is_open()) {
+      this->catalog_file.close();
+    }
+    this->catalog_file.open(name + ".txt", std::ios::binary);
+    Check_Condition(this->catalog_file.is_open(), "Could not open catalog " + name + ".");
+    if (this->Is_Current()) {
+      std::ifstream index_file(name + ".idx", std::ios::binary);
+      std::string line;
+      std::getline(index_file, line); // Skip the catalog stamp.
+      while (std::getline(index_file, line)) {
+        if ((line.length() > 0) && (line[line.length() - 1] == '\r')) {
+          line.erase(line.length() - 1);
+        }
+        cArray<std::string> fields = Parse_Sausage_Text(line, ",");
+        Check_Condition((fields.Count() == 3), "Catalog index entry is not formatted correctly.");
+        sCatalog_Entry entry = { fields[0], (long)Text_To_Number(fields[1]), fields[2], false };
+        this->entries.push_back(entry);
+      }
+    }
+    else {
+      this->Build();
+      this->Save();
+    }
+  }
+
+  /**
+   * Determines if the index on disk matches the catalog.
+   * @return True if the index can be used, false if it needs a rebuild.
+   */
+  bool cCatalog_Index::Is_Current() {
+    struct stat catalog_stat;
+    bool current = false;
+    if (stat((this->name + ".txt").c_str(), &catalog_stat) == 0) {
+      std::ifstream index_file(this->name + ".idx", std::ios::binary);
+      std::string stamp;
+      if (std::getline(index_file, stamp)) {
+        current = (stamp == "catalog=" + Number_To_Text(catalog_stat.st_size) + ":" + Number_To_Text(catalog_stat.st_mtime));
+      }
+    }
+    return current;
+  }
+
+  /**
+   * Scans the catalog once for sprite names, offsets and icons.
+   * @throws An error if a sprite has no icon.
+   */
+  void cCatalog_Index::Build() {
+    this->catalog_file.clear();
+    this->catalog_file.seekg(0);
+    std::string sprite_name;
+    while (true) {
+      long offset = (long)this->catalog_file.tellg();
+      if (!std::getline(this->catalog_file, sprite_name)) {
+        break;
+      }
+      if ((sprite_name.length() > 0) && (sprite_name[sprite_name.length() - 1] == '\r')) {
+        sprite_name.erase(sprite_name.length() - 1);
+      }
+      if (sprite_name.length() == 0) {
+        continue; // Blank line between entries.
+      }
+      tObject sprite;
+      Read_Object(this->catalog_file, sprite);
+      Check_Condition(sprite.Does_Key_Exist("icon") || sprite.Does_Key_Exist("*icon"), "Icon property missing in sprite " + sprite_name + ".");
+      std::string icon = sprite.Does_Key_Exist("icon") ? sprite["icon"].string : sprite["*icon"].string;
+      sCatalog_Entry entry = { sprite_name, offset, icon, false };
+      this->entries.push_back(entry);
+    }
+  }
+
+  /**
+   * Saves the index next to the catalog.
+   */
+  void cCatalog_Index::Save() {
+    struct stat catalog_stat;
+    if (stat((this->name + ".txt").c_str(), &catalog_stat) == 0) {
+      std::ofstream index_file(this->name + ".idx", std::ios::binary);
+      index_file << "catalog=" << Number_To_Text(catalog_stat.st_size) << ":" << Number_To_Text(catalog_stat.st_mtime) << "\n";
+      int entry_count = this->entries.size();
+      for (int entry_index = 0; entry_index < entry_count; entry_index++) {
+        sCatalog_Entry& entry = this->entries[entry_index];
+        index_file << entry.name << "," << entry.offset << "," << entry.icon << "\n";
+      }
+    }
+  }
+
+  /**
+   * Parses one catalog entry from its recorded offset.
+   * @param index The index of the entry.
+   * @param sprite The object to read the sprite properties into.
+   * @throws An error if the entry could not be read.
+   */
+  void cCatalog_Index::Read_Entry(int index, tObject& sprite) {
+    sCatalog_Entry& entry = this->entries[index];
+    std::string sprite_name;
+    this->catalog_file.clear();
+    this->catalog_file.seekg(entry.offset);
+    std::getline(this->catalog_file, sprite_name);
+    Check_Condition(Read_Object(this->catalog_file, sprite), "Could not read catalog entry " + entry.name + ".");
+    entry.parsed = true;
+  }
+
+  /**
+   * Reads an object written as key=value lines up to the end marker. This is
+   * the one parser for catalogs, maps and manifests, so entries read by
+   * offset and whole files read the same way.
+   * @param stream The stream to read from.
+   * @param object The object to fill.
+   * @return True if an object was read, false if the stream ended.
+   */
+  bool Read_Object(std::istream& stream, tObject& object) {
+    std::string line;
+    bool has_object = false;
+    while (std::getline(stream, line)) {
+      if ((line.length() > 0) && (line[line.length() - 1] == '\r')) {
+        line.erase(line.length() - 1);
+      }
+      if (line.length() == 0) { // Blank lines between objects.
+        continue;
+      }
+      has_object = true;
+      if (line == "end") {
+        break;
+      }
+      size_t split = line.find('=');
+      if (split != std::string::npos) {
+        object[line.substr(0, split)] = Parse_Value(line.substr(split + 1));
+      }
+    }
+    return has_object;
+  }
+
+  /**
+   * Parses a property value as a number if it looks like one.
+   * @param text The text of the value.
+   * @return The number or string value.
+   */
+  cValue Parse_Value(std::string text) {
+    int length = text.length();
+    int start = ((length > 1) && (text[0] == '-')) ? 1 : 0;
+    bool is_number = (length > start);
+    for (int char_index = start; char_index < length; char_index++) {
+      if ((text[char_index] < '0') || (text[char_index] > '9')) {
+        is_number = false;
+        break;
+      }
+    }
+    return is_number ? cValue(Text_To_Number(text)) : cValue(text);
+  }
+
+  /**
+   * Compares two values by type and content.
+   * @param a The first value.
+   * @param b The second value.
+   * @return True if the values are the same.
+   */
+  bool Is_Same_Value(const cValue& a, const cValue& b) {
+    bool same = false;
+    if (a.type == b.type) {
+      same = (a.type == eVALUE_NUMBER) ? (a.number == b.number) : (a.string == b.string);
+    }
+    return same;
+  }
+
+  // **************************************************************************
+  // Memory Report Implementation
+  // **************************************************************************
+
+  sMemory_Stats memory_stats;
+
+  /**
+   * Clears the entries but keeps the high-water marks.
+   */
+  void cMemory_Report::Clear() {
+    this->entries.clear();
+  }
+
+  /**
+   * Adds an entry to the report and updates its high-water mark.
+   * @param name The name of the part that holds the memory.
+   * @param bytes The number of bytes held.
+   * @param count The number of objects held.
+   */
+  void cMemory_Report::Add(std::string name, long long bytes, long long count) {
+    long long& peak = this->peaks[name];
+    peak = std::max(peak, bytes);
+    sMemory_Entry entry = { name, bytes, count, peak };
+    this->entries.push_back(entry);
+  }
+
+  /**
+   * Formats the report with one entry per line.
+   * @return The report text.
+   */
+  std::string cMemory_Report::Get_Text() {
+    std::string text = "";
+    int entry_count = this->entries.size();
+    for (int entry_index = 0; entry_index < entry_count; entry_index++) {
+      sMemory_Entry& entry = this->entries[entry_index];
+      text += entry.name + ": bytes=" + std::to_string(entry.bytes) + ",count=" + std::to_string(entry.count) + ",peak=" + std::to_string(entry.peak) + "\n";
+    }
+    return text;
+  }
+
+  /**
+   * Writes the report to a file.
+   * @param name The name of the file without the extension.
+   * @throws An error if the file could not be written.
+   */
+  void cMemory_Report::Write(std::string name) {
+    std::ofstream report_file(name + ".txt", std::ios::binary);
+    Check_Condition(report_file.is_open(), "Could not write memory report " + name + ".");
+    report_file << this->Get_Text();
+  }
+
+  // **************************************************************************
+  // Job System Implementation
+  // **************************************************************************
+
+  thread_local int job_worker = NO_VALUE_FOUND; // Index of the worker running on this thread.
+  int cJob_System::worker_count = 0;
+
+  /**
+   * Creates an empty job queue for a worker.
+   */
+  cJob_Queue::cJob_Queue() {
+    this->jobs_run = 0;
+    this->jobs_stolen = 0;
+    this->jobs_cancelled = 0;
+    this->busy_us = 0;
+  }
+
+  /**
+   * Creates the workers. Each owns a queue per priority that others steal
+   * from when they run dry.
+   * @param worker_count The number of workers. At least one is created.
+   */
+  cJob_System::cJob_System(int worker_count) {
+    this->queued = 0;
+    this->running = 0;
+    this->added = 0;
+    this->next_queue = 0;
+    this->stopping = false;
+    this->start = std::chrono::steady_clock::now();
+    if (worker_count < 1) {
+      worker_count = 1;
+    }
+    for (int worker_index = 0; worker_index < worker_count; worker_index++) {
+      this->queues.push_back(std::unique_ptr<cJob_Queue>(new cJob_Queue()));
+    }
+    for (int worker_index = 0; worker_index < worker_count; worker_index++) {
+      this->workers.push_back(std::thread(&cJob_System::Run_Worker, this, worker_index));
+    }
+  }
+
+  /**
+   * Drops queued jobs and joins the workers.
+   */
+  cJob_System::~cJob_System() {
+    {
+      std::lock_guard<std::mutex> guard(this->sleep_lock);
+      this->stopping = true;
+    }
+    this->job_ready.notify_all();
+    int worker_count = this->workers.size();
+    for (int worker_index = 0; worker_index < worker_count; worker_index++) {
+      this->workers[worker_index].join();
+    }
+  }
+
+  /**
+   * Gets the job system shared by the editor, the loader and the checker. It
+   * is started on first use with worker_count workers, or one less than the
+   * number of cores when that is not set, since waiting threads help out.
+   * @return The job system.
+   */
+  cJob_System& cJob_System::Shared() {
+    static cJob_System shared((worker_count > 0) ? worker_count : (int)std::thread::hardware_concurrency() - 1);
+    return shared;
+  }
+
+  /**
+   * Creates a counter of unfinished jobs to wait on.
+   * @return The batch.
+   */
+  tJob_Batch cJob_System::New_Batch() {
+    return tJob_Batch(new std::atomic<int>(0));
+  }
+
+  /**
+   * Creates a token that abandons the jobs holding it once cancelled.
+   * @return The token.
+   */
+  tJob_Token cJob_System::New_Token() {
+    return tJob_Token(new std::atomic<bool>(false));
+  }
+
+  /**
+   * Determines if a token was cancelled.
+   * @param token The token or an empty token.
+   * @return True if the token was cancelled, false otherwise.
+   */
+  bool cJob_System::Is_Cancelled(tJob_Token& token) {
+    return (token && token->load());
+  }
+
+  /**
+   * Queues a job. Jobs queued by a worker go to its own queue; others are
+   * spread over the workers.
+   * @param work The work to do.
+   * @param priority Frame jobs run before normal and background jobs.
+   * @param batch The batch to count the job in or an empty batch.
+   * @param token The token to cancel the job with or an empty token.
+   */
+  void cJob_System::Add_Job(std::function<void()> work, eJob_Priority priority, tJob_Batch batch, tJob_Token token) {
+    sJob job = { work, batch, token };
+    if (batch) {
+      (*batch)++;
+    }
+    int queue_count = this->queues.size();
+    int queue_index = (job_worker != NO_VALUE_FOUND) ? job_worker : (this->next_queue++ % queue_count);
+    cJob_Queue& queue = *this->queues[queue_index];
+    {
+      std::lock_guard<std::mutex> guard(queue.lock);
+      queue.jobs[priority].push_back(job);
+    }
+    this->queued++;
+    this->added++;
+    {
+      std::lock_guard<std::mutex> guard(this->sleep_lock); // No worker misses the wake up between its check and its wait.
+    }
+    this->job_ready.notify_one();
+    this->job_done.notify_all(); // Waiters look for jobs of their batch.
+  }
+
+  /**
+   * Queues work for the main thread, such as applying a result to the map.
+   * @param work The work to do.
+   * @param token The token to cancel the work with or an empty token.
+   */
+  void cJob_System::Post_Main(std::function<void()> work, tJob_Token token) {
+    sJob job = { work, tJob_Batch(), token };
+    std::lock_guard<std::mutex> guard(this->main_lock);
+    this->main_jobs.push_back(job);
+  }
+
+  /**
+   * Runs work posted for the main thread. Work left over after the budget
+   * waits for the next frame.
+   * @param budget_ms The time to spend in milliseconds.
+   */
+  void cJob_System::Run_Main_Jobs(double budget_ms) {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    while (true) {
+      sJob job;
+      {
+        std::lock_guard<std::mutex> guard(this->main_lock);
+        if (this->main_jobs.empty()) {
+          break;
+        }
+        job = this->main_jobs.front();
+        this->main_jobs.pop_front();
+      }
+      if (!Is_Cancelled(job.token)) {
+        job.work();
+      }
+      std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+      if (elapsed.count() >= budget_ms) {
+        break;
+      }
+    }
+  }
+
+  /**
+   * Waits until every job of a batch has finished. The waiting thread runs
+   * jobs of the batch and frame jobs meanwhile, so workers may wait on
+   * batches of their own. Other jobs are left to the workers so a wait is
+   * never held up by unrelated background work.
+   * @param batch The batch to wait on.
+   */
+  void cJob_System::Wait(tJob_Batch batch) {
+    while (batch->load() > 0) {
+      long long added = this->added;
+      if (!this->Run_One(job_worker, batch)) {
+        std::unique_lock<std::mutex> guard(this->sleep_lock);
+        this->job_done.wait(guard, [this, &batch, added]() { return ((batch->load() == 0) || (this->added != added)); });
+      }
+    }
+  }
+
+  /**
+   * Runs the most urgent queued job. A worker checks its own queue first and
+   * then steals the oldest job of the same priority from the others.
+   * @param worker The worker running the job or NO_VALUE_FOUND.
+   * @param batch Only jobs of this batch and frame jobs are run, or any job if empty.
+   * @return True if a job was run, false if there were none.
+   */
+  bool cJob_System::Run_One(int worker, tJob_Batch batch) {
+    int queue_count = this->queues.size();
+    int first = (worker != NO_VALUE_FOUND) ? worker : 0;
+    for (int priority = 0; priority < eJOB_PRIORITY_COUNT; priority++) {
+      bool any_job = (!batch || (priority == eJOB_FRAME));
+      for (int queue_offset = 0; queue_offset < queue_count; queue_offset++) {
+        int queue_index = (first + queue_offset) % queue_count;
+        cJob_Queue& queue = *this->queues[queue_index];
+        sJob job;
+        {
+          std::lock_guard<std::mutex> guard(queue.lock);
+          std::deque<sJob>& jobs = queue.jobs[priority];
+          int job_count = jobs.size();
+          int found = NO_VALUE_FOUND;
+          for (int job_offset = 0; (job_offset < job_count) && (found == NO_VALUE_FOUND); job_offset++) {
+            int job_index = (queue_index == worker) ? (job_count - 1 - job_offset) : job_offset; // Newest own job is the one with warm data.
+            if (any_job || (jobs[job_index].batch == batch)) {
+              found = job_index;
+            }
+          }
+          if (found == NO_VALUE_FOUND) {
+            continue;
+          }
+          job = jobs[found];
+          jobs.erase(jobs.begin() + found);
+          this->running++; // Counted before it leaves the queue count so Drain never sees neither.
+        }
+        this->queued--;
+        if ((worker != NO_VALUE_FOUND) && (queue_index != worker)) {
+          this->queues[worker]->jobs_stolen++;
+        }
+        this->Run_Job(job, worker);
+        if (--this->running == 0) {
+          std::lock_guard<std::mutex> guard(this->sleep_lock);
+          this->job_done.notify_all();
+        }
+        return true;
+      }
+    }
+    return false;
+  }
+
+  /**
+   * Runs a job unless it was cancelled and counts it in its batch.
+   * @param job The job to run.
+   * @param worker The worker running the job or NO_VALUE_FOUND.
+   */
+  void cJob_System::Run_Job(sJob& job, int worker) {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    if (Is_Cancelled(job.token)) {
+      if (worker != NO_VALUE_FOUND) {
+        this->queues[worker]->jobs_cancelled++;
+      }
+    }
+    else {
+      job.work();
+      if (worker != NO_VALUE_FOUND) {
+        this->queues[worker]->jobs_run++;
+      }
+    }
+    if (worker != NO_VALUE_FOUND) {
+      this->queues[worker]->busy_us += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+    }
+    if (job.batch && (--(*job.batch) == 0)) {
+      std::lock_guard<std::mutex> guard(this->sleep_lock);
+      this->job_done.notify_all();
+    }
+  }
+
+  /**
+   * Runs jobs until the system is stopped.
+   * @param worker The index of the worker.
+   */
+  void cJob_System::Run_Worker(int worker) {
+    job_worker = worker;
+    while (true) {
+      if (this->Run_One(worker, tJob_Batch())) {
+        continue;
+      }
+      std::unique_lock<std::mutex> guard(this->sleep_lock);
+      this->job_ready.wait(guard, [this]() { return (this->stopping || (this->queued > 0)); });
+      if (this->stopping) {
+        break;
+      }
+    }
+  }
+
+  /**
+   * Runs jobs and main thread work until nothing is queued or running, so
+   * every result is applied before the caller goes on.
+   */
+  void cJob_System::Drain() {
+    while (true) {
+      while (this->Run_One(job_worker, tJob_Batch())) {
+        // Help the workers empty the queues.
+      }
+      {
+        std::unique_lock<std::mutex> guard(this->sleep_lock);
+        this->job_done.wait(guard, [this]() { return ((this->running == 0) || (this->queued > 0)); });
+      }
+      if (this->queued > 0) {
+        continue;
+      }
+      bool has_main_jobs = false;
+      {
+        std::lock_guard<std::mutex> guard(this->main_lock);
+        has_main_jobs = !this->main_jobs.empty();
+      }
+      if (!has_main_jobs) {
+        break;
+      }
+      this->Run_Main_Jobs(std::numeric_limits<double>::infinity());
+    }
+  }
+
+  /**
+   * Gets the utilization of each worker since the system started.
+   * @return One line per worker.
+   */
+  std::string cJob_System::Get_Stats() {
+    std::ostringstream stats;
+    long long elapsed_us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - this->start).count();
+    int queue_count = this->queues.size();
+    stats << std::fixed << std::setprecision(1);
+    for (int queue_index = 0; queue_index < queue_count; queue_index++) {
+      cJob_Queue& queue = *this->queues[queue_index];
+      double busy = (elapsed_us > 0) ? (100.0 * queue.busy_us / elapsed_us) : 0.0;
+      stats << "worker " << queue_index << ": " << busy << "% busy, " << queue.jobs_run << " run, " << queue.jobs_stolen << " stolen, " << queue.jobs_cancelled << " cancelled\n";
+    }
+    return stats.str();
+  }
+
+  // **************************************************************************
+  // Resource Loader Implementation
+  // **************************************************************************
+
+  /**
+   * Creates a loader for images that are decoded when first needed. Sounds
+   * and fonts in the folder are listed separately since maps refer to images
+   * by title alone.
+   * @param allegro The Allegro I/O control that owns the images.
+   * @param folder The folder holding the resources.
+   * @throws An error if two images have the same title.
+   */
+  cResource_Loader::cResource_Loader(cAllegro_IO* allegro, std::string folder) {
+    this->allegro = allegro;
+    this->folder = folder;
+    // Listing the folder is cheap compared to decoding it.
+    cArray<std::string> files = allegro->Get_File_List(folder);
+    int file_count = files.Count();
+    for (int file_index = 0; file_index < file_count; file_index++) {
+      std::string type = Get_File_Type(files[file_index]);
+      std::string title = allegro->Get_File_Title(files[file_index]);
+      std::string path = folder + "/" + files[file_index];
+      if (Is_Image_Type(type)) {
+        if (this->paths.find(title) != this->paths.end()) {
+          throw cError("Images " + this->paths[title] + " and " + path + " have the same name.");
+        }
+        this->paths[title] = path;
+      }
+      else if ((type == "wav") || (type == "ogg") || (type == "flac") || (type == "opus")) {
+        this->sound_paths[title] = path;
+      }
+      else if ((type == "ttf") || (type == "otf")) {
+        this->font_paths[title] = path;
+      }
+    }
+  }
+
+  /**
+   * Frees the sounds and fonts. Images belong to the I/O control.
+   */
+  cResource_Loader::~cResource_Loader() {
+    for (std::unordered_map<std::string, ALLEGRO_SAMPLE*>::iterator sound = this->sounds.begin(); sound != this->sounds.end(); ++sound) {
+      al_destroy_sample(sound->second);
+    }
+    for (std::unordered_map<std::string, ALLEGRO_FONT*>::iterator font = this->fonts.begin(); font != this->fonts.end(); ++font) {
+      al_destroy_font(font->second);
+    }
+  }
+
+  /**
+   * Determines if an image has been decoded.
+   * @param name The name of the image.
+   * @return True if the image is loaded, false otherwise.
+   */
+  bool cResource_Loader::Is_Loaded(std::string name) {
+    return (this->loaded.find(name) != this->loaded.end());
+  }
+
+  /**
+   * Decodes an image if it was not loaded yet.
+   * @param name The name of the image.
+   * @throws An error if the image could not be loaded.
+   */
+  void cResource_Loader::Load_Image(std::string name) {
+    if (!this->Is_Loaded(name)) {
+      Check_Condition((this->paths.find(name) != this->paths.end()), "Image " + name + " is not in " + this->folder + ".");
+      ALLEGRO_BITMAP* bitmap = al_load_bitmap(this->paths[name].c_str());
+      Check_Condition((bitmap != NULL), "Could not load image " + name + ".");
+      this->Register_Image(name, bitmap);
+    }
+  }
+
+  /**
+   * Decodes a set of images on the job system. Workers decode into memory
+   * bitmaps; uploading and registering stays on the calling thread because
+   * it owns the display. Names that are loaded or not in the folder are
+   * skipped; Load_Image reports the missing ones when they are used.
+   * @param names The names of the images.
+   * @throws An error if an image could not be decoded.
+   */
+  void cResource_Loader::Load_Images(std::vector<std::string>& names) {
+    std::mutex result_lock;
+    std::condition_variable result_ready;
+    std::deque<sDecoded_Image> results;
+    int expected = 0;
+    cJob_System& jobs = cJob_System::Shared();
+    tJob_Batch batch = cJob_System::New_Batch();
+    std::unordered_set<std::string> queued;
+    int name_count = names.size();
+    for (int name_index = 0; name_index < name_count; name_index++) {
+      std::string name = names[name_index];
+      std::unordered_map<std::string, std::string>::iterator entry = this->paths.find(name);
+      if ((entry == this->paths.end()) || this->Is_Loaded(name) || !queued.insert(name).second) {
+        continue;
+      }
+      std::string path = entry->second;
+      expected++;
+      jobs.Add_Job([name, path, &result_lock, &result_ready, &results]() {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        al_set_new_bitmap_flags(ALLEGRO_MEMORY_BITMAP); // Flags are per thread.
+        ALLEGRO_BITMAP* bitmap = al_load_bitmap(path.c_str());
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+        sDecoded_Image image = { name, bitmap, elapsed.count() };
+        {
+          std::lock_guard<std::mutex> guard(result_lock);
+          results.push_back(image);
+        }
+        result_ready.notify_one();
+      }, eJOB_FRAME, batch, tJob_Token()); // The caller waits for the images.
+    }
+    // Upload on this thread as results come in.
+    int old_flags = al_get_new_bitmap_flags();
+    al_set_new_bitmap_flags(ALLEGRO_VIDEO_BITMAP);
+    std::string failed = "";
+    for (int result_index = 0; result_index < expected; result_index++) {
+      sDecoded_Image image;
+      {
+        std::unique_lock<std::mutex> guard(result_lock);
+        result_ready.wait(guard, [&results]() { return !results.empty(); });
+        image = results.front();
+        results.pop_front();
+      }
+      if (image.bitmap == NULL) {
+        failed = image.name;
+        continue;
+      }
+      std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+      ALLEGRO_BITMAP* video_bitmap = al_clone_bitmap(image.bitmap);
+      al_destroy_bitmap(image.bitmap);
+      this->Register_Image(image.name, video_bitmap);
+      std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+      sLoad_Time load_time = { image.name, image.decode_ms, elapsed.count() };
+      this->load_times.push_back(load_time);
+    }
+    al_set_new_bitmap_flags(old_flags);
+    jobs.Wait(batch);
+    Check_Condition((failed == ""), "Could not load image " + failed + ".");
+  }
+
+  /**
+   * Loads the sounds and fonts of the folder, which Load_Images does not
+   * decode.
+   * @throws An error if a sound or font could not be loaded.
+   */
+  void cResource_Loader::Load_Sounds_And_Fonts() {
+    if (!this->sound_paths.empty() && !al_is_audio_installed()) {
+      Check_Condition(al_install_audio() && al_init_acodec_addon(), "Could not start audio for the sounds in " + this->folder + ".");
+    }
+    for (std::unordered_map<std::string, std::string>::iterator entry = this->sound_paths.begin(); entry != this->sound_paths.end(); ++entry) {
+      if (this->sounds.find(entry->first) == this->sounds.end()) {
+        ALLEGRO_SAMPLE* sound = al_load_sample(entry->second.c_str());
+        Check_Condition((sound != NULL), "Could not load sound " + entry->first + ".");
+        this->sounds[entry->first] = sound;
+      }
+    }
+    for (std::unordered_map<std::string, std::string>::iterator entry = this->font_paths.begin(); entry != this->font_paths.end(); ++entry) {
+      if (this->fonts.find(entry->first) == this->fonts.end()) {
+        ALLEGRO_FONT* font = al_load_ttf_font(entry->second.c_str(), RESOURCE_FONT_SIZE, 0);
+        Check_Condition((font != NULL), "Could not load font " + entry->first + ".");
+        this->fonts[entry->first] = font;
+      }
+    }
+  }
+
+  /**
+   * Gets the extension of a file in lower case.
+   * @param file The name of the file.
+   * @return The extension without the dot.
+   */
+  std::string cResource_Loader::Get_File_Type(std::string file) {
+    std::string type = std::filesystem::path(file).extension().string();
+    if (type.length() > 0) {
+      type = type.substr(1);
+    }
+    std::transform(type.begin(), type.end(), type.begin(), [](unsigned char letter) { return std::tolower(letter); });
+    return type;
+  }
+
+  /**
+   * Determines if a file type is decoded by the Allegro image addon.
+   * @param type The extension in lower case.
+   * @return True if the file is an image, false otherwise.
+   */
+  bool cResource_Loader::Is_Image_Type(std::string type) {
+    return ((type == "png") || (type == "bmp") || (type == "jpg") || (type == "jpeg") || (type == "tga") || (type == "pcx"));
+  }
+
+  /**
+   * Writes the load time of each asset, slowest first.
+   * @param name The name of the report file.
+   */
+  void cResource_Loader::Write_Load_Report(std::string name) {
+    std::vector<sLoad_Time> times = this->load_times;
+    std::sort(times.begin(), times.end(), [](const sLoad_Time& a, const sLoad_Time& b) {
+      return ((a.decode_ms + a.upload_ms) > (b.decode_ms + b.upload_ms));
+    });
+    std::ofstream report(name + ".txt");
+    report << "asset,decode-ms,upload-ms\n";
+    int time_count = times.size();
+    for (int time_index = 0; time_index < time_count; time_index++) {
+      report << times[time_index].name << "," << times[time_index].decode_ms << "," << times[time_index].upload_ms << "\n";
+    }
+  }
+
+  /**
+   * Gets an image scaled by a power of two, creating it on first use. Smaller
+   * levels are halved from the level above so they filter like mipmaps.
+   * @param name The name of the image.
+   * @param zoom The zoom level. Negative levels shrink the image.
+   * @return The name the scaled image is registered under.
+   * @throws An error if the image could not be loaded.
+   */
+  std::string cResource_Loader::Get_Scaled_Image(std::string name, int zoom) {
+    if (zoom == 0) {
+      this->Load_Image(name);
+      return name;
+    }
+    std::string scaled_name = name + "@" + Number_To_Text(zoom);
+    if (!this->Is_Loaded(scaled_name)) {
+      std::string source_name = this->Get_Scaled_Image(name, (zoom > 0) ? 0 : zoom + 1);
+      ALLEGRO_BITMAP* source = this->allegro->images[source_name];
+      int source_w = al_get_bitmap_width(source);
+      int source_h = al_get_bitmap_height(source);
+      int width = (zoom > 0) ? (source_w << zoom) : std::max(1, source_w / 2);
+      int height = (zoom > 0) ? (source_h << zoom) : std::max(1, source_h / 2);
+      ALLEGRO_BITMAP* scaled = al_create_bitmap(width, height);
+      Check_Condition((scaled != NULL), "Could not scale image " + name + ".");
+      ALLEGRO_BITMAP* old_target = al_get_target_bitmap();
+      al_set_target_bitmap(scaled);
+      al_draw_scaled_bitmap(source, 0, 0, source_w, source_h, 0, 0, width, height, 0);
+      al_set_target_bitmap(old_target);
+      this->Register_Image(scaled_name, scaled);
+    }
+    return scaled_name;
+  }
+
+  /**
+   * Hands a decoded image to the I/O control.
+   * @param name The name of the image.
+   * @param bitmap The decoded bitmap.
+   */
+  void cResource_Loader::Register_Image(std::string name, ALLEGRO_BITMAP* bitmap) {
+    this->allegro->images[name] = bitmap;
+    this->loaded[name] = true;
+  }
+
+  /**
+   * Frees a decoded image so it can be decoded again later.
+   * @param name The name of the image.
+   */
+  void cResource_Loader::Unload_Image(std::string name) {
+    if (this->Is_Loaded(name)) {
+      al_destroy_bitmap(this->allegro->images[name]);
+      this->allegro->images.Remove(name);
+      this->loaded.erase(name);
+    }
+  }
+
+  /**
+   * Gets the memory held by a decoded image counted as 32 bit pixels.
+   * @param name The name of the image.
+   * @return The number of bytes or zero if the image is not loaded.
+   */
+  long long cResource_Loader::Get_Image_Bytes(std::string name) {
+    long long bytes = 0;
+    if (this->Is_Loaded(name)) {
+      ALLEGRO_BITMAP* bitmap = this->allegro->images[name];
+      bytes = (long long)al_get_bitmap_width(bitmap) * al_get_bitmap_height(bitmap) * 4;
+    }
+    return bytes;
+  }
+
+  /**
+   * Cuts a large image into tiles for streaming. Each level is half the size
+   * of the one above so zoomed out views decode as few pixels as zoomed in
+   * ones. Tiles and the manifest go in a folder named after the image under
+   * the tile folder.
+   * @param file The path of the image to slice.
+   * @param name The name maps refer to the background by.
+   * @param tile_size The width and height of a tile in pixels.
+   * @return The number of tiles written.
+   * @throws An error if the image could not be read or a tile not written.
+   */
+  int cResource_Loader::Slice_Image(std::string file, std::string name, int tile_size) {
+    Check_Condition((tile_size > 0), "Tile size must be positive.");
+    al_set_new_bitmap_flags(ALLEGRO_MEMORY_BITMAP);
+    ALLEGRO_BITMAP* level = al_load_bitmap(file.c_str());
+    Check_Condition((level != NULL), "Could not load image " + file + ".");
+    std::string folder = TILE_FOLDER + "/" + name;
+    std::filesystem::create_directories(folder);
+    tObject manifest;
+    manifest["width"].Set_Number(al_get_bitmap_width(level));
+    manifest["height"].Set_Number(al_get_bitmap_height(level));
+    manifest["tile-size"].Set_Number(tile_size);
+    int level_count = 0;
+    int tile_count = 0;
+    std::string failed = "";
+    ALLEGRO_BITMAP* old_target = al_get_target_bitmap();
+    while (level) {
+      int level_w = al_get_bitmap_width(level);
+      int level_h = al_get_bitmap_height(level);
+      for (int y = 0; (y < level_h) && (failed == ""); y += tile_size) {
+        for (int x = 0; (x < level_w) && (failed == ""); x += tile_size) {
+          ALLEGRO_BITMAP* tile = al_create_sub_bitmap(level, x, y, std::min(tile_size, level_w - x), std::min(tile_size, level_h - y));
+          std::string tile_file = folder + "/" + cTile_Cache::Get_Tile_Name(name, level_count, x / tile_size, y / tile_size) + ".png";
+          if (!tile || !al_save_bitmap(tile_file.c_str(), tile)) {
+            failed = tile_file;
+          }
+          if (tile) {
+            al_destroy_bitmap(tile);
+          }
+          tile_count++;
+        }
+      }
+      level_count++;
+      ALLEGRO_BITMAP* next = NULL;
+      if ((failed == "") && ((level_w > tile_size) || (level_h > tile_size)) && (level_count < TILE_MAX_LEVELS)) {
+        int next_w = cTile_Cache::Get_Level_Size(level_w, 1);
+        int next_h = cTile_Cache::Get_Level_Size(level_h, 1);
+        next = al_create_bitmap(next_w, next_h);
+        if (next) {
+          al_set_target_bitmap(next);
+          al_draw_scaled_bitmap(level, 0, 0, level_w, level_h, 0, 0, next_w, next_h, 0);
+        }
+        else {
+          failed = "level " + Number_To_Text(level_count);
+        }
+      }
+      al_destroy_bitmap(level);
+      level = next;
+    }
+    al_set_target_bitmap(old_target);
+    Check_Condition((failed == ""), "Could not write tile " + failed + ".");
+    manifest["levels"].Set_Number(level_count);
+    cMap_Writer writer(folder + "/Tiles.txt");
+    writer.Write_Object(manifest);
+    writer.Commit();
+    return tile_count;
+  }
+
+  // **************************************************************************
+  // Tile Cache Implementation
+  // **************************************************************************
+
+  /**
+   * Creates an empty tile cache with the default memory budget.
+   */
+  cTile_Cache::cTile_Cache() {
+    this->loader = NULL;
+    this->token = cJob_System::New_Token();
+    this->budget = (long long)TILE_CACHE_MB * 1024 * 1024;
+    this->bytes = 0;
+    this->frame = 0;
+  }
+
+  /**
+   * Abandons the tiles still being decoded.
+   */
+  cTile_Cache::~cTile_Cache() {
+    this->token->store(true);
+  }
+
+  /**
+   * Marks a tile as used this frame. A tile that is not cached is decoded on
+   * the job system and added on the main thread once it is ready.
+   * @param name The name of the tile image.
+   * @param path The file holding the tile.
+   * @return True if the tile can be drawn now, false if it is still loading.
+   */
+  bool cTile_Cache::Request(std::string name, std::string path) {
+    std::unordered_map<std::string, sCached_Tile>::iterator tile = this->tiles.find(name);
+    if (tile != this->tiles.end()) {
+      this->recent.splice(this->recent.begin(), this->recent, tile->second.place);
+      tile->second.frame = this->frame;
+      return true;
+    }
+    if (this->pending.insert(name).second) {
+      cTile_Cache* cache = this;
+      tJob_Token token = this->token;
+      cJob_System::Shared().Add_Job([cache, name, path, token]() {
+        al_set_new_bitmap_flags(ALLEGRO_MEMORY_BITMAP); // Flags are per thread.
+        ALLEGRO_BITMAP* bitmap = al_load_bitmap(path.c_str());
+        cJob_System::Shared().Post_Main([cache, name, bitmap, token]() {
+          tJob_Token cancel = token;
+          if (cJob_System::Is_Cancelled(cancel)) { // The cache is gone or was cleared.
+            if (bitmap) {
+              al_destroy_bitmap(bitmap);
+            }
+            return;
+          }
+          cache->Add_Tile(name, bitmap);
+        }, tJob_Token());
+      }, eJOB_NORMAL, tJob_Batch(), token);
+    }
+    return false;
+  }
+
+  /**
+   * Determines if a tile is decoded and can be drawn.
+   * @param name The name of the tile image.
+   * @return True if the tile is cached, false otherwise.
+   */
+  bool cTile_Cache::Is_Cached(std::string name) {
+    return (this->tiles.find(name) != this->tiles.end());
+  }
+
+  /**
+   * Uploads a decoded tile and adds it to the cache. A tile that could not
+   * be decoded stays pending so it is not asked for again every frame, and
+   * is counted in the memory panel.
+   * @param name The name of the tile image.
+   * @param bitmap The memory bitmap or NULL if the decode failed.
+   */
+  void cTile_Cache::Add_Tile(std::string name, ALLEGRO_BITMAP* bitmap) {
+    if (bitmap == NULL) {
+      this->failed.insert(name);
+      return;
+    }
+    this->pending.erase(name);
+    int old_flags = al_get_new_bitmap_flags();
+    al_set_new_bitmap_flags(ALLEGRO_VIDEO_BITMAP);
+    ALLEGRO_BITMAP* video_bitmap = al_clone_bitmap(bitmap);
+    al_set_new_bitmap_flags(old_flags);
+    al_destroy_bitmap(bitmap);
+    this->loader->Register_Image(name, video_bitmap);
+    this->recent.push_front(name);
+    sCached_Tile cached = { this->recent.begin(), this->loader->Get_Image_Bytes(name), this->frame };
+    this->bytes += cached.bytes;
+    this->tiles[name] = cached;
+  }
+
+  /**
+   * Frees the least recently used tiles until the cache fits its budget.
+   * Tiles drawn this frame are kept even if they alone go over.
+   */
+  void cTile_Cache::Trim() {
+    while ((this->bytes > this->budget) && !this->recent.empty()) {
+      std::unordered_map<std::string, sCached_Tile>::iterator tile = this->tiles.find(this->recent.back());
+      if (tile->second.frame == this->frame) {
+        break; // Everything left is in view.
+      }
+      this->loader->Unload_Image(tile->first);
+      this->bytes -= tile->second.bytes;
+      this->tiles.erase(tile);
+      this->recent.pop_back();
+    }
+  }
+
+  /**
+   * Frees every cached tile.
+   */
+  void cTile_Cache::Clear() {
+    this->token->store(true); // Tiles still being decoded are dropped.
+    this->token = cJob_System::New_Token();
+    this->pending.clear();
+    this->failed.clear();
+    for (std::unordered_map<std::string, sCached_Tile>::iterator tile = this->tiles.begin(); tile != this->tiles.end(); ++tile) {
+      this->loader->Unload_Image(tile->first);
+    }
+    this->tiles.clear();
+    this->recent.clear();
+    this->bytes = 0;
+  }
+
+  /**
+   * Gets the image name of a background tile.
+   * @param name The name of the background.
+   * @param level The level where 0 is full size and each level halves it.
+   * @param col The column of the tile.
+   * @param row The row of the tile.
+   * @return The name of the tile image.
+   */
+  std::string cTile_Cache::Get_Tile_Name(std::string name, int level, int col, int row) {
+    return name + "_" + Number_To_Text(level) + "_" + Number_To_Text(col) + "_" + Number_To_Text(row);
+  }
+
+  /**
+   * Reads the manifest written when a background was sliced.
+   * @param folder The tile folder.
+   * @param name The name of the background.
+   * @param tiled The tiled background to fill in.
+   * @return True if the background is tiled, false otherwise.
+   */
+  bool cTile_Cache::Read_Manifest(std::string folder, std::string name, sTiled_Background& tiled) {
+    std::string path = folder + "/" + name + "/Tiles.txt";
+    bool found = false;
+    std::ifstream manifest_file(path, std::ios::binary);
+    tObject manifest;
+    if ((name != "") && Read_Object(manifest_file, manifest)) {
+      tiled.name = name;
+      tiled.tile_size = manifest["tile-size"].number;
+      tiled.width = manifest["width"].number;
+      tiled.height = manifest["height"].number;
+      tiled.levels = manifest["levels"].number;
+      found = ((tiled.tile_size > 0) && (tiled.levels > 0));
+    }
+    return found;
+  }
+
+  /**
+   * Gets the size of an image side at a level of a tiled background.
+   * @param size The full size in pixels.
+   * @param level The level.
+   * @return The size at the level.
+   */
+  int cTile_Cache::Get_Level_Size(int size, int level) {
+    for (int level_index = 0; level_index < level; level_index++) {
+      size = std::max(1, size / 2);
+    }
+    return size;
+  }
+
+  /**
+   * Gets the map area a tile covers at its own scale. Edge tiles are smaller
+   * than the others and are not stretched to the map edge.
+   * @param tiled The tiled background.
+   * @param level The level of the tile.
+   * @param col The column of the tile.
+   * @param row The row of the tile.
+   * @return The area in map pixels.
+   */
+  sRectangle cTile_Cache::Get_Tile_Area(sTiled_Background& tiled, int level, int col, int row) {
+    int tile_span = tiled.tile_size << level; // Map pixels covered by one tile.
+    int tile_w = std::min(tiled.tile_size, Get_Level_Size(tiled.width, level) - col * tiled.tile_size);
+    int tile_h = std::min(tiled.tile_size, Get_Level_Size(tiled.height, level) - row * tiled.tile_size);
+    sRectangle area = { col * tile_span, row * tile_span, col * tile_span + (tile_w << level) - 1, row * tile_span + (tile_h << level) - 1 };
+    return area;
+  }
+
+  // **************************************************************************
+  // Level Index Implementation
+  // **************************************************************************
+
+  /**
+   * Creates an empty level index.
+   */
+  cLevel_Index::cLevel_Index() {
+    this->io = NULL;
+    this->watch_fd = NO_VALUE_FOUND;
+    this->changed = false;
+  }
+
+  /**
+   * Stops watching the folder.
+   */
+  cLevel_Index::~cLevel_Index() {
+    this->Close();
+  }
+
+  /**
+   * Opens the index for a folder. The saved index is checked against the
+   * folder once with stat calls, then the folder is watched for changes.
+   * @param io The I/O control used to list the folder.
+   * @param folder The folder holding the levels.
+   */
+  void cLevel_Index::Open(cIO_Control* io, std::string folder) {
+    this->Close();
+    this->io = io;
+    this->folder = folder;
+    this->levels.clear();
+    this->Load();
+    this->Poll();
+#ifdef __linux__
+    this->watch_fd = inotify_init1(IN_NONBLOCK);
+    if (this->watch_fd != NO_VALUE_FOUND) {
+      if (inotify_add_watch(this->watch_fd, folder.c_str(), IN_CLOSE_WRITE | IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO) < 0) {
+        close(this->watch_fd);
+        this->watch_fd = NO_VALUE_FOUND; // Fall back to polling.
+      }
+    }
+#endif
+    this->changed = true;
+  }
+
+  /**
+   * Closes the folder watch.
+   */
+  void cLevel_Index::Close() {
+#ifdef __linux__
+    if (this->watch_fd != NO_VALUE_FOUND) {
+      close(this->watch_fd);
+    }
+#endif
+    this->watch_fd = NO_VALUE_FOUND;
+  }
+
+  /**
+   * Brings the index up to date. A watched folder only rescans the files
+   * inotify reported. Without a watch the folder is polled on a timer.
+   * @return True if any level changed since the last refresh.
+   */
+  bool cLevel_Index::Refresh() {
+    if (this->watch_fd != NO_VALUE_FOUND) {
+      this->Read_Events();
+    }
+    else if (std::chrono::steady_clock::now() - this->last_poll >= std::chrono::milliseconds(LEVEL_POLL_MS)) {
+      this->Poll();
+    }
+    bool changed = this->changed;
+    if (changed) {
+      this->Save();
+    }
+    this->changed = false;
+    return changed;
+  }
+
+  /**
+   * Compares the folder against the index with stat calls. Only new or
+   * modified levels are read, and removed levels are dropped.
+   */
+  void cLevel_Index::Poll() {
+    this->last_poll = std::chrono::steady_clock::now();
+    cArray<std::string> files = this->io->Get_File_List(this->folder);
+    std::map<std::string, bool> present;
+    int file_count = files.Count();
+    for (int file_index = 0; file_index < file_count; file_index++) {
+      std::string& file = files[file_index];
+      if ((file.length() > 4) && (file.substr(file.length() - 4) == ".map")) {
+        present[this->io->Get_File_Title(file)] = true;
+        this->Update_Level(file);
+      }
+    }
+    std::map<std::string, sLevel_Entry>::iterator level = this->levels.begin();
+    while (level != this->levels.end()) {
+      if (present.find(level->first) == present.end()) {
+        level = this->levels.erase(level);
+        this->changed = true;
+      }
+      else {
+        ++level;
+      }
+    }
+  }
+
+  /**
+   * Applies the folder changes reported by inotify. Only the reported files
+   * are checked, unless events were lost and the whole folder is rescanned.
+   */
+  void cLevel_Index::Read_Events() {
+#ifdef __linux__
+    char buffer[4096];
+    bool rescan = false;
+    while (this->watch_fd != NO_VALUE_FOUND) {
+      int length = read(this->watch_fd, buffer, sizeof(buffer));
+      if (length <= 0) {
+        break;
+      }
+      int offset = 0;
+      while (offset < length) {
+        struct inotify_event* event = (struct inotify_event*)(buffer + offset);
+        std::string file = (event->len > 0) ? event->name : "";
+        if (event->mask & IN_Q_OVERFLOW) { // The kernel dropped events.
+          rescan = true;
+        }
+        else if (event->mask & IN_IGNORED) { // The folder is gone, so poll from now on.
+          this->Close();
+          rescan = true;
+          break;
+        }
+        else if ((file.length() > 4) && (file.substr(file.length() - 4) == ".map")) {
+          if (event->mask & (IN_DELETE | IN_MOVED_FROM)) {
+            this->levels.erase(this->io->Get_File_Title(file));
+            this->changed = true;
+          }
+          else {
+            this->Update_Level(file);
+          }
+        }
+        offset += sizeof(struct inotify_event) + event->len;
+      }
+    }
+    if (rescan) {
+      this->Poll();
+    }
+#endif
+  }
+
+  /**
+   * Rescans a level if its size or modification time changed.
+   * @param file The file name of the level.
+   */
+  void cLevel_Index::Update_Level(std::string file) {
+    struct stat level_stat;
+    std::string name = this->io->Get_File_Title(file);
+    if (stat((this->folder + "/" + file).c_str(), &level_stat) == 0) {
+      std::map<std::string, sLevel_Entry>::iterator level = this->levels.find(name);
+      if ((level == this->levels.end()) || (level->second.mtime != (long)level_stat.st_mtime) || (level->second.size != (long)level_stat.st_size)) {
+        sLevel_Entry& entry = this->levels[name];
+        entry.name = name;
+        entry.mtime = level_stat.st_mtime;
+        entry.size = level_stat.st_size;
+        try {
+          this->Scan_Level(entry);
+        }
+        catch (cError error) { // Keep listing levels that do not parse.
+          entry.layer_counts.clear();
+        }
+        this->changed = true;
+      }
+    }
+  }
+
+  /**
+   * Reads the meta data and sprite counts of a level.
+   * @param entry The entry of the level.
+   * @throws An error if the level could not be read.
+   */
+  void cLevel_Index::Scan_Level(sLevel_Entry& entry) {
+    std::vector<tObject> records;
+    cMap_Codec::Read_Map(this->folder + "/" + entry.name + ".map", records);
+    tObject& meta_data = records[0];
+    entry.background = meta_data.Does_Key_Exist("background") ? meta_data["background"].string : "";
+    entry.music = meta_data.Does_Key_Exist("music") ? meta_data["music"].string : "";
+    entry.layer_counts.clear();
+    int record_count = records.size();
+    for (int record_index = 1; record_index < record_count; record_index++) {
+      tObject& record = records[record_index];
+      if (record.Does_Key_Exist("layer")) {
+        entry.layer_counts[record["layer"].string]++;
+      }
+    }
+  }
+
+  /**
+   * Loads the saved index of the folder. Fields are separated by tabs and
+   * escaped, so names may hold any character. Lines that do not parse are
+   * skipped and their levels rescanned.
+   */
+  void cLevel_Index::Load() {
+    std::ifstream index_file(this->folder + "/Levels.idx", std::ios::binary);
+    std::string line;
+    while (std::getline(index_file, line)) {
+      if ((line.length() > 0) && (line[line.length() - 1] == '\r')) {
+        line.erase(line.length() - 1);
+      }
+      cArray<std::string> fields = Split_Fields(line);
+      if (fields.Count() >= 5) {
+        sLevel_Entry& entry = this->levels[fields[0]];
+        entry.name = fields[0];
+        entry.mtime = Text_To_Number(fields[1]);
+        entry.size = Text_To_Number(fields[2]);
+        entry.background = fields[3];
+        entry.music = fields[4];
+        int field_count = fields.Count();
+        for (int field_index = 5; field_index < field_count; field_index++) {
+          size_t split = fields[field_index].rfind(':'); // Layer names may hold colons.
+          if (split != std::string::npos) {
+            entry.layer_counts[fields[field_index].substr(0, split)] = Text_To_Number(fields[field_index].substr(split + 1));
+          }
+        }
+      }
+    }
+  }
+
+  /**
+   * Saves the index into the folder.
+   */
+  void cLevel_Index::Save() {
+    std::ofstream index_file(this->folder + "/Levels.idx", std::ios::binary);
+    for (std::map<std::string, sLevel_Entry>::iterator level = this->levels.begin(); level != this->levels.end(); ++level) {
+      sLevel_Entry& entry = level->second;
+      index_file << Escape_Field(entry.name) << "\t" << entry.mtime << "\t" << entry.size << "\t" << Escape_Field(entry.background) << "\t" << Escape_Field(entry.music);
+      for (std::map<std::string, int>::iterator count = entry.layer_counts.begin(); count != entry.layer_counts.end(); ++count) {
+        index_file << "\t" << Escape_Field(count->first) << ":" << count->second;
+      }
+      index_file << "\n";
+    }
+  }
+
+  /**
+   * Escapes a field of the saved index so it holds no tabs or line breaks.
+   * @param text The text of the field.
+   * @return The escaped field.
+   */
+  std::string cLevel_Index::Escape_Field(std::string text) {
+    std::string escaped = "";
+    int length = text.length();
+    for (int char_index = 0; char_index < length; char_index++) {
+      char letter = text[char_index];
+      if (letter == '\\') {
+        escaped += "\\\\";
+      }
+      else if (letter == '\t') {
+        escaped += "\\t";
+      }
+      else if (letter == '\n') {
+        escaped += "\\n";
+      }
+      else if (letter == '\r') {
+        escaped += "\\r";
+      }
+      else {
+        escaped += letter;
+      }
+    }
+    return escaped;
+  }
+
+  /**
+   * Splits a line of the saved index into its unescaped fields.
+   * @param line The line.
+   * @return The fields.
+   */
+  cArray<std::string> cLevel_Index::Split_Fields(std::string line) {
+    cArray<std::string> fields;
+    std::string field = "";
+    int length = line.length();
+    for (int char_index = 0; char_index < length; char_index++) {
+      char letter = line[char_index];
+      if (letter == '\t') {
+        fields.Add(field);
+        field = "";
+      }
+      else if ((letter == '\\') && (char_index + 1 < length)) {
+        char code = line[++char_index];
+        field += (code == 't') ? '\t' : (code == 'n') ? '\n' : (code == 'r') ? '\r' : code;
+      }
+      else {
+        field += letter;
+      }
+    }
+    fields.Add(field);
+    return fields;
+  }
+
+  /**
+   * Gets the level names in the format of the list component.
+   * @return The level names in order.
+   */
+  std::string cLevel_Index::Get_Level_List() {
+    cArray<std::string> names;
+    for (std::map<std::string, sLevel_Entry>::iterator level = this->levels.begin(); level != this->levels.end(); ++level) {
+      names.Add(level->first);
+    }
+    return Join(names, ";");
+  }
+
+  // **************************************************************************
+  // Layout Implementation
+  // **************************************************************************
+
+  /**
+   * Creates a new layout module.
+   * @param name The name of the layout file.
+   * @param config The name of the config file.
+   * @param io The I/O control.
+   * @throws An error if the layout could not be loaded.
+   */
+  cLayout::cLayout(std::string name, std::string config, cIO_Control* io) {
+    this->io = io;
+    // Load the config file.
+    cConfig layout_config(config + ".txt");
+    this->width = layout_config.Get_Property("width");
+    this->height = layout_config.Get_Property("height");
+    this->cell_w = layout_config.Get_Property("cell-w");
+    this->cell_h = layout_config.Get_Property("cell-h");
+    this->red = layout_config.Get_Property("red");
+    this->green = layout_config.Get_Property("green");
+    this->blue = layout_config.Get_Property("blue");
+    this->mouse_coords.x = 0;
+    this->mouse_coords.y = 0;
+    this->drag_coords.x = 0;
+    this->drag_coords.y = 0;
+    this->clicked_button = eBUTTON_NONE;
+    this->not_clicked = true;
+    // Recalculate dimensions to grid dimensions.
+    this->width /= this->cell_w;
+    this->height /= this->cell_h;
+    // Create the grid.
+    this->grid = new char* [this->height];
+    for (int row_index = 0; row_index < this->height; row_index++) {
+      this->grid[row_index] = new char[this->width];
+      for (int col_index = 0; col_index < this->width; col_index++) {
+        this->grid[row_index][col_index] = ' ';
+      }
+    }
+    // Load the layout.
+    this->Parse_Layout(name);
+  }
+
+  /**
+   * Frees the layout module.
+   */
+  cLayout::~cLayout() {
+    for (int row_index = 0; row_index < this->height; row_index++) {
+      delete[] this->grid[row_index];
+    }
+    delete[] this->grid;
+  }
+
+  /**
+   * Clears out the grid.
+   */
+  void cLayout::Clear_Grid() {
+    for (int row_index = 0; row_index < this->height; row_index++) {
+      for (int col_index = 0; col_index < this->width; col_index++) {
+        this->grid[row_index][col_index] = ' ';
+      }
+    }
+  }
+
+  /**
+   * Parses the grid given the layout.
+   * @param file The instance of the layout file.
+   * @throws An error if the grid could not be loaded.
+   */
+  void cLayout::Parse_Grid(cFile& file) {
+    for (int row_index = 0; row_index < this->height; row_index++) {
+      std::string line = file.Get_Line();
+      int col_count = (line.length() > this->width) ? this->width : line.length();
+      for (int col_index = 0; col_index < col_count; col_index++) {
+        char letter = line[col_index];
+        this->grid[row_index][col_index] = letter;
+      }
+    }
+  }
+
+  /**
+   * Parses the layout.
+   * @param name The name of the layout.
+   * @throws An error if something went wrong.
+   */
+  void cLayout::Parse_Layout(std::string name) {
+    cFile layout_file(name + ".txt");
+    layout_file.Read();
+    // Parse grid first.
+    this->Parse_Grid(layout_file);
+    // Parse the entities.
+    while (this->Has_Entity()) {
+      this->Parse_Entity();
+    }
+    // Parse the properties here!
+    this->Parse_Properties(layout_file);
+    // Run all component initializers.
+    int comp_count = this->components.Count();
+    for (int comp_index = 0; comp_index < comp_count; comp_index++) {
+      this->On_Component_Init(this->components.values[comp_index]);
+    }
+    // Run layout initializer.
+    this->On_Init();
+  }
+
+  /**
+   * Checks to see if there is an entity to parse.
+   * @return True if there is an entity, false otherwise.
+   */
+  bool cLayout::Has_Entity() {
+    bool has_entity = false;
+    for (int cell_y = 0; cell_y < this->height; cell_y++) {
+      for (int cell_x = 0; cell_x < this->width; cell_x++) {
+        char cell = this->grid[cell_y][cell_x];
+        if ((cell == '[') || (cell == '{') || (cell == '(') || (cell == '+')) { // Entity identifier.
+          has_entity = true;
+          break;
+        }
+      }
+    }
+    return has_entity;
+  }
+
+  /**
+   * Parses an entity and adds it to the component stack.
    * @throws An error if the entity is invalid.
    */
-  void cLayout::Parse_Entity() {
-    tObject entity;
-    entity["id"] = cValue("");
-    entity["type"] = cValue("");
-    entity["x"] = cValue(0);
-    entity["y"] = cValue(0);
-    entity["width"] = cValue(0);
-    entity["height"] = cValue(0);
-    for (int cell_y = 0; cell_y < this->height; cell_y++) {
-      for (int cell_x = 0; cell_x < this->width; cell_x++) {
-        char cell = this->grid[cell_y][cell_x];
-        if (cell == '+') {
-          entity["x"] = cell_x;
-          entity["y"] = cell_y;
-          entity["width"] = 1;
-          entity["height"] = 1;
-          entity["type"] = "box";
-          this->Parse_Box(entity);
-          // Break out of double loop.
-          cell_y = this->height;
-          break;
+  void cLayout::Parse_Entity() {
+    tObject entity;
+    entity["id"] = cValue("");
+    entity["type"] = cValue("");
+    entity["x"] = cValue(0);
+    entity["y"] = cValue(0);
+    entity["width"] = cValue(0);
+    entity["height"] = cValue(0);
+    for (int cell_y = 0; cell_y < this->height; cell_y++) {
+      for (int cell_x = 0; cell_x < this->width; cell_x++) {
+        char cell = this->grid[cell_y][cell_x];
+        if (cell == '+') {
+          entity["x"] = cell_x;
+          entity["y"] = cell_y;
+          entity["width"] = 1;
+          entity["height"] = 1;
+          entity["type"] = "box";
+          this->Parse_Box(entity);
+          // Break out of double loop.
+          cell_y = this->height;
+          break;
+        }
+        else if (cell == '[') {
+          entity["x"] = cell_x;
+          entity["y"] = cell_y;
+          entity["width"] = 1;
+          entity["height"] = 1;
+          entity["type"] = "field";
+          this->Parse_Field(entity);
+          // Break out of double loop.
+          cell_y = this->height;
+          break;
+        }
+        else if (cell == '{') {
+          entity["x"] = cell_x;
+          entity["y"] = cell_y;
+          entity["width"] = 1;
+          entity["height"] = 1;
+          entity["type"] = "panel";
+          this->Parse_Panel(entity);
+          // Break out of double loop.
+          cell_y = this->height;
+          break;
+        }
+        else if (cell == '(') {
+          entity["x"] = cell_x;
+          entity["y"] = cell_y;
+          entity["width"] = 1;
+          entity["height"] = 1;
+          entity["type"] = "button";
+          this->Parse_Button(entity);
+          // Break out of double loop.
+          cell_y = this->height;
+          break;
+        }
+        else {
+          continue; // Ignore but allow looking for other entities.
+        }
+      }
+    }
+    // Add to components.
+    this->components[entity["id"].string] = entity;
+  }
+
+  /**
+   * Parses a box structure.
+   * @param entity The associated entity.
+   * @throws An error if the box is invalid.
+   */
+  void cLayout::Parse_Box(tObject& entity) {
+    // We'll navigate in this path: right -> down -> left -> up
+    int pos_x = entity["x"].number; // Skip the plus.
+    int pos_y = entity["y"].number;
+    int rev_width = 1;
+    int rev_height = 1;
+    std::string id_str = "";
+    // Clear out first plus.
+    this->grid[pos_y][pos_x] = ' ';
+    // Navigate right.
+    pos_x++;
+    while (pos_x < this->width) {
+      char cell = this->grid[pos_y][pos_x];
+      if (cell == '+') {
+        entity["width"].number++;
+        entity["id"].string = id_str;
+        this->grid[pos_y][pos_x] = ' ';
+        break;
+      }
+      else if (this->Is_Identifier(cell)) { // Box Edge
+        if (this->Is_Identifier(cell)) {
+          id_str += cell; // Collect ID letter.
+        }
+        entity["width"].number++;
+        this->grid[pos_y][pos_x] = ' ';
+      }
+      else {
+        throw cError("Not a valid box. (right)");
+      }
+      pos_x++;
+    }
+    // Check for truncated object.
+    if (pos_x == this->width) {
+      throw cError("Truncated box. (width)");
+    }
+    // Navigate down.
+    pos_y++; // Skip the first plus.
+    while (pos_y < this->height) {
+      char cell = this->grid[pos_y][pos_x];
+      if (cell == '+') {
+        entity["height"].number++;
+        this->grid[pos_y][pos_x] = ' ';
+        break;
+      }
+      else if (cell == '|') {
+        entity["height"].number++;
+        this->grid[pos_y][pos_x] = ' ';
+      }
+      else {
+        throw cError("Not a valid box. (down)");
+      }
+      pos_y++;
+    }
+    // Check for truncated object.
+    if (pos_y == this->height) {
+      throw cError("Truncated box. (height)");
+    }
+    // Navigate left.
+    pos_x--; // Skip that first plus.
+    while (pos_x >= 0) {
+      char cell = this->grid[pos_y][pos_x];
+      if (cell == '+') {
+        rev_width++;
+        this->grid[pos_y][pos_x] = ' ';
+        break;
+      }
+      else if (cell == '-') {
+        rev_width++;
+        this->grid[pos_y][pos_x] = ' ';
+      }
+      else {
+        throw cError("Not a valid box. (left)");
+      }
+      pos_x--;
+    }
+    if (rev_width != entity["width"].number) {
+      throw cError("Not a valid box. (width mismatch)");
+    }
+    // Navigate up.
+    pos_y--;
+    while (pos_y >= 0) {
+      char cell = this->grid[pos_y][pos_x];
+      if (cell == ' ') { // Plus was removed but validated before.
+        rev_height++;
+        this->grid[pos_y][pos_x] = ' ';
+        break;
+      }
+      else if (cell == '|') {
+        rev_height++;
+        this->grid[pos_y][pos_x] = ' ';
+      }
+      else {
+        throw cError("Not a valid box. (up)");
+      }
+      pos_y--;
+    }
+    if (rev_height != entity["height"].number) {
+      throw cError("Not a valid box. (height mismatch)");
+    }
+  }
+
+  /**
+   * Parses a field entity.
+   * @param entity The associated entity.
+   * @throws An error if the field is invalid.
+   */
+  void cLayout::Parse_Field(tObject& entity) {
+    int pos_x = entity["x"].number;
+    int pos_y = entity["y"].number;
+    std::string id_str = "";
+    // Clear out initial bracket.
+    this->grid[pos_y][pos_x] = ' ';
+    // Parse out field.
+    pos_x++; // Pass over initial bracket.
+    while (pos_x < this->width) {
+      char cell = this->grid[pos_y][pos_x];
+      if (cell == ']') {
+        entity["width"].number++;
+        entity["id"].string = id_str;
+        this->grid[pos_y][pos_x] = ' ';
+        break;
+      }
+      else if (this->Is_Identifier(cell) || (cell == ' ')) {
+        if (this->Is_Identifier(cell)) {
+          id_str += cell;
+        }
+        entity["width"].number++;
+        this->grid[pos_y][pos_x] = ' ';
+      }
+      else {
+        throw cError("Not a valid field.");
+      }
+      pos_x++;
+    }
+    // Check for truncated object.
+    if (pos_x == this->width) {
+      throw cError("Truncated field.");
+    }
+  }
+
+  /**
+   * Parses a panel entity.
+   * @param entity The associated entity.
+   * @throws An error if the panel is invalid.
+   */
+  void cLayout::Parse_Panel(tObject& entity) {
+    int pos_x = entity["x"].number;
+    int pos_y = entity["y"].number;
+    std::string id_str = "";
+    // Clear out initial curly.
+    this->grid[pos_y][pos_x] = ' ';
+    // Skip over initial curly.
+    pos_x++;
+    // Go ahead and parse the rest.
+    while (pos_x < this->width) {
+      char cell = this->grid[pos_y][pos_x];
+      if (cell == '}') {
+        entity["width"].number++;
+        entity["id"].string = id_str;
+        this->grid[pos_y][pos_x] = ' ';
+        break;
+      }
+      else if (this->Is_Identifier(cell) || (cell == ' ')) {
+        if (this->Is_Identifier(cell)) {
+          id_str += cell;
+        }
+        entity["width"].number++;
+        this->grid[pos_y][pos_x] = ' ';
+      }
+      else {
+        throw cError("Not a valid panel.");
+      }
+      pos_x++;
+    }
+    // Check for truncated object.
+    if (pos_x == this->width) {
+      throw cError("Truncated panel.");
+    }
+  }
+
+  /**
+   * Parses a button entity.
+   * @param entity The associated entity.
+   * @throws An error if the button is invalid.
+   */
+  void cLayout::Parse_Button(tObject& entity) {
+    int pos_x = entity["x"].number;
+    int pos_y = entity["y"].number;
+    std::string id_str = "";
+    this->grid[pos_y][pos_x] = ' ';
+    pos_x++;
+    while (pos_x < this->width) {
+      char cell = this->grid[pos_y][pos_x];
+      if (cell == ')') {
+        entity["width"].number++;
+        entity["id"].string = id_str;
+        this->grid[pos_y][pos_x] = ' ';
+        break;
+      }
+      else if (this->Is_Identifier(cell) || (cell == ' ')) {
+        if (this->Is_Identifier(cell)) {
+          id_str += cell;
+        }
+        entity["width"].number++;
+        this->grid[pos_y][pos_x] = ' ';
+      }
+      else {
+        throw cError("Not a valid button.");
+      }
+      pos_x++;
+    }
+    // Check for truncated object.
+    if (pos_x == this->width) {
+      throw cError("Truncated button.");
+    }
+  }
+
+  /**
+   * Parses the properties associated with the layout.
+   * @param file The instance of the layout file.
+   * @throws An error if there is a problem with the layout.
+   */
+  void cLayout::Parse_Properties(cFile& file) {
+    while (file.Has_More_Lines()) {
+      std::string line = file.Get_Line();
+      cArray<std::string> pair = Parse_Sausage_Text(line, "->");
+      if (pair.Count() == 2) { // Property signature.
+        std::string entity_id = pair[0];
+        std::string value = pair[1];
+        if (this->components.Does_Key_Exist(entity_id)) {
+          cArray<std::string> props = Parse_Sausage_Text(value, ",");
+          int prop_count = props.Count();
+          for (int prop_index = 0; prop_index < prop_count; prop_index++) {
+            cArray<std::string> prop = Parse_Sausage_Text(props[prop_index], "=");
+            if (prop.Count() == 2) {
+              std::string name = prop[0];
+              std::string value = prop[1];
+              try {
+                this->components[entity_id][name] = cValue(Text_To_Number(value));
+              }
+              catch (cError number_error) { // A string.
+                this->components[entity_id][name] = cValue(value);
+              }
+            }
+            else {
+              throw cError("Property is missing value.");
+            }
+          }
+        }
+        else {
+          throw cError("Entity " + entity_id + " is not defined.");
+        }
+      }
+      else {
+        throw cError("Entity ID is missing properties.");
+      }
+    }
+  }
+
+  /**
+   * Renders the entities. Input is drained once per frame before any entity
+   * renders. Events are walked in the order they arrived, so a key goes to
+   * the component that had focus when it was pressed.
+   */
+  void cLayout::Render() {
+    // Render a background color.
+    this->io->Color(this->red, this->green, this->blue);
+    int entity_count = this->components.Count();
+    this->clicked = "";
+    this->input.Drain(this->io);
+    int event_count = this->input.events.size();
+    for (int event_index = 0; event_index < event_count; event_index++) {
+      sInput_Event& event = this->input.events[event_index];
+      if (event.signal.code == eSIGNAL_MOUSE) {
+        this->Route_Mouse(event.signal);
+      }
+      else {
+        event.target = this->sel_component;
+      }
+    }
+    for (int entity_index = 0; entity_index < entity_count; entity_index++) {
+      this->On_Component_Render(this->components.values[entity_index]);
+    }
+    this->input.Clear(); // Keys are never carried over to a component focused later.
+    cJob_System::Shared().Run_Main_Jobs(4);
+    // Render the screen.
+    this->io->Refresh();
+  }
+
+  /**
+   * Updates input focus and mouse coordinates from a mouse signal.
+   * @param signal The mouse signal.
+   */
+  void cLayout::Route_Mouse(sSignal& signal) {
+    if (((signal.button == eBUTTON_LEFT) || (signal.button == eBUTTON_RIGHT)) && this->not_clicked) {
+      int entity_count = this->components.Count();
+      for (int entity_index = 0; entity_index < entity_count; entity_index++) {
+        tObject& entity = this->components.values[entity_index];
+        sRectangle bump_map = this->Get_Entity_Dimensions(entity);
+        if (Is_Point_In_Box(signal.coords, bump_map)) { // Input focus.
+          if ((this->sel_component != this->components.keys[entity_index]) && this->components.Does_Key_Exist(this->sel_component)) {
+            this->On_Focus_Lost(this->components[this->sel_component]);
+          }
+          this->sel_component = this->components.keys[entity_index];
+          this->clicked = this->components.keys[entity_index];
+          // Normalize mouse coordinates to entity space.
+          this->mouse_coords.x = signal.coords.x - entity["x"].number;
+          this->mouse_coords.y = signal.coords.y - entity["y"].number;
+          this->drag_coords = this->mouse_coords;
+          this->clicked_button = signal.button;
+          this->not_clicked = false;
+          break;
+        }
+      }
+    }
+    else if (signal.button == eBUTTON_UP) {
+      this->not_clicked = true;
+    }
+    else if (!this->not_clicked && this->components.Does_Key_Exist(this->sel_component)) { // Dragging in the focused entity.
+      tObject& entity = this->components[this->sel_component];
+      this->drag_coords.x = signal.coords.x - entity["x"].number;
+      this->drag_coords.y = signal.coords.y - entity["y"].number;
+    }
+  }
+
+  /**
+   * Called when the component is initialized.
+   * @param entity The associated entity.
+   */
+  void cLayout::On_Component_Init(tObject& entity) {
+    // To be implemented in app.
+  }
+
+  /**
+   * Called when the component is rendered.
+   * @param entity The associated entity.
+   */
+  void cLayout::On_Component_Render(tObject& entity) {
+    // To be implemented in app.
+  }
+
+  /**
+   * Called when a component loses input focus to another one.
+   * @param entity The entity that lost focus.
+   */
+  void cLayout::On_Focus_Lost(tObject& entity) {
+    // To be implemented in app.
+  }
+
+  /**
+   * Gets the dimensions of an entity.
+   * @param entity The entity.
+   * @return The rectangle with the dimensions.
+   */
+  sRectangle cLayout::Get_Entity_Dimensions(tObject& entity) {
+    sRectangle dimensions;
+    dimensions.left = entity["x"].number;
+    dimensions.top = entity["y"].number;
+    dimensions.right = dimensions.left + entity["width"].number - 1;
+    dimensions.bottom = dimensions.top + entity["height"].number - 1;
+    return dimensions;
+  }
+
+  /**
+   * Determines if a letter is part of an identifier.
+   * @param letter The letter to test.
+   * @return True if the letter is an identifier, false if not.
+   */
+  bool cLayout::Is_Identifier(char letter) {
+    return (((letter >= 'a') && (letter <= 'z')) || ((letter >= 'A') && (letter <= 'Z')) || ((letter >= '0') && (letter <= '9')) || (letter == '_'));
+  }
+
+  /**
+   * Called when layout is initialized.
+   */
+  void cLayout::On_Init() {
+    // To be implemented in the app.
+  }
+
+  // **************************************************************************
+  // Input Queue Implementation
+  // **************************************************************************
+
+  /**
+   * Creates an empty input queue.
+   */
+  cInput_Queue::cInput_Queue() {
+    this->limit = 64;
+    this->recorder = NULL;
+  }
+
+  /**
+   * Reads all signals waiting in the I/O control in one pass. The sources
+   * carry no arrival times, so each round takes a key before a mouse
+   * signal; a key is then targeted before a click later in the frame moves
+   * the focus. Mouse moves collapse to the latest position and repeated
+   * scroll keys collapse into one event with a repeat count.
+   * @param io The I/O control.
+   */
+  void cInput_Queue::Drain(cIO_Control* io) {
+    if (this->recorder) {
+      this->recorder->Begin_Frame();
+    }
+    bool has_keys = true;
+    bool has_mouse = true;
+    for (int read_count = 0; (read_count < this->limit) && (has_keys || has_mouse); read_count++) {
+      if (has_keys) {
+        sSignal key = io->Read_Key();
+        has_keys = (key.code != eSIGNAL_NONE);
+        if (has_keys) {
+          if (this->recorder) {
+            this->recorder->Add_Signal("key", key);
+          }
+          this->Add(key);
+        }
+      }
+      if (has_mouse) {
+        sSignal signal = io->Read_Signal();
+        has_mouse = (signal.code != eSIGNAL_NONE); // End of the queue.
+        if (has_mouse) {
+          if (this->recorder) {
+            this->recorder->Add_Signal("mouse", signal);
+          }
+          this->Add(signal);
+        }
+      }
+    }
+  }
+
+  /**
+   * Adds a signal after the events read before it.
+   * @param signal The signal.
+   */
+  void cInput_Queue::Add(sSignal& signal) {
+    if (!this->events.empty()) {
+      sInput_Event& last = this->events.back();
+      bool is_move = (signal.code == eSIGNAL_MOUSE) && (signal.button == eBUTTON_NONE);
+      if (is_move && (last.signal.code == eSIGNAL_MOUSE) && (last.signal.button == eBUTTON_NONE)) { // Presses and releases keep their positions.
+        last.signal = signal;
+        return;
+      }
+      if ((last.signal.code == signal.code) && Is_Scroll_Key(signal.code)) {
+        last.repeat++;
+        return;
+      }
+    }
+    sInput_Event event;
+    event.signal = signal;
+    event.repeat = 1;
+    event.target = "";
+    this->events.push_back(event);
+  }
+
+  /**
+   * Takes the next key event of the frame that was pressed while a
+   * component had focus.
+   * @param target The name of the component.
+   * @param event The event that is read.
+   * @return True if there was an event, false if there are no more keys.
+   */
+  bool cInput_Queue::Next_Key(std::string target, sInput_Event& event) {
+    int event_count = this->events.size();
+    for (int event_index = 0; event_index < event_count; event_index++) {
+      sInput_Event& key = this->events[event_index];
+      if ((key.signal.code != eSIGNAL_MOUSE) && (key.target == target)) {
+        event = key;
+        this->events.erase(this->events.begin() + event_index);
+        return true;
+      }
+    }
+    return false;
+  }
+
+  /**
+   * Drops all events of the frame.
+   */
+  void cInput_Queue::Clear() {
+    this->events.clear();
+  }
+
+  /**
+   * Determines if a key scrolls components.
+   * @param code The signal code.
+   * @return True if the key scrolls, false otherwise.
+   */
+  bool cInput_Queue::Is_Scroll_Key(int code) {
+    return ((code == eSIGNAL_LEFT) || (code == eSIGNAL_RIGHT) || (code == eSIGNAL_UP) || (code == eSIGNAL_DOWN));
+  }
+
+  // **************************************************************************
+  // Map Editor Implementation
+  // **************************************************************************
+
+  /**
+   * Creates a new map editor.
+   * @param name The name of the layout file.
+   * @param config The config file name.
+   * @param io The I/O control.
+   * @param loader The loader that decodes images on first use or NULL if the I/O control has them all.
+   */
+  cMap_Editor::cMap_Editor(std::string name, std::string config, cIO_Control* io, cResource_Loader* loader) : cLayout(name, config, io) {
+    this->sprite_layers.reset(new cHash<std::string, tSprite_List>());
+    this->meta_data.reset(new tObject());
+    for (int layer_index = 0; layer_index < MAP_LAYER_COUNT; layer_index++) {
+      (*this->sprite_layers)[MAP_LAYERS[layer_index]] = tSprite_List();
+    }
+    (*this->meta_data)["background"].Set_String("");
+    (*this->meta_data)["music"].Set_String("");
+    this->sel_layer = "background";
+    this->sel_sprite = NO_VALUE_FOUND;
+    this->loader = loader;
+    this->tile_cache.loader = loader;
+    this->documents.push_back(std::unique_ptr<sMap_Document>(this->Create_Document(""))); // Slot of the map being edited.
+    this->active_document = 0;
+    this->map_encoding = eMAP_TEXT;
+    this->map_token = cJob_System::New_Token();
+    this->inspector.index = NO_VALUE_FOUND;
+    this->inspector.revision = NO_VALUE_FOUND;
+    this->inspector.edit_row = NO_VALUE_FOUND;
+    this->map_revision = 0;
+    this->memory_revision = NO_VALUE_FOUND;
+    std::random_device seed;
+    this->uid_source.seed(((unsigned long long)seed() << 32) ^ seed() ^ (unsigned long long)std::chrono::steady_clock::now().time_since_epoch().count());
+    Check_Condition(this->components.Does_Key_Exist("layer"), "No layer field.");
+    this->components["layer"]["text"].Set_String(this->sel_layer);
+  }
+
+  /**
+   * Abandons background jobs that would report back to the editor.
+   */
+  cMap_Editor::~cMap_Editor() {
+    this->map_token->store(true);
+  }
+
+  /**
+   * Called when a component is initialized.
+   * @param entity The entity that is initialized.
+   */
+  void cMap_Editor::On_Component_Init(tObject& entity) {
+    if (entity["id"].string == "field") {
+      this->Init_Field(entity);
+    }
+    else if (entity["id"].string == "grid-view") {
+      this->Init_Grid_View(entity);
+    }
+    else if (entity["id"].string == "list") {
+      this->Init_List(entity);
+    }
+    else if (entity["id"].string == "toolbar") {
+      this->Init_Toolbar(entity);
+    }
+    else if (entity["id"].string == "map-editor") {
+      this->Init_Map_Editor(entity);
+    }
+  }
+
+  /**
+   * Called when a component needs to be rendered.
+   * @param entity The entity to be rendered.
+   */
+  void cMap_Editor::On_Component_Render(tObject& entity) {
+    // Clear out the component. Make background white.
+    this->io->Color(255, 255, 255);
+    if (entity["id"].string == "field") {
+      this->Render_Field(entity);
+    }
+    else if (entity["id"].string == "label") {
+      this->Render_Label(entity);
+    }
+    else if (entity["id"].string == "grid-view") {
+      this->Render_Grid_View(entity);
+    }
+    else if (entity["id"].string == "button") {
+      this->Render_Button(entity);
+    }
+    else if (entity["id"].string == "toolbar") {
+      this->Render_Toolbar(entity);
+    }
+    else if (entity["id"].string == "list") {
+      this->Render_List(entity);
+    }
+    else if (entity["id"].string == "map-editor") {
+      this->Render_Map_Editor(entity);
+    }
+    // Draw the canvas of the component.
+    this->io->Draw_Canvas(entity["x"].number * this->cell_w, entity["y"].number * this->cell_h, entity["width"].number * this->cell_w, entity["height"].number * this->cell_h);
+  }
+
+  /**
+   * Called when the map editor is initialized.
+   */
+  void cMap_Editor::On_Init() {
+    this->io->Set_Canvas_Target(); // We need to render to canvas for clipping.
+  }
+
+  /**
+   * Called when a component loses input focus. Typed text is committed here.
+   * @param entity The entity that lost focus.
+   */
+  void cMap_Editor::On_Focus_Lost(tObject& entity) {
+    if (entity["type"].string == "field") {
+      this->Commit_Field(entity);
+    }
+    else if (entity["type"].string == "grid-view") {
+      this->Commit_Inspector_Row(entity);
+    }
+  }
+
+  /**
+   * Loads the catalog from a file.
+   * @param name The name of the file to load.
+   * @throws An error if there was something wrong.
+   */
+  void cMap_Editor::Load_Catalog(std::string name) {
+    this->catalog.Clear();
+    this->catalog_lookup.clear();
+    this->catalog_index.Load(name);
+    // Entries are only named here. They are parsed when first used.
+    int entry_count = this->catalog_index.entries.size();
+    for (int entry_index = 0; entry_index < entry_count; entry_index++) {
+      std::string& sprite_name = this->catalog_index.entries[entry_index].name;
+      this->catalog[sprite_name] = tObject();
+      this->catalog_lookup[sprite_name] = entry_index;
+    }
+    if (this->catalog.Count() > 0) { // Select the first catalog key.
+      this->sel_sprite_id = this->catalog.keys[0];
+    }
+    else {
+      throw cError("No sprites in catalog!");
+    }
+  }
+
+  /**
+   * Loads a map from a file.
+   * @param name The name of the file to load.
+   * @throws An error if the map could not be loaded.
+   */
+  void cMap_Editor::Load_Map(std::string name) {
+    std::vector<tObject> records;
+    eMap_Encoding encoding = cMap_Codec::Read_Map(name + ".map", records);
+    this->Prefetch_Images(records);
+    this->Clear_Map();
+    this->map_encoding = encoding; // Saved back the way it was read.
+    *this->meta_data = records[0];
+    std::vector<std::string> problems;
+    Check_Meta_Data(*this->meta_data, problems);
+    Check_Problems(problems);
+    std::map<std::string, int> layer_counts;
+    std::unordered_set<std::string> uids;
+    int record_count = records.size();
+    for (int record_index = 1; record_index < record_count; record_index++) {
+      this->Add_Record(records[record_index], layer_counts, uids);
+    }
+    // Set fields.
+    Check_Condition(this->components.Does_Key_Exist("level_name"), "No level name field.");
+    Check_Condition(this->components.Does_Key_Exist("background"), "No background field.");
+    Check_Condition(this->components.Does_Key_Exist("music"), "No music field.");
+    this->components["level_name"]["text"].Set_String(name);
+    this->components["background"]["text"].Set_String((*this->meta_data)["background"].string);
+    this->components["music"]["text"].Set_String((*this->meta_data)["music"].string);
+  }
+
+  /**
+   * Saves a map to a file.
+   * @param name The name of the file to save to.
+   * @throws An error if the map could not be saved.
+   */
+  void cMap_Editor::Save_Map(std::string name) {
+    this->Compact_Layers(); // Slots the history no longer needs are not worth keeping.
+    std::vector<tObject> records;
+    if (this->map_encoding == eMAP_TEXT) { // Streamed from the layers without a copy of the map.
+      cMap_Writer writer(name + ".map");
+      writer.Write_Object(*this->meta_data);
+      int layer_count = this->sprite_layers->Count();
+      for (int layer_index = 0; layer_index < layer_count; layer_index++) {
+        std::string& layer = this->sprite_layers->keys[layer_index];
+        tSprite_List& sprites = this->sprite_layers->values[layer_index];
+        int sprite_count = sprites.Count();
+        for (int sprite_index = 0; sprite_index < sprite_count; sprite_index++) {
+          if (sprites[sprite_index].alive) { // Deleted but kept for undo otherwise.
+            writer.Write_Sprite(sprites[sprite_index]);
+          }
+        }
+        if (this->tile_layers.find(layer) != this->tile_layers.end()) {
+          tObject record = this->Encode_Tile_Layer(layer);
+          writer.Write_Object(record);
+        }
+      }
+      writer.Commit();
+      return;
+    }
+    records.push_back(*this->meta_data);
+    int layer_count = this->sprite_layers->Count();
+    for (int layer_index = 0; layer_index < layer_count; layer_index++) {
+      std::string name = this->sprite_layers->keys[layer_index];
+      tSprite_List& sprites = (*this->sprite_layers)[name];
+      int sprite_count = sprites.Count();
+      for (int sprite_index = 0; sprite_index < sprite_count; sprite_index++) {
+        if (!sprites[sprite_index].alive) { // Deleted but kept for undo.
+          continue;
+        }
+        records.push_back(sprites[sprite_index].Get_Record()); // Only the overrides are written.
+      }
+      if (this->tile_layers.find(name) != this->tile_layers.end()) {
+        records.push_back(this->Encode_Tile_Layer(name));
+      }
+    }
+    cMap_Codec::Write_Map(name + ".map", records, this->map_encoding);
+  }
+
+  /**
+   * Adds a sprite or tile layer record to the map without recording an edit.
+   * Sprites from older maps get the id cMap_Diff::Get_Uid gives them, so the
+   * same file loads with the same ids. An id already used in the map is
+   * replaced by a new one.
+   * @param record The record read from a map.
+   * @param layer_counts Counts sprites without ids in each layer.
+   * @param uids The ids of the records added so far.
+   * @throws An error if the record is not valid.
+   */
+  void cMap_Editor::Add_Record(tObject& record, std::map<std::string, int>& layer_counts, std::unordered_set<std::string>& uids) {
+    if (record.Does_Key_Exist("tiles")) { // Dense tile layer.
+      this->Decode_Tile_Layer(record);
+      return;
+    }
+    std::string uid = cMap_Diff::Get_Uid(record, layer_counts);
+    cSprite sprite = this->Create_Sprite(record);
+    std::string layer = sprite.Does_Key_Exist(eKEY_LAYER) ? sprite.Get_Text(eKEY_LAYER) : "";
+    std::vector<std::string> problems;
+    Check_Layer(sprite.Does_Key_Exist(eKEY_LAYER), layer, "sprite", problems);
+    Check_Problems(problems);
+    while (!uids.insert(uid).second) { // Duplicated id.
+      uid = this->New_Uid();
+    }
+    if (!sprite.Does_Key_Exist(eKEY_UID) || (sprite.Get_Text(eKEY_UID) != uid)) {
+      sprite.Set("uid", cValue(uid));
+    }
+    (*this->sprite_layers)[layer].Add(sprite); // Add sprite to respective layer.
+  }
+
+  /**
+   * Creates a stable sprite id. Ids are random so sprites placed by different
+   * people on copies of a map do not collide when the copies are merged.
+   * @return The id as 12 hex digits.
+   */
+  std::string cMap_Editor::New_Uid() {
+    static const char digits[] = "0123456789abcdef";
+    unsigned long long bits = this->uid_source();
+    std::string uid(12, '0');
+    for (int digit_index = 0; digit_index < 12; digit_index++) {
+      uid[digit_index] = digits[(bits >> (digit_index * 4)) & 15];
+    }
+    return uid;
+  }
+
+  /**
+   * Gets the records of the map as Save_Map writes them, keyed by stable id.
+   * @param records Receives the meta data, sprite and tile layer records.
+   */
+  void cMap_Editor::Get_Map_Records(std::vector<sMap_Record>& records) {
+    std::map<std::string, int> layer_counts;
+    sMap_Record meta = { "meta", *this->meta_data };
+    records.push_back(meta);
+    int layer_count = this->sprite_layers->Count();
+    for (int layer_index = 0; layer_index < layer_count; layer_index++) {
+      std::string& name = this->sprite_layers->keys[layer_index];
+      tSprite_List& sprites = this->sprite_layers->values[layer_index];
+      int sprite_count = sprites.Count();
+      for (int sprite_index = 0; sprite_index < sprite_count; sprite_index++) {
+        if (sprites[sprite_index].alive) {
+          sMap_Record record = { "", sprites[sprite_index].Get_Record() };
+          record.uid = cMap_Diff::Get_Uid(record.record, layer_counts);
+          records.push_back(record);
+        }
+      }
+      if (this->tile_layers.find(name) != this->tile_layers.end()) {
+        sMap_Record record = { "", this->Encode_Tile_Layer(name) };
+        record.uid = cMap_Diff::Get_Uid(record.record, layer_counts);
+        records.push_back(record);
+      }
+    }
+  }
+
+  /**
+   * Hashes the records of the map as Save_Map writes them. Equal maps give
+   * equal hashes regardless of the file encoding.
+   * @return The hash as 16 hex digits.
+   */
+  std::string cMap_Editor::Get_Map_Hash() {
+    std::vector<sMap_Record> records;
+    this->Get_Map_Records(records);
+    unsigned long long hash = 14695981039346656037ULL; // FNV-1a
+    auto Add_Text = [&hash](const std::string& text) {
+      int length = text.length();
+      for (int char_index = 0; char_index < length; char_index++) {
+        hash = (hash ^ (unsigned char)text[char_index]) * 1099511628211ULL;
+      }
+    };
+    int record_count = records.size();
+    for (int record_index = 0; record_index < record_count; record_index++) {
+      tObject& record = records[record_index].record;
+      int key_count = record.Count();
+      for (int key_index = 0; key_index < key_count; key_index++) {
+        cValue& value = record.values[key_index];
+        Add_Text(record.keys[key_index]);
+        Add_Text((value.type == eVALUE_NUMBER) ? "=#" + Number_To_Text(value.number) : "=" + value.string);
+        Add_Text(";");
+      }
+      Add_Text("\n");
+    }
+    std::ostringstream text;
+    text << std::hex << std::setw(16) << std::setfill('0') << hash;
+    return text.str();
+  }
+
+  /**
+   * Compares the map in the editor with a map file.
+   * @param name The name of the map file to compare with.
+   * @param changes Receives the changes from the file to the editor.
+   * @throws An error if the map could not be read.
+   */
+  void cMap_Editor::Diff_Map(std::string name, std::vector<sProperty_Change>& changes) {
+    std::vector<sMap_Record> saved;
+    std::vector<sMap_Record> current;
+    cMap_Diff::Read_Map(name, saved);
+    this->Get_Map_Records(current);
+    cMap_Diff::Diff(saved, current, changes);
+  }
+
+  /**
+   * Merges the changes made in another copy of the map into the editor. The
+   * merge replaces the undo history. The merged map is built in a scratch
+   * document and the edited map is only replaced once every record loads.
+   * @param base The name of the map both copies started from.
+   * @param theirs The name of the other copy.
+   * @param conflicts Receives the properties changed differently in both.
+   * @throws An error if a map could not be read.
+   */
+  void cMap_Editor::Merge_Map(std::string base, std::string theirs, std::vector<sProperty_Change>& conflicts) {
+    std::vector<sMap_Record> base_records;
+    std::vector<sMap_Record> our_records;
+    std::vector<sMap_Record> their_records;
+    std::vector<sMap_Record> merged;
+    cMap_Diff::Read_Map(base, base_records);
+    cMap_Diff::Read_Map(theirs, their_records);
+    this->Get_Map_Records(our_records);
+    cMap_Diff::Merge(base_records, our_records, their_records, merged, conflicts);
+    std::unique_ptr<sMap_Document> ours(this->Create_Document(""));
+    int sel_sprite = this->sel_sprite;
+    this->Swap_Document(*ours); // Our map waits in the scratch slot.
+    try {
+      this->Clear_Map();
+      *this->meta_data = merged[0].record;
+      std::map<std::string, int> layer_counts;
+      std::unordered_set<std::string> uids;
+      int record_count = merged.size();
+      for (int record_index = 1; record_index < record_count; record_index++) {
+        sMap_Record& record = merged[record_index];
+        if (!record.record.Does_Key_Exist("uid") && !record.record.Does_Key_Exist("tiles")) { // Keeps the id the merge matched it by.
+          record.record["uid"] = cValue(record.uid);
+        }
+        this->Add_Record(record.record, layer_counts, uids);
+      }
+    }
+    catch (cError error) {
+      this->Clear_Map(); // Drops the jobs of the partial merge.
+      this->Swap_Document(*ours);
+      this->sel_sprite = sel_sprite;
+      throw;
+    }
+  }
+
+  /**
+   * Creates an empty map document with the map layers.
+   * @param name The name of the map.
+   * @return The new document.
+   */
+  sMap_Document* cMap_Editor::Create_Document(std::string name) {
+    sMap_Document* document = new sMap_Document();
+    document->name = name;
+    document->sprite_layers.reset(new cHash<std::string, tSprite_List>());
+    document->meta_data.reset(new tObject());
+    for (int layer_index = 0; layer_index < MAP_LAYER_COUNT; layer_index++) {
+      (*document->sprite_layers)[MAP_LAYERS[layer_index]] = tSprite_List();
+    }
+    (*document->meta_data)["background"].Set_String("");
+    (*document->meta_data)["music"].Set_String("");
+    document->sel_layer = "background";
+    document->map_encoding = eMAP_TEXT;
+    return document;
+  }
+
+  /**
+   * Exchanges the map being edited with a document. Layers and meta data are
+   * exchanged by pointer and the standard containers by their own swaps, so
+   * nothing is copied. The map in the editor always has its arena in the
+   * editor, so the arena pointers of its sprites stay valid across switches.
+   * @param document The document to exchange with.
+   */
+  void cMap_Editor::Swap_Document(sMap_Document& document) {
+    std::swap(this->sprite_layers, document.sprite_layers);
+    std::swap(this->meta_data, document.meta_data);
+    std::swap(this->history, document.history);
+    std::swap(this->selection, document.selection);
+    std::swap(this->spatial, document.spatial);
+    std::swap(this->z_orders, document.z_orders);
+    std::swap(this->tile_layers, document.tile_layers);
+    std::swap(this->overlaps, document.overlaps);
+    std::swap(this->sel_layer, document.sel_layer);
+    std::swap(this->map_encoding, document.map_encoding);
+    this->arena.Swap(document.arena);
+    int comp_count = this->components.Count();
+    for (int comp_index = 0; comp_index < comp_count; comp_index++) { // Scroll and zoom go with the map.
+      tObject& entity = this->components.values[comp_index];
+      if (entity.Does_Key_Exist("type") && (entity["type"].string == "map-editor")) {
+        const char* view_keys[] = { "scroll-x", "scroll-y", "zoom", "scroll-step", "sel-sprite" };
+        for (int key_index = 0; key_index < 5; key_index++) {
+          cValue value = entity[view_keys[key_index]];
+          if (document.view.Does_Key_Exist(view_keys[key_index])) {
+            entity[view_keys[key_index]] = document.view[view_keys[key_index]];
+          }
+          document.view[view_keys[key_index]] = value;
+        }
+      }
+    }
+  }
+
+  /**
+   * Makes another open map the one being edited.
+   * @param index The index of the document.
+   */
+  void cMap_Editor::Switch_Document(int index) {
+    Check_Condition((index >= 0) && (index < (int)this->documents.size()), "No open map " + Number_To_Text(index) + ".");
+    if (index != this->active_document) {
+      this->Cancel_Map_Jobs(); // Results would land in the other map.
+      this->map_revision++;
+      this->Swap_Document(*this->documents[this->active_document]); // Park the current map in its slot.
+      this->Swap_Document(*this->documents[index]);
+      this->active_document = index;
+      this->sel_sprite = NO_VALUE_FOUND;
+      this->components["level_name"]["text"].Set_String(this->documents[index]->name);
+      this->components["background"]["text"].Set_String((*this->meta_data)["background"].string);
+      this->components["music"]["text"].Set_String((*this->meta_data)["music"].string);
+      this->components["layer"]["text"].Set_String(this->sel_layer);
+    }
+  }
+
+  /**
+   * Opens a map in its own document or switches to it if it is open. The
+   * catalog, images and layout are shared by all documents. A map that does
+   * not load leaves no document behind.
+   * @param name The name of the map.
+   * @return The index of the document.
+   * @throws An error if the map could not be loaded.
+   */
+  int cMap_Editor::Open_Map(std::string name) {
+    int index = this->Find_Document(name);
+    if (index == NO_VALUE_FOUND) {
+      int previous = this->active_document;
+      sMap_Document& active = *this->documents[previous];
+      if ((active.name == "") && this->Is_Map_Empty()) { // Reuse the empty start document.
+        index = previous;
+      }
+      else {
+        this->documents.push_back(std::unique_ptr<sMap_Document>(this->Create_Document(""))); // Named once it loads.
+        index = this->documents.size() - 1;
+        this->Switch_Document(index);
+      }
+      try {
+        this->Load_Map(name);
+      }
+      catch (cError error) {
+        if (index == previous) { // Back to an empty start document.
+          std::unique_ptr<sMap_Document> empty(this->Create_Document(""));
+          this->Clear_Map();
+          this->Swap_Document(*empty);
+        }
+        else {
+          this->Switch_Document(previous);
+          this->documents.erase(this->documents.begin() + index);
+        }
+        throw;
+      }
+      this->documents[index]->name = name;
+    }
+    else {
+      this->Switch_Document(index);
+    }
+    return index;
+  }
+
+  /**
+   * Tells whether the map being edited has nothing that opening another map
+   * over it would lose.
+   * @return True if the map has no meta data, sprites, tiles or history.
+   */
+  bool cMap_Editor::Is_Map_Empty() {
+    if (((*this->meta_data)["background"].string != "") || ((*this->meta_data)["music"].string != "")) {
+      return false;
+    }
+    if (!this->history.undo_stack.empty() || !this->history.redo_stack.empty() || !this->tile_layers.empty()) {
+      return false;
+    }
+    int layer_count = this->sprite_layers->Count();
+    for (int layer_index = 0; layer_index < layer_count; layer_index++) {
+      tSprite_List& sprites = this->sprite_layers->values[layer_index];
+      int sprite_count = sprites.Count();
+      for (int sprite_index = 0; sprite_index < sprite_count; sprite_index++) {
+        if (sprites[sprite_index].alive) {
+          return false;
+        }
+      }
+    }
+    return true;
+  }
+
+  /**
+   * Closes the map being edited and switches to a neighbor. The last map is
+   * cleared instead.
+   */
+  void cMap_Editor::Close_Document() {
+    if (this->documents.size() == 1) {
+      this->Clear_Map();
+      this->documents[0]->name = "";
+    }
+    else {
+      int closing = this->active_document;
+      this->Switch_Document((closing > 0) ? closing - 1 : 1);
+      this->documents.erase(this->documents.begin() + closing);
+      if (this->active_document > closing) {
+        this->active_document--;
+      }
+    }
+  }
+
+  /**
+   * Finds an open map.
+   * @param name The name of the map.
+   * @return The index of the document or NO_VALUE_FOUND.
+   */
+  int cMap_Editor::Find_Document(std::string name) {
+    int document_count = this->documents.size();
+    for (int document_index = 0; document_index < document_count; document_index++) {
+      if (this->documents[document_index]->name == name) {
+        return document_index;
+      }
+    }
+    return NO_VALUE_FOUND;
+  }
+
+  /**
+   * Initializes the field component.
+   * @param entity The field entity.
+   */
+  void cMap_Editor::Init_Field(tObject& entity) {
+    entity["text"].Set_String("");
+    entity["edited"].Set_Number(0);
+  }
+
+  /**
+   * Commits text typed into a field. The background and music fields edit the
+   * meta data so they can be undone.
+   * @param entity The field entity.
+   */
+  void cMap_Editor::Commit_Field(tObject& entity) {
+    std::string key = entity["id"].string;
+    if (entity.Does_Key_Exist("edited") && entity["edited"].number && ((key == "background") || (key == "music"))) {
+      if (!this->meta_data->Does_Key_Exist(key) || ((*this->meta_data)[key].string != entity["text"].string)) {
+        this->Set_Meta_Data(key, cValue(entity["text"].string));
+      }
+    }
+    entity["edited"].Set_Number(0);
+  }
+
+  /**
+   * Renders a field entity.
+   * @param entity The field component.
+   */
+  void cMap_Editor::Render_Field(tObject& entity) {
+    int dy = entity["height"].number - this->io->Get_Text_Height(entity["text"].string) / 2;
+    int width = this->io->Get_Text_Width(entity["text"].string);
+    int limit = entity["width"].number - 4;
+    if (this->sel_component == entity["id"].string) { // Does field have input focus?
+      if (width < limit) { // Only allow text if input has space.
+        sInput_Event event;
+        while ((width < limit) && this->input.Next_Key(entity["id"].string, event)) {
+          sSignal& signal = event.signal;
+          if ((signal.code >= ' ') && (signal.code <= '~')) {
+            entity["text"].string += (char)signal.code;
+            entity["edited"].Set_Number(1);
+          }
+          else if (signal.code == eSIGNAL_BACKSPACE) {
+            entity["text"].string = entity["text"].string.substr(0, entity["text"].string.length() - 1); // Decrease string.
+            entity["edited"].Set_Number(1);
+          }
+          else if (signal.code == eSIGNAL_ENTER) {
+            this->Commit_Field(entity);
+          }
+          else if (signal.code == eSIGNAL_DELETE) {
+            entity["text"].string = ""; // Clear out
+            entity["edited"].Set_Number(1);
+          }
+          width = this->io->Get_Text_Width(entity["text"].string);
+        }
+      }
+      // Highlight the field.
+      this->io->Box(0, 0, entity["width"].number * this->cell_w, entity["height"].number * this->cell_h, 0, 255, 0);
+    }
+    else {
+      this->io->Box(0, 0, entity["width"].number * this->cell_w, entity["height"].number * this->cell_h, 0, 0, 0);
+    }
+    // Render the field.
+    this->io->Box(1, 1, entity["width"].number * this->cell_w - 2, entity["height"].number * this->cell_h - 2, 255, 255, 255);
+    this->io->Output_Text(entity["text"].string, 2, dy, 0, 0, 0);
+  }
+
+  /**
+   * Initializes a grid view component.
+   * @param entity The grid view entity.
+   */
+  void cMap_Editor::Init_Grid_View(tObject& entity) {
+    Check_Condition(entity.Does_Key_Exist("columns"), "No column count specified for grid view.");
+    entity["grid-x"].Set_Number(NO_VALUE_FOUND);
+    entity["grid-y"].Set_Number(NO_VALUE_FOUND);
+    entity["scroll-x"].Set_Number(0);
+    entity["scroll-y"].Set_Number(0);
+    entity["text"].Set_String("");
+  }
+
+  /**
+   * Renders a grid view component.
+   * @param entity The grid view entity.
+   */
+  void cMap_Editor::Render_Grid_View(tObject& entity) {
+    this->Sync_Inspector(entity);
+    cArray<std::string> data = Parse_Sausage_Text(entity["text"].string, ";");
+    if ((data.Count() % entity["columns"].number) == 0) { // Does data match column count?
+      int row_count = data.Count() / entity["columns"].number;
+      int col_count = entity["columns"].number;
+      int cell_width = entity["width"].number / col_count;
+      int cell_height = this->io->Get_Text_Height(entity["text"].string) + 4;
+      for (int grid_y = 0; grid_y < row_count; grid_y++) {
+        for (int grid_x = 0; grid_x < col_count; grid_x++) {
+          std::string& text = data[grid_y * col_count + grid_x];
+          if (this->sel_component == entity["id"].string) { // Does field have input focus?
+            sRectangle cell_map = { grid_x * cell_width - entity["scroll-x"].number,
+                                    grid_y * cell_height - entity["scroll-y"].number,
+                                    grid_x * cell_width + cell_width - 1 - entity["scroll-x"].number,
+                                    grid_y * cell_height + cell_height - 1 - entity["scroll-y"].number };
+            bool bound = (this->inspector.index != NO_VALUE_FOUND);
+            bool editing = bound && (this->inspector.edit_row != NO_VALUE_FOUND);
+            if (editing ? ((grid_y == this->inspector.edit_row) && (grid_x == 1)) : Is_Point_In_Box(this->mouse_coords, cell_map)) { // An edited row keeps the keys until Enter or focus loss.
+              int width = this->io->Get_Text_Width(text);
+              if ((width < cell_width) && (!bound || ((grid_x > 0) && !Is_Read_Only_Key(this->inspector.keys[grid_y])))) { // Only allow text if input has space. Bound keys are fixed.
+                std::string old_text = text;
+                bool commit = false;
+                sInput_Event event;
+                while ((width < cell_width) && this->input.Next_Key(entity["id"].string, event)) {
+                  sSignal& signal = event.signal;
+                  if (bound && (signal.code == eSIGNAL_ENTER)) {
+                    commit = true;
+                    break;
+                  }
+                  else if (bound && (signal.code == eSIGNAL_ESCAPE)) { // Puts the old value back.
+                    this->inspector.edit_row = NO_VALUE_FOUND;
+                    this->inspector.revision = NO_VALUE_FOUND;
+                    return;
+                  }
+                  else if ((signal.code >= ' ') && (signal.code <= '~')) {
+                    text += (char)signal.code;
+                  }
+                  else if (signal.code == eSIGNAL_BACKSPACE) {
+                    text = text.substr(0, text.length() - 1); // Decrease string.
+                  }
+                  else if (signal.code == eSIGNAL_DELETE) {
+                    text = ""; // Clear out
+                  }
+                  this->Scroll_Component(entity, signal, event.repeat);
+                  width = this->io->Get_Text_Width(text);
+                }
+                entity["grid-x"].Set_Number(grid_x);
+                entity["grid-y"].Set_Number(grid_y);
+                entity["text"].Set_String(Join(data, ";")); // Update text.
+                if (bound && (text != old_text)) {
+                  this->inspector.edit_row = grid_y;
+                }
+                if (commit) {
+                  this->Commit_Inspector_Row(entity);
+                  return; // Drawn from the rebound text next frame.
+                }
+              }
+              // Highlight the field.
+              this->io->Box(0 - entity["scroll-x"].number, 0 - entity["scroll-y"].number, entity["width"].number * this->cell_w, entity["height"].number * this->cell_h, 0, 255, 0);
+            }
+          }
+          else {
+            this->io->Box(0 - entity["scroll-x"].number, 0 - entity["scroll-y"].number, entity["width"].number * this->cell_w, entity["height"].number * this->cell_h, 0, 0, 0);
+          }
+          this->io->Box(grid_x * cell_width - entity["scroll-x"].number, grid_y * cell_height - entity["scroll-y"].number, cell_width, cell_height, 0, 0, 0);
+          this->io->Box(grid_x * cell_width + 1 - entity["scroll-x"].number, grid_y * cell_height + 1 - entity["scroll-y"].number, cell_width - 2, cell_height - 2, 255, 255, 255);
+          this->io->Output_Text(text, grid_x * cell_width + 2 - entity["scroll-x"].number, grid_y * cell_height + 2 - entity["scroll-y"].number, 0, 0, 0);
+        }
+      }
+    }
+  }
+
+  /**
+   * Binds the grid view to the selected sprite again after the selection or
+   * the map changed. An edit left in a cell is committed when the grid view
+   * loses focus.
+   * @param grid_view The grid view entity.
+   */
+  void cMap_Editor::Sync_Inspector(tObject& grid_view) {
+    tObject& map_editor = this->Get_Component("map-editor");
+    bool same_sprite = (this->inspector.layer == this->sel_layer) && (this->inspector.index == map_editor["sel-sprite"].number);
+    if (same_sprite && (this->inspector.revision == this->map_revision)) {
+      return;
+    }
+    if (this->inspector.edit_row != NO_VALUE_FOUND) {
+      if (same_sprite) { // The map changed under the edit. The commit finds the sprite by its id.
+        return;
+      }
+      this->Commit_Inspector_Row(grid_view);
+    }
+    this->Bind_Inspector(grid_view);
+  }
+
+  /**
+   * Shows the properties of the selected sprite in the grid view and
+   * remembers the key and type of each row.
+   * @param grid_view The grid view entity.
+   */
+  void cMap_Editor::Bind_Inspector(tObject& grid_view) {
+    Check_Condition((grid_view["columns"].number == 2), "There needs to be two columns in grid view.");
+    tObject& map_editor = this->Get_Component("map-editor");
+    sInspector_Binding& inspector = this->inspector;
+    inspector.layer = this->sel_layer;
+    inspector.index = map_editor["sel-sprite"].number;
+    inspector.uid = "";
+    inspector.revision = this->map_revision;
+    inspector.edit_row = NO_VALUE_FOUND;
+    inspector.keys.clear();
+    inspector.numbers.clear();
+    tSprite_List& sprites = (*this->sprite_layers)[inspector.layer];
+    cArray<std::string> items;
+    if ((inspector.index >= 0) && (inspector.index < sprites.Count()) && sprites[inspector.index].alive) {
+      tObject properties = sprites[inspector.index].Flatten();
+      if (properties.Does_Key_Exist("uid")) {
+        inspector.uid = properties["uid"].string;
+      }
+      int prop_count = properties.Count();
+      for (int prop_index = 0; prop_index < prop_count; prop_index++) {
+        cValue& value = properties.values[prop_index];
+        inspector.keys.push_back(properties.keys[prop_index]);
+        inspector.numbers.push_back(value.type == eVALUE_NUMBER);
+        items.Add(properties.keys[prop_index]);
+        items.Add((value.type == eVALUE_NUMBER) ? Number_To_Text(value.number) : value.string);
+      }
+    }
+    grid_view["text"].Set_String(Join(items, ";"));
+  }
+
+  /**
+   * Writes the edited row of the grid view to its property on the bound
+   * sprite. Number properties stay numbers; text that is not a number puts
+   * the old value back. If the map changed since the sprite was bound, the
+   * sprite is found again by its id; if it is gone the grid view says the
+   * edit was dropped until the selection or the map changes.
+   * @param grid_view The grid view entity.
+   */
+  void cMap_Editor::Commit_Inspector_Row(tObject& grid_view) {
+    sInspector_Binding& inspector = this->inspector;
+    int row = inspector.edit_row;
+    inspector.edit_row = NO_VALUE_FOUND;
+    if ((row == NO_VALUE_FOUND) || (inspector.index == NO_VALUE_FOUND)) {
+      return;
+    }
+    std::string& key = inspector.keys[row];
+    if (inspector.revision != this->map_revision) {
+      if ((inspector.uid == "") || !this->Find_Sprite(inspector.uid, inspector.layer, inspector.index)) {
+        cArray<std::string> items;
+        items.Add("removed");
+        items.Add(key + " not saved");
+        grid_view["text"].Set_String(Join(items, ";"));
+        inspector.layer = this->sel_layer;
+        inspector.index = NO_VALUE_FOUND; // Nothing to edit, so the notice is not committed.
+        inspector.revision = this->map_revision;
+        inspector.keys.clear();
+        inspector.numbers.clear();
+        return;
+      }
+      inspector.revision = NO_VALUE_FOUND; // Bound again to the found sprite after the edit.
+    }
+    cArray<std::string> data = Parse_Sausage_Text(grid_view["text"].string, ";");
+    if ((data.Count() != (int)inspector.keys.size() * 2) || (key == "layer") || Is_Read_Only_Key(key)) { // Layer moves go through the layer field.
+      inspector.revision = NO_VALUE_FOUND;
+      return;
+    }
+    cValue value = inspector.numbers[row] ? Parse_Value(data[row * 2 + 1]) : cValue(data[row * 2 + 1]);
+    if (value.type != (inspector.numbers[row] ? eVALUE_NUMBER : eVALUE_STRING)) {
+      inspector.revision = NO_VALUE_FOUND; // Shows the old value again.
+      return;
+    }
+    cSprite& sprite = (*this->sprite_layers)[inspector.layer][inspector.index];
+    if (!Is_Same_Value(sprite.Get(key), value)) {
+      this->Set_Sprite_Property(inspector.layer, inspector.index, key, value);
+    }
+  }
+
+  /**
+   * Tells whether a sprite property is shown in the inspector but not edited
+   * there.
+   * @param key The property key.
+   * @return True if the row is read-only.
+   */
+  bool cMap_Editor::Is_Read_Only_Key(std::string key) {
+    return ((key == "uid") || (key == "sprite-id")); // Diffs and merges match sprites by id, and prototypes are picked from the palette.
+  }
+
+  /**
+   * Finds a live sprite by its stable id.
+   * @param uid The id.
+   * @param layer Receives the layer of the sprite.
+   * @param index Receives the index of the sprite in its layer.
+   * @return True if the sprite was found, false otherwise.
+   */
+  bool cMap_Editor::Find_Sprite(std::string uid, std::string& layer, int& index) {
+    int layer_count = this->sprite_layers->Count();
+    for (int layer_index = 0; layer_index < layer_count; layer_index++) {
+      tSprite_List& sprites = this->sprite_layers->values[layer_index];
+      int sprite_count = sprites.Count();
+      for (int sprite_index = 0; sprite_index < sprite_count; sprite_index++) {
+        cSprite& sprite = sprites[sprite_index];
+        if (sprite.alive && sprite.Does_Key_Exist(eKEY_UID) && (sprite.Get_Text(eKEY_UID) == uid)) {
+          layer = this->sprite_layers->keys[layer_index];
+          index = sprite_index;
+          return true;
+        }
+      }
+    }
+    return false;
+  }
+
+  /**
+   * Renders the label component.
+   * @param entity The label entity.
+   */
+  void cMap_Editor::Render_Label(tObject& entity) {
+    Check_Condition(entity.Does_Key_Exist("label"), "No label specified for label.");
+    Check_Condition(entity.Does_Key_Exist("red"), "Red component missing for label color.");
+    Check_Condition(entity.Does_Key_Exist("green"), "Green component missing for label color.");
+    Check_Condition(entity.Does_Key_Exist("blue"), "Blue component missing for label color.");
+    this->io->Output_Text(entity["label"].string, 0, 0, entity["red"].number, entity["green"].number, entity["blue"].number);
+  }
+
+  /**
+   * Initializes a list component.
+   * @param entity The list entity.
+   */
+  void cMap_Editor::Init_List(tObject& entity) {
+    entity["scroll-x"].Set_Number(0);
+    entity["scroll-y"].Set_Number(0);
+    entity["text"].Set_String("");
+    entity["sel-item"].Set_Number(NO_VALUE_FOUND);
+  }
+
+  /**
+   * Renders a list entity.
+   * @param entity The entity component.
+   */
+  void cMap_Editor::Render_List(tObject& entity) {
+    cArray<std::string> items = Parse_Sausage_Text(entity["text"].string, ";");
+    int item_count = items.Count();
+    int dy = entity["width"].number - this->io->Get_Text_Height(entity["text"].string) / 2;
+    int height = this->io->Get_Text_Height(entity["text"].string) + 2;
+    sInput_Event event;
+    while (this->input.Next_Key(entity["id"].string, event)) { // Keys pressed while we had focus.
+      this->Scroll_Component(entity, event.signal, event.repeat);
+    }
+    for (int item_index = 0; item_index < item_count; item_index++) {
+      std::string item = items[item_index];
+      if (entity["sel-item"].number == item_index) {
+        this->io->Box(0 - entity["scroll-x"].number, item_index * height - entity["scroll-y"].number, entity["width"].number, height, 0, 0, 128);
+      }
+      else {
+        this->io->Box(0 - entity["scroll-x"].number, item_index * height - entity["scroll-y"].number, entity["width"].number, height, 255, 255, 255);
+      }
+      this->io->Output_Text(entity["text"].string, 2 - entity["scroll-x"].number, item_index * height + 2 - entity["scroll-y"].number, 0, 0, 0);
+      if (this->clicked == entity["id"].string) { // Was item clicked?
+        sRectangle item_map = { 0, item_index * height, entity["width"].number - 1, item_index * height + height - 1 };
+        if (Is_Point_In_Box(this->mouse_coords, item_map)) { // Was item clicked on?
+          entity["sel-item"].Set_Number(item_index);
+          this->On_List_Click(entity, item);
+        }
+      }
+    }
+  }
+
+  /**
+   * Renders a button component.
+   * @param entity The button entity.
+   */
+  void cMap_Editor::Render_Button(tObject& entity) {
+    Check_Condition(entity.Does_Key_Exist("label"), "No label for button.");
+    Check_Condition(entity.Does_Key_Exist("red"), "Missing red component for button color.");
+    Check_Condition(entity.Does_Key_Exist("green"), "Missing green component for button color.");
+    Check_Condition(entity.Does_Key_Exist("blue"), "Missing blue component for button color.");
+    int dx = (entity["width"].number - this->io->Get_Text_Width(entity["label"].string)) / 2;
+    int dy = (entity["height"].number - this->io->Get_Text_Height(entity["label"].string)) / 2;
+    this->io->Box(0, 0, entity["width"].number * this->cell_w, entity["height"].number * this->cell_h, entity["red"].number, entity["green"].number, entity["blue"].number);
+    this->io->Output_Text(entity["label"].string, dx, dy, entity["red"].number, entity["green"].number, entity["blue"].number);
+    if (this->clicked == entity["id"].string) { // Was the button clicked?
+      this->On_Button_Click(entity);
+    }
+  }
+
+  /**
+   * Called when the button was clicked.
+   * @param entity The button entity.
+   */
+  void cMap_Editor::On_Button_Click(tObject& entity) {
+    if (entity["id"].string == "undo") {
+      this->Undo();
+    }
+    else if (entity["id"].string == "redo") {
+      this->Redo();
+    }
+    else if (entity["id"].string == "update_sprite") { // Cells are bound, so only a pending edit is left.
+      this->Commit_Inspector_Row(this->Get_Component("grid-view"));
+    }
+    else if (entity["id"].string == "load_level") { // Each level opens in its own tab.
+      this->Open_Map(this->components["level_name"]["text"].string);
+    }
+    else if (entity["id"].string == "save_level") {
+      std::string name = this->components["level_name"]["text"].string;
+      this->Save_Map(name);
+      this->documents[this->active_document]->name = name;
+    }
+    else if (entity["id"].string == "find_overlaps") {
+      this->Start_Overlap_Analysis(entity);
+    }
+    else if (entity["id"].string == "tool") { // Cycle through the placement tools.
+      tObject& map_editor = this->Get_Component("map-editor");
+      std::string tools[] = { "sprite", "brush", "fill", "rect" };
+      int tool_index = 0;
+      while ((tool_index < 4) && (tools[tool_index] != map_editor["tool"].string)) {
+        tool_index++;
+      }
+      std::string tool = tools[(tool_index + 1) % 4];
+      map_editor["tool"].Set_String(tool);
+      entity["label"].Set_String("Tool: " + tool);
+      if ((tool != "sprite") && (this->tile_layers.find(this->sel_layer) == this->tile_layers.end())) { // Size cells after the selected sprite.
+        int proto = this->Find_Prototype(this->sel_sprite_id);
+        this->Load_Prototype(proto);
+        tObject& sprite = this->catalog.values[proto];
+        int tile_w = sprite.Does_Key_Exist("width") ? sprite["width"].number : 16;
+        int tile_h = sprite.Does_Key_Exist("height") ? sprite["height"].number : 16;
+        int map_width = map_editor["width"].number * this->cell_w;
+        int map_height = map_editor["height"].number * this->cell_h;
+        this->Create_Tile_Layer(this->sel_layer, tile_w, tile_h, (map_width + tile_w - 1) / tile_w, (map_height + tile_h - 1) / tile_h);
+      }
+    }
+    else if (entity["id"].string == "update_layer") {
+      tObject& map_editor = this->Get_Component("map-editor");
+      std::string layer = this->components["layer"]["text"].string;
+      Check_Condition(this->sprite_layers->Does_Key_Exist(layer), "There is no layer " + layer + ".");
+      if ((map_editor["sel-sprite"].number != NO_VALUE_FOUND) && (layer != this->sel_layer)) {
+        map_editor["sel-sprite"].Set_Number(this->Change_Sprite_Layer(this->sel_layer, map_editor["sel-sprite"].number, layer));
+      }
+      this->sel_layer = layer;
+    }
+  }
+
+  /**
+   * Initializes a toolbar component.
+   * @param entity The toolbar entity.
+   */
+  void cMap_Editor::Init_Toolbar(tObject& entity) {
+    Check_Condition(entity.Does_Key_Exist("columns"), "No column count specified for toolbar.");
+    entity["scroll-x"].Set_Number(0);
+    entity["scroll-y"].Set_Number(0);
+    entity["text"].Set_String("");
+    entity["item-x"].Set_Number(NO_VALUE_FOUND);
+    entity["item-y"].Set_Number(NO_VALUE_FOUND);
+  }
+
+  /**
+   * Renders the toolbar component.
+   * @param entity The toolbar entity.
+   */
+  void cMap_Editor::Render_Toolbar(tObject& entity) {
+    cArray<std::string> data = Parse_Sausage_Text(entity["text"].string, ";");
+    if ((data.Count() % entity["columns"].number) == 0) {
+      int row_count = data.Count() / entity["columns"].number;
+      int col_count = entity["columns"].number;
+      int cell_width = entity["width"].number / entity["columns"].number;
+      sInput_Event event;
+      while (this->input.Next_Key(entity["id"].string, event)) { // Keys pressed while we had focus.
+        this->Scroll_Component(entity, event.signal, event.repeat);
+      }
+      for (int grid_y = 0; grid_y < row_count; grid_y++) {
+        for (int grid_x = 0; grid_x < col_count; grid_x++) {
+          cArray<std::string> pair = Parse_Sausage_Text(data[grid_y * col_count + grid_x], ":");
+          Check_Condition((pair.Count() == 2), "Invalid data format in toolbar item.");
+          std::string label = pair[0];
+          std::string icon = pair[1];
+          this->Require_Icon(icon); // Decode when the palette first shows it.
+          int image_width = this->io->Get_Image_Width(icon);
+          int image_height = this->io->Get_Image_Height(icon);
+          int dx = (cell_width - image_width) / 2;
+          int dy = (cell_width - image_height) / 2;
+          int text_x = (cell_width - this->io->Get_Text_Width(label)) / 2;
+          int text_y = dy + image_height + 1;
+          if (this->clicked == entity["id"].string) {
+            sRectangle box = { grid_x * cell_width - entity["scroll-x"].number,
+                               grid_y * cell_width - entity["scroll-y"].number,
+                               grid_x * cell_width + cell_width - 1 - entity["scroll-x"].number,
+                               grid_y * cell_width + cell_width - 1 - entity["scroll-y"].number };
+            if (Is_Point_In_Box(this->mouse_coords, box)) {
+              entity["item-x"].Set_Number(grid_x);
+              entity["item-y"].Set_Number(grid_y);
+              this->On_Toolbar_Click(entity, label);
+            }
+          }
+          this->io->Draw_Image(icon, dx - entity["scroll-x"].number, dy - entity["scroll-y"].number, image_width, image_height, 0, false, false);
+          if ((entity["item-x"].number == grid_x) && (entity["item-y"].number == grid_y)) {
+            this->io->Output_Text(label, text_x - entity["scroll-x"].number, text_y - entity["scroll-y"].number, 0, 128, 0); // Mark with green as this is selected.
+          }
+          else {
+            this->io->Output_Text(label, text_x - entity["scroll-x"].number, text_y - entity["scroll-y"].number, 0, 0, 0);
+          }
+        }
+      }
+    }
+  }
+
+  /**
+   * Initializes the map editor component.
+   * @param entity The map editor entity.
+   */
+  void cMap_Editor::Init_Map_Editor(tObject& entity) {
+    entity["scroll-x"].Set_Number(0);
+    entity["scroll-y"].Set_Number(0);
+    entity["sel-sprite"].Set_Number(NO_VALUE_FOUND);
+    entity["band"].Set_Number(0);
+    entity["stroke"].Set_Number(0);
+    entity["tool"].Set_String("sprite");
+    entity["zoom"].Set_Number(0);
+    entity["scroll-step"].Set_Number(16);
+    entity["memory-panel"].Set_Number(0);
+  }
+
+  /**
+   * Renders the map editor component.
+   * @param entity The map editor entity.
+   */
+  void cMap_Editor::Render_Map_Editor(tObject& entity) {
+    this->Render_Sprites(entity);
+    this->Render_Overlaps(entity);
+    this->Render_Selection(entity);
+    if (entity["memory-panel"].number) {
+      this->Render_Memory_Panel(entity);
+    }
+    // Keys pressed while we had focus move the selection or scroll.
+    sInput_Event event;
+    while (this->input.Next_Key(entity["id"].string, event)) {
+      sSignal& signal = event.signal;
+      if (!this->selection.empty() && (signal.code == eSIGNAL_DELETE)) {
+        this->Delete_Selection();
+      }
+      else if (!this->selection.empty() && cInput_Queue::Is_Scroll_Key(signal.code)) { // One move for the whole run of keys.
+        int dx = (signal.code == eSIGNAL_LEFT) ? -1 : ((signal.code == eSIGNAL_RIGHT) ? 1 : 0);
+        int dy = (signal.code == eSIGNAL_UP) ? -1 : ((signal.code == eSIGNAL_DOWN) ? 1 : 0);
+        this->Move_Selection(dx * event.repeat, dy * event.repeat);
+      }
+      else if ((signal.code == '+') || (signal.code == '=')) {
+        this->Set_Zoom(entity, entity["zoom"].number + 1);
+      }
+      else if (signal.code == '-') {
+        this->Set_Zoom(entity, entity["zoom"].number - 1);
+      }
+      else if ((signal.code == '[') || (signal.code == ']')) { // Previous or next open map.
+        int document_count = this->documents.size();
+        this->Switch_Document((this->active_document + ((signal.code == ']') ? 1 : document_count - 1)) % document_count);
+      }
+      else if (signal.code == 'm') { // Memory debug panel.
+        entity["memory-panel"].Set_Number(!entity["memory-panel"].number);
+      }
+      else if (signal.code == 'M') {
+        this->Update_Memory_Report().Write("Memory_Report");
+      }
+      else {
+        this->Scroll_Component(entity, signal, event.repeat);
+      }
+    }
+    bool on_tiles = (this->tile_layers.find(this->sel_layer) != this->tile_layers.end()) && (entity["tool"].string != "sprite");
+    bool held = !this->not_clicked && (this->sel_component == entity["id"].string) && (this->clicked_button == eBUTTON_LEFT);
+    if (entity["stroke"].number && !(held && on_tiles && (entity["tool"].string == "brush"))) { // The button was released.
+      this->history.End_Group();
+      entity["stroke"].Set_Number(0);
+    }
+    if (on_tiles) { // Tile tools work on cells of the selected layer.
+      sPoint press = this->To_World(entity, this->mouse_coords);
+      sPoint drag = this->To_World(entity, this->drag_coords);
+      sRectangle area = { press.x, press.y, drag.x, drag.y };
+      if ((entity["tool"].string == "brush") && held) {
+        if (!entity["stroke"].number) { // One undo group for the whole stroke.
+          this->history.Begin_Group();
+          entity["stroke"].Set_Number(1);
+        }
+        area.left = area.right; // Paint under the cursor while dragging.
+        area.top = area.bottom;
+        this->Edit_Tiles(this->sel_layer, "brush", area, 1);
+      }
+      else if ((entity["tool"].string == "fill") && (this->clicked == entity["id"].string) && (this->clicked_button == eBUTTON_LEFT)) {
+        this->Edit_Tiles(this->sel_layer, "fill", area, 1);
+      }
+      else if (entity["tool"].string == "rect") {
+        if ((this->clicked == entity["id"].string) && (this->clicked_button == eBUTTON_LEFT)) {
+          entity["band"].Set_Number(2);
+        }
+        else if (entity["band"].number == 2) {
+          if (this->not_clicked) {
+            this->Edit_Tiles(this->sel_layer, "rect", area, 1);
+            entity["band"].Set_Number(0);
+          }
+          else {
+            sRectangle band = { std::min(this->mouse_coords.x, this->drag_coords.x), std::min(this->mouse_coords.y, this->drag_coords.y),
+                                std::max(this->mouse_coords.x, this->drag_coords.x), std::max(this->mouse_coords.y, this->drag_coords.y) };
+            this->Render_Outline(band, 255, 0, 255);
+          }
+        }
+      }
+    }
+    if ((this->clicked == entity["id"].string) && !(on_tiles && (this->clicked_button == eBUTTON_LEFT))) {
+      if (this->clicked_button == eBUTTON_LEFT) { // Pick or place a single sprite.
+        sSignal signal;
+        signal.code = eSIGNAL_MOUSE;
+        signal.button = eBUTTON_LEFT;
+        signal.coords = this->mouse_coords;
+        entity["sel-sprite"].Set_Number(NO_VALUE_FOUND);
+        this->Select_Sprite(signal, entity);
+        this->selection.clear();
+        if (entity["sel-sprite"].number != NO_VALUE_FOUND) {
+          sSprite_Ref ref = { this->Find_Layer(this->sel_layer), entity["sel-sprite"].number };
+          this->selection.push_back(ref);
+        }
+      }
+      else if (this->clicked_button == eBUTTON_RIGHT) { // Start a rubber band.
+        entity["band"].Set_Number(1);
+      }
+    }
+    if (entity["band"].number == 1) {
+      sRectangle band = { std::min(this->mouse_coords.x, this->drag_coords.x), std::min(this->mouse_coords.y, this->drag_coords.y),
+                          std::max(this->mouse_coords.x, this->drag_coords.x), std::max(this->mouse_coords.y, this->drag_coords.y) };
+      if (this->not_clicked) { // Released so select what the band covers.
+        sPoint top_left = { band.left, band.top };
+        sPoint bottom_right = { band.right, band.bottom };
+        top_left = this->To_World(entity, top_left);
+        bottom_right = this->To_World(entity, bottom_right);
+        sRectangle area = { top_left.x, top_left.y, bottom_right.x, bottom_right.y };
+        this->Select_In_Rectangle(area, this->sel_layer, "", false);
+        entity["band"].Set_Number(0);
+      }
+      else {
+        this->Render_Outline(band, 0, 0, 255);
+      }
+    }
+  }
+
+  /**
+   * Fires when a list item is clicked.
+   * @param entity The list entity.
+   * @param text The text of the item that was clicked.
+   */
+  void cMap_Editor::On_List_Click(tObject& entity, std::string text) {
+    if (entity["id"].string == "levels") { // Preview the level from the index.
+      std::map<std::string, sLevel_Entry>::iterator level = this->level_index.levels.find(text);
+      if (level != this->level_index.levels.end()) {
+        this->components["level_name"]["text"].Set_String(text);
+        this->components["background"]["text"].Set_String(level->second.background);
+        this->components["music"]["text"].Set_String(level->second.music);
+      }
+    }
+  }
+
+  /**
+   * Fires when a toolbar item is clicked.
+   * @param entity The toolbar entity.
+   * @param label The label of the clicked item.
+   */
+  void cMap_Editor::On_Toolbar_Click(tObject& entity, std::string label) {
+    if (entity["id"].string == "sprite_pal") { // Sprites and tiles are placed from the palette.
+      this->sel_sprite_id = label;
+    }
+  }
+
+  /**
+   * Updates the sprite palette.
+   * @param toolbar The toolbar representing the sprite palette.
+   */
+  void cMap_Editor::Update_Sprite_Palette(tObject& toolbar) {
+    this->Init_Toolbar(toolbar);
+    int catalog_size = this->catalog_index.entries.size();
+    cArray<std::string> items;
+    for (int catalog_index = 0; catalog_index < catalog_size; catalog_index++) {
+      sCatalog_Entry& entry = this->catalog_index.entries[catalog_index]; // Icons come from the index.
+      items.Add(entry.name + ":" + entry.icon);
+    }
+    toolbar["text"].Set_String(Join(items, ";"));
+  }
+
+  /**
+   * Scrolls a component when the user presses the arrow keys.
+   * @param entity The component to scroll.
+   * @param signal The user signal.
+   * @param repeat The number of times the key was pressed.
+   */
+  void cMap_Editor::Scroll_Component(tObject& entity, sSignal& signal, int repeat) {
+    Check_Condition(entity.Does_Key_Exist("scroll-x"), "Scroll x coordinate missing.");
+    Check_Condition(entity.Does_Key_Exist("scroll-y"), "Scroll y coordinate missing.");
+    int step = (entity.Does_Key_Exist("scroll-step") ? entity["scroll-step"].number : 1) * repeat;
+    switch (signal.code) {
+      case eSIGNAL_LEFT: {
+        entity["scroll-x"].number -= step;
+        break;
+      }
+      case eSIGNAL_RIGHT: {
+        entity["scroll-x"].number += step;
+        break;
+      }
+      case eSIGNAL_UP: {
+        entity["scroll-y"].number -= step;
+        break;
+      }
+      case eSIGNAL_DOWN: {
+        entity["scroll-y"].number += step;
+      }
+    }
+  }
+
+  /**
+   * Updates the level list.
+   * @param list The list component.
+   */
+  void cMap_Editor::Update_Levels(tObject& list) {
+    std::string folder = this->io->Get_Current_Folder();
+    if (this->level_index.folder != folder) {
+      this->level_index.Open(this->io, folder);
+    }
+    if (this->level_index.Refresh()) { // Only rebuild the list when levels changed.
+      this->Forget_Missing_Backgrounds();
+      this->Init_List(list);
+      list["text"] = this->level_index.Get_Level_List();
+    }
+  }
+
+  /**
+   * Selects a sprite or created a new one.
+   * @param signal The input signal.
+   * @param map_editor The map editor component.
+   */
+  void cMap_Editor::Select_Sprite(sSignal& signal, tObject& map_editor) {
+    sPoint world = this->To_World(map_editor, this->mouse_coords); // Picking works in map coordinates.
+    tSprite_List& sprites = (*this->sprite_layers)[this->sel_layer];
+    cZ_Order* z_order = this->Get_Z_Order(this->sel_layer);
+    int sprite_count = sprites.Count();
+    bool sprite_found = false;
+    for (int rank = sprite_count - 1; rank >= 0; rank--) { // Select top-down sprites.
+      int sprite_index = z_order ? z_order->order[rank] : rank;
+      cSprite& sprite = sprites[sprite_index];
+      if (!sprite.alive) {
+        continue;
+      }
+      Check_Condition(sprite.Does_Key_Exist(eKEY_BUMP_MAP), "No bump map present in sprite.");
+      sRectangle bump_map = Parse_Rectangle(sprite.Get_Text(eKEY_BUMP_MAP));
+      if (signal.code == eSIGNAL_MOUSE) {
+        Check_Condition(sprite.Does_Key_Exist(eKEY_X), "Sprite has no X coordinate.");
+        Check_Condition(sprite.Does_Key_Exist(eKEY_Y), "Sprite has no Y coordinate.");
+        // Augment bump map with sprite coordinates.
+        int x = sprite.Get(eKEY_X).number;
+        int y = sprite.Get(eKEY_Y).number;
+        bump_map.left += x;
+        bump_map.right += x;
+        bump_map.top += y;
+        bump_map.bottom += y;
+        if (Is_Point_In_Box(world, bump_map)) {
+          if (signal.button == eBUTTON_LEFT) {
+            if (map_editor["sel-sprite"].number == NO_VALUE_FOUND) { // Sprite not selected.
+              map_editor["sel-sprite"].Set_Number(sprite_index);
+              sprite_found = true;
+              break;
+            }
+          }
+        }
+      }
+    }
+    if (!sprite_found) { // Lay down sprite if no sprite found.
+      if (map_editor["sel-sprite"].number == NO_VALUE_FOUND) {
+        int proto = this->Find_Prototype(this->sel_sprite_id);
+        this->Load_Prototype(proto);
+        cSprite new_sprite(&this->catalog_index, &this->arena, proto);
+        new_sprite.Set("layer", cValue(this->sel_layer));
+        new_sprite.Set("x", cValue(world.x));
+        new_sprite.Set("y", cValue(world.y));
+        map_editor["sel-sprite"].Set_Number(this->Place_Sprite(new_sprite));
+      }
+    }
+  }
+
+  /**
+   * Parses a rectangle from text.
+   * @param text The text containing the rectangle string.
+   * @return A rectangle object.
+   * @throws An error if the rectangle is not valid.
+   */
+  sRectangle cMap_Editor::Parse_Rectangle(std::string text) {
+    cArray<std::string> str_rect = Parse_Sausage_Text(text, ",");
+    sRectangle rect;
+    Check_Condition((str_rect.Count() == 4), "Rectangle is not formatted correctly.");
+    rect.left = Text_To_Number(str_rect[0]);
+    rect.top = Text_To_Number(str_rect[1]);
+    rect.right = Text_To_Number(str_rect[2]);
+    rect.bottom = Text_To_Number(str_rect[3]);
+    return rect;
+  }
+
+  /**
+   * Renders sprites to the map control.
+   * @param map_editor The map editor component.
+   */
+  void cMap_Editor::Render_Sprites(tObject& map_editor) {
+    int map_width = map_editor["width"].number * this->cell_w;
+    int map_height = map_editor["height"].number * this->cell_h;
+    int zoom = map_editor["zoom"].number;
+    this->Render_Background(map_editor);
+    // Only sprites in view are drawn.
+    sPoint view_corner = { map_width - 1, map_height - 1 };
+    sPoint origin = { 0, 0 };
+    origin = this->To_World(map_editor, origin);
+    view_corner = this->To_World(map_editor, view_corner);
+    std::vector<int> visible;
+    // Sprites smaller than a pixel are counted into 4x4 pixel blocks instead.
+    int block_cols = map_width / 4 + 1;
+    int block_rows = map_height / 4 + 1;
+    std::vector<int> blocks;
+    int layer_count = this->sprite_layers->Count();
+    for (int layer_index = 0; layer_index < layer_count; layer_index++) {
+      tSprite_List& layer = this->sprite_layers->values[layer_index];
+      this->Render_Tiles(this->sprite_layers->keys[layer_index], map_editor); // Tiles sit under the sprites of their layer.
+      cSpatial_Grid& grid = this->Get_Spatial(this->sprite_layers->keys[layer_index]);
+      sRectangle view_area = { origin.x - grid.margin, origin.y - grid.margin, view_corner.x + grid.margin, view_corner.y + grid.margin };
+      visible.clear();
+      grid.Query(view_area, visible);
+      cZ_Order* z_order = this->Get_Z_Order(this->sprite_layers->keys[layer_index]);
+      if (z_order) { // Only the sprites in view are put in draw order.
+        std::sort(visible.begin(), visible.end(), [z_order](int a, int b) { return (z_order->ranks[a] < z_order->ranks[b]); });
+      }
+      int visible_count = visible.size();
+      for (int visible_index = 0; visible_index < visible_count; visible_index++) {
+        cSprite& sprite = layer[visible[visible_index]];
+        Check_Condition(sprite.Does_Key_Exist(eKEY_X), "No X coordinate in sprite.");
+        Check_Condition(sprite.Does_Key_Exist(eKEY_Y), "No Y coordinate in sprite.");
+        Check_Condition(sprite.Does_Key_Exist(eKEY_WIDTH), "Sprite has no width set.");
+        Check_Condition(sprite.Does_Key_Exist(eKEY_HEIGHT), "Sprite has no height set.");
+        sRectangle box = { sprite.Get(eKEY_X).number, sprite.Get(eKEY_Y).number, 0, 0 };
+        int width = sprite.Get(eKEY_WIDTH).number;
+        int height = sprite.Get(eKEY_HEIGHT).number;
+        box.right = box.left + width - 1;
+        box.bottom = box.top + height - 1;
+        sRectangle view = this->To_View(map_editor, box);
+        int view_width = Scale_Size(width, zoom);
+        int view_height = Scale_Size(height, zoom);
+        if ((view_width < 1) || (view_height < 1)) {
+          int block_x = view.left / 4;
+          int block_y = view.top / 4;
+          if ((block_x >= 0) && (block_x < block_cols) && (block_y >= 0) && (block_y < block_rows)) {
+            if (blocks.empty()) {
+              blocks.assign(block_cols * block_rows, 0);
+            }
+            blocks[block_y * block_cols + block_x]++;
+          }
+          continue;
+        }
+        this->io->Draw_Image(this->Get_Zoomed_Icon(sprite.Get_Text(eKEY_ICON), zoom), view.left, view.top, view_width, view_height, 0, false, false);
+      }
+    }
+    int block_count = blocks.size();
+    for (int block_index = 0; block_index < block_count; block_index++) {
+      if (blocks[block_index] > 0) { // Darker blocks hold more sprites.
+        int shade = std::max(0, 192 - blocks[block_index] * 8);
+        this->io->Box((block_index % block_cols) * 4, (block_index / block_cols) * 4, 4, 4, shade, shade, shade);
+      }
+    }
+  }
+
+  /**
+   * Renders the map background. Tiled backgrounds only draw the tiles in
+   * view, taken from the level that matches the zoom.
+   * @param map_editor The map editor component.
+   * @throws An error if the background does not match the map size.
+   */
+  void cMap_Editor::Render_Background(tObject& map_editor) {
+    std::string background = (*this->meta_data)["background"].string;
+    int map_width = map_editor["width"].number * this->cell_w;
+    int map_height = map_editor["height"].number * this->cell_h;
+    int zoom = map_editor["zoom"].number;
+    sTiled_Background* tiled = this->Find_Tiled_Background(background);
+    if (this->loader && !tiled && (background != "") && !this->loader->Is_Loaded(background)) { // Decoded on first use like the icons.
+      std::vector<std::string> images(1, background);
+      this->loader->Load_Images(images);
+    }
+    int bkg_width = tiled ? tiled->width : this->io->Get_Image_Width(background);
+    int bkg_height = tiled ? tiled->height : this->io->Get_Image_Height(background);
+    if ((background == "") || (bkg_width != map_width) || (bkg_height != map_height)) { // Missing or wrong size, so draw a placeholder.
+      sRectangle map_area = { 0, 0, map_width - 1, map_height - 1 };
+      sRectangle map_view = this->To_View(map_editor, map_area);
+      this->io->Box(map_view.left, map_view.top, map_view.right - map_view.left + 1, map_view.bottom - map_view.top + 1, 192, 192, 192);
+      return;
+    }
+    if (!tiled) {
+      sRectangle map_area = { 0, 0, map_width - 1, map_height - 1 };
+      sRectangle map_view = this->To_View(map_editor, map_area);
+      this->io->Draw_Image(background, map_view.left, map_view.top, Scale_Size(map_width, zoom), Scale_Size(map_height, zoom), 0, false, false);
+      return;
+    }
+    int level = std::min(std::max(0, -zoom), tiled->levels - 1);
+    int tile_span = tiled->tile_size << level; // Map pixels covered by one tile.
+    int cols = (cTile_Cache::Get_Level_Size(tiled->width, level) + tiled->tile_size - 1) / tiled->tile_size;
+    int rows = (cTile_Cache::Get_Level_Size(tiled->height, level) + tiled->tile_size - 1) / tiled->tile_size;
+    sPoint origin = { 0, 0 };
+    sPoint view_corner = { map_width - 1, map_height - 1 };
+    origin = this->To_World(map_editor, origin);
+    view_corner = this->To_World(map_editor, view_corner);
+    int first_col = std::max(0, origin.x / tile_span);
+    int first_row = std::max(0, origin.y / tile_span);
+    int last_col = std::min(cols - 1, view_corner.x / tile_span);
+    int last_row = std::min(rows - 1, view_corner.y / tile_span);
+    std::string folder = TILE_FOLDER + "/" + background + "/";
+    bool streamed = (this->tile_cache.loader != NULL); // Without a loader the I/O control has its own images.
+    this->tile_cache.frame++;
+    std::vector<std::pair<std::string, sRectangle>> ready;
+    std::unordered_set<std::string> fallbacks;
+    for (int row = first_row; row <= last_row; row++) {
+      for (int col = first_col; col <= last_col; col++) {
+        std::string tile = cTile_Cache::Get_Tile_Name(background, level, col, row);
+        sRectangle area = cTile_Cache::Get_Tile_Area(*tiled, level, col, row);
+        if (!streamed || this->tile_cache.Request(tile, folder + tile + ".png")) {
+          ready.push_back(std::make_pair(tile, area));
+          continue;
+        }
+        bool covered = false;
+        for (int coarse = level + 1; (coarse < tiled->levels) && !covered; coarse++) { // A smaller level stands in while the tile loads.
+          int shift = coarse - level;
+          std::string fallback = cTile_Cache::Get_Tile_Name(background, coarse, col >> shift, row >> shift);
+          if (this->tile_cache.Is_Cached(fallback)) {
+            covered = true;
+            if (fallbacks.insert(fallback).second) {
+              this->tile_cache.Request(fallback, folder + fallback + ".png"); // Kept while it stands in.
+              sRectangle view = this->To_View(map_editor, cTile_Cache::Get_Tile_Area(*tiled, coarse, col >> shift, row >> shift));
+              this->io->Draw_Image(fallback, view.left, view.top, view.right - view.left + 1, view.bottom - view.top + 1, 0, false, false);
+            }
+          }
+        }
+        if (!covered) {
+          sRectangle view = this->To_View(map_editor, area);
+          this->io->Box(view.left, view.top, view.right - view.left + 1, view.bottom - view.top + 1, 192, 192, 192);
+        }
+      }
+    }
+    int ready_count = ready.size();
+    for (int ready_index = 0; ready_index < ready_count; ready_index++) { // Drawn over the stand-ins.
+      sRectangle view = this->To_View(map_editor, ready[ready_index].second);
+      this->io->Draw_Image(ready[ready_index].first, view.left, view.top, view.right - view.left + 1, view.bottom - view.top + 1, 0, false, false);
+    }
+    if (this->tile_cache.loader) {
+      this->tile_cache.Trim();
+    }
+  }
+
+  /**
+   * Finds the manifest of a tiled background, reading it on first use.
+   * @param name The name of the background.
+   * @return The tiled background or NULL if the background is one image.
+   */
+  sTiled_Background* cMap_Editor::Find_Tiled_Background(std::string name) {
+    std::unordered_map<std::string, sTiled_Background>::iterator tiled = this->tiled_backgrounds.find(name);
+    if (tiled == this->tiled_backgrounds.end()) {
+      sTiled_Background background = { name, 0, 0, 0, 0 };
+      if (!cTile_Cache::Read_Manifest(TILE_FOLDER, name, background)) {
+        background.tile_size = 0; // Remembered so the file is not checked every frame.
+      }
+      tiled = this->tiled_backgrounds.insert(std::make_pair(name, background)).first;
+    }
+    return (tiled->second.tile_size > 0) ? &tiled->second : NULL;
+  }
+
+  /**
+   * Forgets backgrounds that had no manifest so a background sliced since
+   * then is found.
+   */
+  void cMap_Editor::Forget_Missing_Backgrounds() {
+    std::unordered_map<std::string, sTiled_Background>::iterator tiled = this->tiled_backgrounds.begin();
+    while (tiled != this->tiled_backgrounds.end()) {
+      if (tiled->second.tile_size == 0) {
+        tiled = this->tiled_backgrounds.erase(tiled);
+      }
+      else {
+        ++tiled;
+      }
+    }
+  }
+
+  /**
+   * Sets the zoom level of the map editor, keeping the center of the view
+   * in place.
+   * @param map_editor The map editor component.
+   * @param zoom The zoom level from -4 (1/16x) to 2 (4x).
+   */
+  void cMap_Editor::Set_Zoom(tObject& map_editor, int zoom) {
+    zoom = std::max(-4, std::min(2, zoom));
+    sPoint center = { map_editor["width"].number * this->cell_w / 2, map_editor["height"].number * this->cell_h / 2 };
+    sPoint world = this->To_World(map_editor, center);
+    map_editor["zoom"].Set_Number(zoom);
+    map_editor["scroll-x"].Set_Number(world.x - ((zoom >= 0) ? (center.x >> zoom) : (center.x << -zoom)));
+    map_editor["scroll-y"].Set_Number(world.y - ((zoom >= 0) ? (center.y >> zoom) : (center.y << -zoom)));
+    map_editor["scroll-step"].Set_Number((zoom >= 0) ? std::max(1, 16 >> zoom) : (16 << -zoom)); // Scroll by 16 view pixels.
+  }
+
+  /**
+   * Converts a point in the map editor view to map coordinates.
+   * @param map_editor The map editor component.
+   * @param view The point in the view.
+   * @return The point on the map.
+   */
+  sPoint cMap_Editor::To_World(tObject& map_editor, sPoint view) {
+    int zoom = map_editor["zoom"].number;
+    sPoint world;
+    world.x = ((zoom >= 0) ? (view.x >> zoom) : (view.x << -zoom)) + map_editor["scroll-x"].number;
+    world.y = ((zoom >= 0) ? (view.y >> zoom) : (view.y << -zoom)) + map_editor["scroll-y"].number;
+    return world;
+  }
+
+  /**
+   * Converts a rectangle on the map to the map editor view.
+   * @param map_editor The map editor component.
+   * @param world The rectangle on the map.
+   * @return The rectangle in the view.
+   */
+  sRectangle cMap_Editor::To_View(tObject& map_editor, sRectangle world) {
+    int zoom = map_editor["zoom"].number;
+    int scroll_x = map_editor["scroll-x"].number;
+    int scroll_y = map_editor["scroll-y"].number;
+    sRectangle view;
+    view.left = Scale_Size(world.left - scroll_x, zoom);
+    view.top = Scale_Size(world.top - scroll_y, zoom);
+    view.right = Scale_Size(world.right + 1 - scroll_x, zoom) - 1;
+    view.bottom = Scale_Size(world.bottom + 1 - scroll_y, zoom) - 1;
+    return view;
+  }
+
+  /**
+   * Scales a size or offset by a zoom level.
+   * @param size The size in map pixels.
+   * @param zoom The zoom level.
+   * @return The size in view pixels.
+   */
+  int cMap_Editor::Scale_Size(int size, int zoom) {
+    return (zoom >= 0) ? (size << zoom) : (size >> -zoom);
+  }
+
+  /**
+   * Gets the name of an icon that is pre-scaled for a zoom level.
+   * @param icon The name of the icon.
+   * @param zoom The zoom level.
+   * @return The name of the scaled image to draw.
+   */
+  std::string cMap_Editor::Get_Zoomed_Icon(std::string icon, int zoom) {
+    std::string zoomed = icon;
+    if (this->loader && (zoom != 0)) { // Without a loader the I/O control scales while drawing.
+      zoomed = this->loader->Get_Scaled_Image(icon, zoom);
+    }
+    return zoomed;
+  }
+
+  /**
+   * Clears out the map data.
+   */
+  void cMap_Editor::Clear_Map() {
+    this->Cancel_Map_Jobs();
+    this->map_revision++; // Sprite slots are reused.
+    this->sel_layer = "background";
+    this->sel_sprite = NO_VALUE_FOUND;
+    this->meta_data->Clear();
+    this->history.Clear(); // Edits refer to sprite slots of this map.
+    this->selection.clear();
+    this->spatial.clear();
+    this->z_orders.clear();
+    this->tile_layers.clear();
+    this->overlaps.clear();
+    int layer_count = this->sprite_layers->Count();
+    for (int layer_index = 0; layer_index < layer_count; layer_index++) {
+      tSprite_List& layer = this->sprite_layers->values[layer_index];
+      layer.Clear();
+    }
+    this->arena.Clear(); // Every sprite override of the map in one step.
+  }
+
+  /**
+   * Destars starred sprite properties.
+   * @param sprite The sprite properties to destar.
+   */
+  void cMap_Editor::Destar_Sprite(tObject& sprite) {
+    int prop_count = sprite.Count();
+    for (int prop_index = 0; prop_index < prop_count; prop_index++) {
+      Check_Condition((sprite.keys[prop_index].length() > 0), "Key is NULL.");
+      if (sprite.keys[prop_index][0] == '*') {
+        sprite.keys[prop_index] = sprite.keys[prop_index].substr(1); // Destar the key.
+      }
+    }
+  }
+
+  /**
+   * Finds the catalog index of a prototype.
+   * @param sprite_id The catalog name of the sprite.
+   * @return The index of the prototype or NO_VALUE_FOUND.
+   */
+  int cMap_Editor::Find_Prototype(std::string sprite_id) {
+    std::unordered_map<std::string, int>::iterator entry = this->catalog_lookup.find(sprite_id);
+    return (entry != this->catalog_lookup.end()) ? entry->second : NO_VALUE_FOUND;
+  }
+
+  /**
+   * Parses a catalog entry if it has not been used before.
+   * @param proto The index of the prototype.
+   * @throws An error if the entry could not be read.
+   */
+  void cMap_Editor::Load_Prototype(int proto) {
+    Check_Condition((proto != NO_VALUE_FOUND), "Sprite is not in the catalog.");
+    if (!this->catalog_index.entries[proto].parsed) {
+      tObject& sprite = this->catalog.values[proto];
+      this->catalog_index.Read_Entry(proto, sprite);
+      this->Destar_Sprite(sprite);
+      std::vector<sSprite_Property>& properties = this->catalog_index.entries[proto].properties;
+      int prop_count = sprite.Count();
+      for (int prop_index = 0; prop_index < prop_count; prop_index++) { // Sprites read the interned copy.
+        properties.push_back(cSprite::Make_Property(string_table.Intern(sprite.keys[prop_index]), sprite.values[prop_index]));
+      }
+    }
+  }
+
+  /**
+   * Makes sure an icon is decoded before it is drawn.
+   * @param icon The name of the icon image.
+   */
+  void cMap_Editor::Require_Icon(std::string icon) {
+    if (this->loader) { // Without a loader all resources were loaded up front.
+      this->loader->Load_Image(icon);
+    }
+  }
+
+  /**
+   * Decodes the background and the icons a map uses together, instead of
+   * one at a time as its sprites are created.
+   * @param records The records of the map with the meta data first.
+   * @throws An error if an image could not be decoded.
+   */
+  void cMap_Editor::Prefetch_Images(std::vector<tObject>& records) {
+    if (!this->loader) { // Without a loader all resources were loaded up front.
+      return;
+    }
+    std::vector<std::string> images;
+    if (records[0].Does_Key_Exist("background")) {
+      images.push_back(records[0]["background"].string);
+    }
+    int record_count = records.size();
+    for (int record_index = 1; record_index < record_count; record_index++) {
+      tObject& record = records[record_index];
+      int proto = record.Does_Key_Exist("sprite-id") ? this->Find_Prototype(record["sprite-id"].string) : NO_VALUE_FOUND;
+      if (proto != NO_VALUE_FOUND) {
+        images.push_back(this->catalog_index.entries[proto].icon);
+      }
+      else if (record.Does_Key_Exist("icon")) {
+        images.push_back(record["icon"].string);
+      }
+    }
+    this->loader->Load_Images(images);
+  }
+
+  /**
+   * Lists the catalog sprites that a map uses without parsing the catalog.
+   * @param name The name of the map.
+   * @return The catalog names used by the map.
+   * @throws An error if the map could not be read.
+   */
+  cArray<std::string> cMap_Editor::Get_Used_Sprites(std::string name) {
+    std::vector<tObject> records;
+    cMap_Codec::Read_Map(name + ".map", records);
+    std::vector<bool> used(this->catalog_index.entries.size(), false);
+    int record_count = records.size();
+    for (int record_index = 1; record_index < record_count; record_index++) {
+      tObject& record = records[record_index];
+      if (record.Does_Key_Exist("sprite-id")) {
+        int proto = this->Find_Prototype(record["sprite-id"].string);
+        if (proto != NO_VALUE_FOUND) {
+          used[proto] = true;
+        }
+      }
+    }
+    cArray<std::string> sprites;
+    int entry_count = used.size();
+    for (int entry_index = 0; entry_index < entry_count; entry_index++) {
+      if (used[entry_index]) {
+        sprites.Add(this->catalog_index.entries[entry_index].name);
+      }
+    }
+    return sprites;
+  }
+
+  /**
+   * Places a sprite on its layer.
+   * @param sprite The sprite to place. It must have a layer property and
+   * must not share its overrides with a placed sprite. See cSprite::Detach.
+   * @return The index of the sprite in its layer.
+   */
+  int cMap_Editor::Place_Sprite(cSprite sprite) {
+    std::string layer = sprite.Get_Text(eKEY_LAYER);
+    sprite.Set("uid", cValue(this->New_Uid())); // Copies get their own id.
+    tSprite_List& sprites = (*this->sprite_layers)[layer];
+    sprites.Add(sprite);
+    this->Invalidate_Layer(layer);
+    this->Update_Z_Order(layer, sprites.Count() - 1);
+    sEdit edit;
+    edit.type = eEDIT_PLACE;
+    edit.layer = layer;
+    edit.index = sprites.Count() - 1;
+    this->history.Record(edit);
+    return edit.index;
+  }
+
+  /**
+   * Deletes a sprite. The slot is kept so the delete can be undone.
+   * @param layer The layer of the sprite.
+   * @param index The index of the sprite.
+   */
+  void cMap_Editor::Delete_Sprite(std::string layer, int index) {
+    sEdit edit;
+    edit.type = eEDIT_DELETE;
+    edit.layer = layer;
+    edit.index = index;
+    this->Apply_Edit(edit, true);
+    this->history.Record(edit);
+  }
+
+  /**
+   * Moves a sprite.
+   * @param layer The layer of the sprite.
+   * @param index The index of the sprite.
+   * @param x The new X coordinate.
+   * @param y The new Y coordinate.
+   */
+  void cMap_Editor::Move_Sprite(std::string layer, int index, int x, int y) {
+    cSprite& sprite = (*this->sprite_layers)[layer][index];
+    sEdit edit;
+    edit.type = eEDIT_MOVE;
+    edit.layer = layer;
+    edit.index = index;
+    edit.old_coords.x = sprite.Get("x").number;
+    edit.old_coords.y = sprite.Get("y").number;
+    edit.new_coords.x = x;
+    edit.new_coords.y = y;
+    this->Apply_Edit(edit, true);
+    this->history.Record(edit);
+  }
+
+  /**
+   * Sets a property of a sprite.
+   * @param layer The layer of the sprite.
+   * @param index The index of the sprite.
+   * @param key The name of the property.
+   * @param value The new value.
+   */
+  void cMap_Editor::Set_Sprite_Property(std::string layer, int index, std::string key, cValue value) {
+    cSprite& sprite = (*this->sprite_layers)[layer][index];
+    sEdit edit;
+    edit.type = eEDIT_PROPERTY;
+    edit.layer = layer;
+    edit.index = index;
+    edit.key = key;
+    edit.overridden = sprite.Has_Override(key); // Otherwise undo falls back to the prototype.
+    if (edit.overridden) {
+      edit.old_value = sprite.Get(key);
+    }
+    edit.new_value = value;
+    this->Apply_Edit(edit, true);
+    this->history.Record(edit);
+  }
+
+  /**
+   * Moves a sprite to another layer.
+   * @param layer The layer of the sprite.
+   * @param index The index of the sprite.
+   * @param to_layer The layer to move the sprite to.
+   * @return The index of the sprite in the new layer.
+   */
+  int cMap_Editor::Change_Sprite_Layer(std::string layer, int index, std::string to_layer) {
+    cSprite sprite = (*this->sprite_layers)[layer][index];
+    sprite.Detach(); // The old slot is kept for undo.
+    sprite.Set("layer", cValue(to_layer));
+    tSprite_List& to_sprites = (*this->sprite_layers)[to_layer];
+    to_sprites.Add(sprite);
+    sEdit edit;
+    edit.type = eEDIT_LAYER;
+    edit.layer = layer;
+    edit.index = index;
+    edit.to_layer = to_layer;
+    edit.to_index = to_sprites.Count() - 1;
+    this->Apply_Edit(edit, true);
+    this->history.Record(edit);
+    return edit.to_index;
+  }
+
+  /**
+   * Sets a meta data property.
+   * @param key The name of the property.
+   * @param value The new value.
+   */
+  void cMap_Editor::Set_Meta_Data(std::string key, cValue value) {
+    sEdit edit;
+    edit.type = eEDIT_META;
+    edit.key = key;
+    edit.overridden = this->meta_data->Does_Key_Exist(key); // Otherwise undo removes the key again.
+    if (edit.overridden) {
+      edit.old_value = (*this->meta_data)[key];
+    }
+    edit.new_value = value;
+    this->Apply_Edit(edit, true);
+    this->history.Record(edit);
+  }
+
+  /**
+   * Undoes the last edit or group of edits.
+   * @return True if something was undone.
+   */
+  bool cMap_Editor::Undo() {
+    bool undone = !this->history.undo_stack.empty();
+    if (undone) {
+      int group = this->history.undo_stack.back().group;
+      while (!this->history.undo_stack.empty() && (this->history.undo_stack.back().group == group)) {
+        sEdit edit = this->history.undo_stack.back();
+        this->history.undo_stack.pop_back();
+        this->Apply_Edit(edit, false);
+        this->history.redo_stack.push_back(edit);
+      }
+      this->Drop_Dead_Selection();
+    }
+    return undone;
+  }
+
+  /**
+   * Redoes the last undone edit or group of edits.
+   * @return True if something was redone.
+   */
+  bool cMap_Editor::Redo() {
+    bool redone = !this->history.redo_stack.empty();
+    if (redone) {
+      int group = this->history.redo_stack.back().group;
+      while (!this->history.redo_stack.empty() && (this->history.redo_stack.back().group == group)) {
+        sEdit edit = this->history.redo_stack.back();
+        this->history.redo_stack.pop_back();
+        this->Apply_Edit(edit, true);
+        this->history.undo_stack.push_back(edit);
+      }
+      this->Drop_Dead_Selection();
+    }
+    return redone;
+  }
+
+  /**
+   * Determines if an edit refers to one sprite slot by its layer and index.
+   * @param edit The edit.
+   * @return True if the layer and index of the edit name a sprite.
+   */
+  bool cMap_Editor::Refers_To_Slot(sEdit& edit) {
+    return ((edit.type != eEDIT_META) && (edit.type != eEDIT_TILES) && (edit.type != eEDIT_MOVE_GROUP));
+  }
+
+  /**
+   * Deselects sprites that an undo or redo deleted.
+   */
+  void cMap_Editor::Drop_Dead_Selection() {
+    tObject& map_editor = this->Get_Component("map-editor");
+    int sel_sprite = map_editor["sel-sprite"].number;
+    if ((sel_sprite != NO_VALUE_FOUND) && ((sel_sprite >= (*this->sprite_layers)[this->sel_layer].Count()) || !(*this->sprite_layers)[this->sel_layer][sel_sprite].alive)) {
+      map_editor["sel-sprite"].Set_Number(NO_VALUE_FOUND);
+    }
+    std::vector<sSprite_Ref> alive;
+    int sel_count = this->selection.size();
+    for (int sel_index = 0; sel_index < sel_count; sel_index++) {
+      sSprite_Ref& ref = this->selection[sel_index];
+      if (this->sprite_layers->values[ref.layer][ref.index].alive) {
+        alive.push_back(ref);
+      }
+    }
+    this->selection.swap(alive);
+  }
+
+  /**
+   * Drops the slots of deleted sprites that no edit in the history can bring
+   * back. Everything that refers to a sprite by index is renumbered.
+   */
+  void cMap_Editor::Compact_Layers() {
+    std::vector<sEdit>* stacks[2] = { &this->history.undo_stack, &this->history.redo_stack };
+    tObject& map_editor = this->Get_Component("map-editor");
+    bool compacted = false;
+    int layer_count = this->sprite_layers->Count();
+    for (int layer_index = 0; layer_index < layer_count; layer_index++) {
+      std::string layer = this->sprite_layers->keys[layer_index];
+      tSprite_List& sprites = this->sprite_layers->values[layer_index];
+      int sprite_count = sprites.Count();
+      std::vector<bool> kept(sprite_count, false);
+      for (int sprite_index = 0; sprite_index < sprite_count; sprite_index++) {
+        kept[sprite_index] = sprites[sprite_index].alive;
+      }
+      for (int stack_index = 0; stack_index < 2; stack_index++) { // Slots that undo or redo can revive or move.
+        int edit_count = stacks[stack_index]->size();
+        for (int edit_index = 0; edit_index < edit_count; edit_index++) {
+          sEdit& edit = (*stacks[stack_index])[edit_index];
+          if (Refers_To_Slot(edit) && (edit.layer == layer)) {
+            kept[edit.index] = true;
+          }
+          if ((edit.type == eEDIT_LAYER) && (edit.to_layer == layer)) {
+            kept[edit.to_index] = true;
+          }
+          int sprite_count = edit.sprites.size();
+          for (int sprite_index = 0; sprite_index < sprite_count; sprite_index++) {
+            if (edit.sprites[sprite_index].layer == layer_index) {
+              kept[edit.sprites[sprite_index].index] = true;
+            }
+          }
+        }
+      }
+      std::vector<int> new_index(sprite_count, NO_VALUE_FOUND);
+      tSprite_List live;
+      for (int sprite_index = 0; sprite_index < sprite_count; sprite_index++) {
+        if (kept[sprite_index]) {
+          new_index[sprite_index] = live.Count();
+          live.Add(sprites[sprite_index]);
+        }
+      }
+      if (live.Count() == sprite_count) {
+        continue;
+      }
+      sprites = live;
+      compacted = true;
+      for (int stack_index = 0; stack_index < 2; stack_index++) {
+        int edit_count = stacks[stack_index]->size();
+        for (int edit_index = 0; edit_index < edit_count; edit_index++) {
+          sEdit& edit = (*stacks[stack_index])[edit_index];
+          if (Refers_To_Slot(edit) && (edit.layer == layer)) {
+            edit.index = new_index[edit.index];
+          }
+          if ((edit.type == eEDIT_LAYER) && (edit.to_layer == layer)) {
+            edit.to_index = new_index[edit.to_index];
+          }
+          int sprite_count = edit.sprites.size();
+          for (int sprite_index = 0; sprite_index < sprite_count; sprite_index++) { // Moved sprites are kept with the edit.
+            if (edit.sprites[sprite_index].layer == layer_index) {
+              edit.sprites[sprite_index].index = new_index[edit.sprites[sprite_index].index];
+            }
+          }
+        }
+      }
+      int sel_count = this->selection.size();
+      for (int sel_index = 0; sel_index < sel_count; sel_index++) { // Selected sprites are alive, so they are kept.
+        if (this->selection[sel_index].layer == layer_index) {
+          this->selection[sel_index].index = new_index[this->selection[sel_index].index];
+        }
+      }
+      if ((layer == this->sel_layer) && (map_editor["sel-sprite"].number != NO_VALUE_FOUND)) {
+        map_editor["sel-sprite"].Set_Number(new_index[map_editor["sel-sprite"].number]);
+      }
+      std::vector<sOverlap> overlaps;
+      int overlap_count = this->overlaps.size();
+      for (int overlap_index = 0; overlap_index < overlap_count; overlap_index++) {
+        sOverlap overlap = this->overlaps[overlap_index];
+        if (overlap.layer_a == layer_index) {
+          overlap.index_a = new_index[overlap.index_a];
+        }
+        if (overlap.layer_b == layer_index) {
+          overlap.index_b = new_index[overlap.index_b];
+        }
+        if ((overlap.index_a != NO_VALUE_FOUND) && (overlap.index_b != NO_VALUE_FOUND)) {
+          overlaps.push_back(overlap);
+        }
+      }
+      this->overlaps.swap(overlaps);
+      this->z_orders.erase(layer);
+      this->Invalidate_Layer(layer);
+    }
+    if (compacted) { // Jobs in flight hold the old numbering.
+      this->Cancel_Map_Jobs();
+      this->map_revision++;
+    }
+  }
+
+  /**
+   * Applies an edit forwards or backwards. Every edit touches a fixed number
+   * of slots so undo and redo take constant time.
+   * @param edit The edit to apply.
+   * @param forward True to apply the edit, false to revert it.
+   */
+  void cMap_Editor::Apply_Edit(sEdit& edit, bool forward) {
+    this->map_revision++;
+    if ((edit.type != eEDIT_META) && (edit.type != eEDIT_TILES) && (edit.type != eEDIT_MOVE_GROUP) && ((edit.type != eEDIT_PROPERTY) || Affects_Bounds(edit.key))) {
+      this->Invalidate_Layer(edit.layer);
+    }
+    switch (edit.type) {
+      case eEDIT_PLACE: {
+        (*this->sprite_layers)[edit.layer][edit.index].alive = forward;
+        break;
+      }
+      case eEDIT_DELETE: {
+        (*this->sprite_layers)[edit.layer][edit.index].alive = !forward;
+        break;
+      }
+      case eEDIT_MOVE_GROUP: { // The new coordinates hold the offset.
+        int sign = forward ? 1 : -1;
+        int sprite_count = edit.sprites.size();
+        for (int sprite_index = 0; sprite_index < sprite_count; sprite_index++) {
+          sSprite_Ref& ref = edit.sprites[sprite_index];
+          std::string& layer = this->sprite_layers->keys[ref.layer];
+          cSprite& sprite = this->sprite_layers->values[ref.layer][ref.index];
+          sprite.Set("x", cValue(sprite.Get("x").number + sign * edit.new_coords.x));
+          sprite.Set("y", cValue(sprite.Get("y").number + sign * edit.new_coords.y));
+          this->Invalidate_Layer(layer);
+          this->Update_Z_Order(layer, ref.index);
+        }
+        break;
+      }
+      case eEDIT_MOVE: {
+        sPoint& coords = forward ? edit.new_coords : edit.old_coords;
+        cSprite& sprite = (*this->sprite_layers)[edit.layer][edit.index];
+        sprite.Set("x", cValue(coords.x));
+        sprite.Set("y", cValue(coords.y));
+        this->Update_Z_Order(edit.layer, edit.index);
+        break;
+      }
+      case eEDIT_PROPERTY: {
+        cSprite& sprite = (*this->sprite_layers)[edit.layer][edit.index];
+        if (forward) {
+          sprite.Set(edit.key, edit.new_value);
+        }
+        else if (edit.overridden) {
+          sprite.Set(edit.key, edit.old_value);
+        }
+        else { // Fall back to the prototype again.
+          sprite.Remove_Override(edit.key);
+        }
+        if ((edit.key == "y") || (edit.key == "z")) {
+          this->Update_Z_Order(edit.layer, edit.index);
+        }
+        break;
+      }
+      case eEDIT_LAYER: {
+        this->Invalidate_Layer(edit.to_layer);
+        (*this->sprite_layers)[edit.layer][edit.index].alive = !forward;
+        (*this->sprite_layers)[edit.to_layer][edit.to_index].alive = forward;
+        this->Update_Z_Order(edit.to_layer, edit.to_index);
+        break;
+      }
+      case eEDIT_TILES: {
+        cTile_Layer& tiles = this->tile_layers[edit.layer];
+        int change_count = edit.tile_changes.size();
+        for (int change_index = 0; change_index < change_count; change_index += 3) { // Cell, old value, new value.
+          tiles.cells[edit.tile_changes[change_index]] = edit.tile_changes[change_index + (forward ? 2 : 1)];
+        }
+        break;
+      }
+      case eEDIT_META: {
+        if (forward || edit.overridden) {
+          (*this->meta_data)[edit.key] = forward ? edit.new_value : edit.old_value;
+        }
+        else {
+          this->meta_data->Remove(edit.key);
+        }
+        if (this->components.Does_Key_Exist(edit.key)) { // Keep the background and music fields in sync.
+          this->components[edit.key]["text"].Set_String(this->meta_data->Does_Key_Exist(edit.key) ? (*this->meta_data)[edit.key].string : "");
+          this->components[edit.key]["edited"].Set_Number(0);
+        }
+        break;
+      }
+    }
+  }
+
+  /**
+   * Marks the caches of a layer as stale. They are rebuilt once on next use,
+   * no matter how many sprites changed.
+   * @param layer The name of the layer.
+   */
+  void cMap_Editor::Invalidate_Layer(std::string layer) {
+    this->spatial[layer].dirty = true;
+  }
+
+  /**
+   * Determines if a property is used for the bounds in the spatial grid.
+   * Other property edits leave the grid of the layer alone.
+   * @param key The name of the property.
+   * @return True if the property places or sizes the sprite.
+   */
+  bool cMap_Editor::Affects_Bounds(std::string key) {
+    return ((key == "x") || (key == "y") || (key == "width") || (key == "height") || (key == "bump-map"));
+  }
+
+  /**
+   * Gets the spatial grid of a layer, rebuilding it if it is stale.
+   * @param layer The name of the layer.
+   * @return The spatial grid.
+   */
+  cSpatial_Grid& cMap_Editor::Get_Spatial(std::string layer) {
+    cSpatial_Grid& grid = this->spatial[layer];
+    if (grid.dirty) {
+      grid.Build((*this->sprite_layers)[layer]);
+    }
+    return grid;
+  }
+
+  /**
+   * Gets the draw order of a layer. The sort key of a layer is the sort-<layer>
+   * meta data property, so the game can read it from the map as well.
+   * @param layer The name of the layer.
+   * @return The draw order or NULL if the layer is drawn in insertion order.
+   */
+  cZ_Order* cMap_Editor::Get_Z_Order(std::string layer) {
+    std::string key = "sort-" + layer;
+    if (!this->meta_data->Does_Key_Exist(key) || (((*this->meta_data)[key].string != "y") && ((*this->meta_data)[key].string != "z"))) {
+      return NULL;
+    }
+    cZ_Order& order = this->z_orders[layer];
+    tSprite_List& sprites = (*this->sprite_layers)[layer];
+    if ((order.sort_key != (*this->meta_data)[key].string) || ((int)order.keys.size() != sprites.Count())) { // New key or loaded sprites.
+      order.Build(sprites, (*this->meta_data)[key].string);
+    }
+    return &order;
+  }
+
+  /**
+   * Keeps the draw order of a layer current after a sprite moved, changed or
+   * was added. Orders that were never built are left for Get_Z_Order.
+   * @param layer The name of the layer.
+   * @param index The index of the sprite.
+   */
+  void cMap_Editor::Update_Z_Order(std::string layer, int index) {
+    std::unordered_map<std::string, cZ_Order>::iterator order = this->z_orders.find(layer);
+    if ((order != this->z_orders.end()) && (order->second.sort_key != "") && (index <= (int)order->second.keys.size())) {
+      order->second.Update((*this->sprite_layers)[layer], index);
+    }
+  }
+
+  /**
+   * Finds the index of a layer.
+   * @param layer The name of the layer.
+   * @return The index of the layer or NO_VALUE_FOUND.
+   */
+  int cMap_Editor::Find_Layer(std::string layer) {
+    int layer_count = this->sprite_layers->Count();
+    int found = NO_VALUE_FOUND;
+    for (int layer_index = 0; layer_index < layer_count; layer_index++) {
+      if (this->sprite_layers->keys[layer_index] == layer) {
+        found = layer_index;
+        break;
+      }
+    }
+    return found;
+  }
+
+  /**
+   * Selects the sprites whose bounds touch a rectangle.
+   * @param area The rectangle in map coordinates.
+   * @param layer_filter The layer to select from or an empty string for all.
+   * @param sprite_filter The catalog name to select or an empty string for all.
+   * @param add True to add to the selection, false to replace it.
+   */
+  void cMap_Editor::Select_In_Rectangle(sRectangle area, std::string layer_filter, std::string sprite_filter, bool add) {
+    if (!add) {
+      this->selection.clear();
+    }
+    std::vector<int> found;
+    int layer_count = this->sprite_layers->Count();
+    for (int layer_index = 0; layer_index < layer_count; layer_index++) {
+      std::string& layer = this->sprite_layers->keys[layer_index];
+      if ((layer_filter != "") && (layer != layer_filter)) {
+        continue;
+      }
+      tSprite_List& sprites = this->sprite_layers->values[layer_index];
+      found.clear();
+      this->Get_Spatial(layer).Query(area, found);
+      int found_count = found.size();
+      for (int found_index = 0; found_index < found_count; found_index++) {
+        if ((sprite_filter == "") || (sprites[found[found_index]].Get_Sprite_Id() == sprite_filter)) {
+          sSprite_Ref ref = { layer_index, found[found_index] };
+          this->selection.push_back(ref);
+        }
+      }
+    }
+  }
+
+  /**
+   * Selects every sprite matching a filter.
+   * @param layer_filter The layer to select from or an empty string for all.
+   * @param sprite_filter The catalog name to select or an empty string for all.
+   * @param add True to add to the selection, false to replace it.
+   */
+  void cMap_Editor::Select_By_Filter(std::string layer_filter, std::string sprite_filter, bool add) {
+    if (!add) {
+      this->selection.clear();
+    }
+    int proto = (sprite_filter != "") ? this->Find_Prototype(sprite_filter) : NO_VALUE_FOUND;
+    int layer_count = this->sprite_layers->Count();
+    for (int layer_index = 0; layer_index < layer_count; layer_index++) {
+      if ((layer_filter != "") && (this->sprite_layers->keys[layer_index] != layer_filter)) {
+        continue;
+      }
+      tSprite_List& sprites = this->sprite_layers->values[layer_index];
+      int sprite_count = sprites.Count();
+      for (int sprite_index = 0; sprite_index < sprite_count; sprite_index++) {
+        cSprite& sprite = sprites[sprite_index];
+        if (sprite.alive && ((sprite_filter == "") || (sprite.proto == proto))) {
+          sSprite_Ref ref = { layer_index, sprite_index };
+          this->selection.push_back(ref);
+        }
+      }
+    }
+  }
+
+  /**
+   * Moves every selected sprite with one edit, however many are selected.
+   * @param dx The horizontal offset.
+   * @param dy The vertical offset.
+   */
+  void cMap_Editor::Move_Selection(int dx, int dy) {
+    if (this->selection.empty()) {
+      return;
+    }
+    sEdit edit;
+    edit.type = eEDIT_MOVE_GROUP;
+    edit.sprites = this->selection;
+    edit.new_coords.x = dx;
+    edit.new_coords.y = dy;
+    this->Apply_Edit(edit, true);
+    this->history.Record(edit);
+  }
+
+  /**
+   * Duplicates the selected sprites. The copies become the selection.
+   * @param dx The horizontal offset of the copies.
+   * @param dy The vertical offset of the copies.
+   */
+  void cMap_Editor::Duplicate_Selection(int dx, int dy) {
+    this->history.Begin_Group();
+    int sel_count = this->selection.size();
+    for (int sel_index = 0; sel_index < sel_count; sel_index++) {
+      sSprite_Ref& ref = this->selection[sel_index];
+      cSprite copy = this->sprite_layers->values[ref.layer][ref.index];
+      copy.Detach();
+      copy.Set("x", cValue(copy.Get("x").number + dx));
+      copy.Set("y", cValue(copy.Get("y").number + dy));
+      ref.index = this->Place_Sprite(copy);
+    }
+    this->history.End_Group();
+  }
+
+  /**
+   * Deletes the selected sprites in one undo group.
+   */
+  void cMap_Editor::Delete_Selection() {
+    this->history.Begin_Group();
+    int sel_count = this->selection.size();
+    for (int sel_index = 0; sel_index < sel_count; sel_index++) {
+      sSprite_Ref& ref = this->selection[sel_index];
+      this->Delete_Sprite(this->sprite_layers->keys[ref.layer], ref.index);
+    }
+    this->history.End_Group();
+    this->selection.clear();
+    this->Get_Component("map-editor")["sel-sprite"].Set_Number(NO_VALUE_FOUND);
+  }
+
+  /**
+   * Sets a property on every selected sprite in one undo group.
+   * @param key The name of the property.
+   * @param value The value to set.
+   */
+  void cMap_Editor::Set_Selection_Property(std::string key, cValue value) {
+    Check_Condition((key != "layer"), "Use the layer field to move sprites between layers.");
+    this->history.Begin_Group();
+    int sel_count = this->selection.size();
+    for (int sel_index = 0; sel_index < sel_count; sel_index++) {
+      sSprite_Ref& ref = this->selection[sel_index];
+      this->Set_Sprite_Property(this->sprite_layers->keys[ref.layer], ref.index, key, value);
+    }
+    this->history.End_Group();
+  }
+
+  /**
+   * Outlines the selected sprites.
+   * @param map_editor The map editor component.
+   */
+  void cMap_Editor::Render_Selection(tObject& map_editor) {
+    int sel_count = this->selection.size();
+    for (int sel_index = 0; sel_index < sel_count; sel_index++) {
+      sSprite_Ref& ref = this->selection[sel_index];
+      cSpatial_Grid& grid = this->Get_Spatial(this->sprite_layers->keys[ref.layer]);
+      if (grid.has_bounds[ref.index]) {
+        this->Render_Outline(this->To_View(map_editor, grid.bounds[ref.index]), 0, 255, 0);
+      }
+    }
+  }
+
+  /**
+   * Draws the outline of a rectangle.
+   * @param box The rectangle.
+   * @param red The red component.
+   * @param green The green component.
+   * @param blue The blue component.
+   */
+  void cMap_Editor::Render_Outline(sRectangle box, int red, int green, int blue) {
+    int width = box.right - box.left + 1;
+    int height = box.bottom - box.top + 1;
+    this->io->Box(box.left, box.top, width, 1, red, green, blue);
+    this->io->Box(box.left, box.bottom, width, 1, red, green, blue);
+    this->io->Box(box.left, box.top, 1, height, red, green, blue);
+    this->io->Box(box.right, box.top, 1, height, red, green, blue);
+  }
+
+  /**
+   * Creates a dense tile layer under the sprites of a layer.
+   * @param layer The name of the layer.
+   * @param cell_w The width of a cell in pixels.
+   * @param cell_h The height of a cell in pixels.
+   * @param columns The number of columns.
+   * @param rows The number of rows.
+   */
+  void cMap_Editor::Create_Tile_Layer(std::string layer, int cell_w, int cell_h, int columns, int rows) {
+    Check_Condition(this->sprite_layers->Does_Key_Exist(layer), "There is no layer " + layer + ".");
+    Check_Condition((cell_w > 0) && (cell_h > 0), "Tile cells need a size.");
+    cTile_Layer& tiles = this->tile_layers[layer];
+    tiles.cell_w = cell_w;
+    tiles.cell_h = cell_h;
+    tiles.Resize(columns, rows);
+  }
+
+  /**
+   * Paints, flood fills or rectangle fills tiles with the selected sprite.
+   * @param layer The name of the layer.
+   * @param tool The tool which is brush, fill or rect.
+   * @param area The press and current point in map coordinates.
+   * @param brush The size of the brush in cells.
+   */
+  void cMap_Editor::Edit_Tiles(std::string layer, std::string tool, sRectangle area, int brush) {
+    cTile_Layer& tiles = this->tile_layers[layer];
+    int proto = this->Find_Prototype(this->sel_sprite_id);
+    this->Load_Prototype(proto);
+    sEdit edit;
+    edit.type = eEDIT_TILES;
+    edit.layer = layer;
+    int left = area.left / tiles.cell_w;
+    int top = area.top / tiles.cell_h;
+    int right = area.right / tiles.cell_w;
+    int bottom = area.bottom / tiles.cell_h;
+    if (tool == "brush") {
+      tiles.Paint(right, bottom, brush, proto, edit.tile_changes);
+    }
+    else if (tool == "fill") {
+      tiles.Flood_Fill(left, top, proto, edit.tile_changes);
+    }
+    else if (tool == "rect") {
+      tiles.Fill_Rectangle(std::min(left, right), std::min(top, bottom), std::max(left, right), std::max(top, bottom), proto, edit.tile_changes);
+    }
+    if (!edit.tile_changes.empty()) {
+      this->history.Record(edit);
+    }
+  }
+
+  /**
+   * Renders only the rows and columns of a tile layer that are in view.
+   * @param layer The name of the layer.
+   * @param map_editor The map editor component.
+   */
+  void cMap_Editor::Render_Tiles(std::string layer, tObject& map_editor) {
+    std::unordered_map<std::string, cTile_Layer>::iterator entry = this->tile_layers.find(layer);
+    if (entry != this->tile_layers.end()) {
+      cTile_Layer& tiles = entry->second;
+      int zoom = map_editor["zoom"].number;
+      sPoint origin = { 0, 0 };
+      sPoint corner = { map_editor["width"].number * this->cell_w - 1, map_editor["height"].number * this->cell_h - 1 };
+      origin = this->To_World(map_editor, origin);
+      corner = this->To_World(map_editor, corner);
+      int first_col = std::max(0, origin.x / tiles.cell_w);
+      int first_row = std::max(0, origin.y / tiles.cell_h);
+      int last_col = std::min(tiles.columns - 1, corner.x / tiles.cell_w);
+      int last_row = std::min(tiles.rows - 1, corner.y / tiles.cell_h);
+      // Skip cells that would be smaller than a pixel so far zoom levels sample the layer.
+      int step = 1;
+      while ((Scale_Size(tiles.cell_w * step, zoom) < 1) || (Scale_Size(tiles.cell_h * step, zoom) < 1)) {
+        step *= 2;
+      }
+      for (int row = first_row - first_row % step; row <= last_row; row += step) {
+        for (int column = first_col - first_col % step; column <= last_col; column += step) {
+          int proto = tiles.cells[row * tiles.columns + column];
+          if (proto != NO_VALUE_FOUND) {
+            std::string& icon = this->catalog_index.entries[proto].icon;
+            sRectangle cell = { column * tiles.cell_w, row * tiles.cell_h, (column + step) * tiles.cell_w - 1, (row + step) * tiles.cell_h - 1 };
+            sRectangle view = this->To_View(map_editor, cell);
+            this->Require_Icon(icon);
+            this->io->Draw_Image(this->Get_Zoomed_Icon(icon, zoom), view.left, view.top, view.right - view.left + 1, view.bottom - view.top + 1, 0, false, false);
+          }
+        }
+      }
+    }
+  }
+
+  /**
+   * Encodes a tile layer as a map record. Cells are run-length encoded as
+   * count:palette pairs, and the palette lists the catalog names used.
+   * @param layer The name of the layer.
+   * @return The record.
+   */
+  tObject cMap_Editor::Encode_Tile_Layer(std::string layer) {
+    cTile_Layer& tiles = this->tile_layers[layer];
+    std::unordered_map<int, int> palette_lookup;
+    cArray<std::string> palette;
+    cArray<std::string> runs;
+    int cell_count = tiles.cells.size();
+    int cell_index = 0;
+    while (cell_index < cell_count) {
+      int proto = tiles.cells[cell_index];
+      int run = 1;
+      while ((cell_index + run < cell_count) && (tiles.cells[cell_index + run] == proto)) {
+        run++;
+      }
+      int entry = NO_VALUE_FOUND;
+      if (proto != NO_VALUE_FOUND) {
+        if (palette_lookup.find(proto) == palette_lookup.end()) {
+          palette_lookup[proto] = palette.Count();
+          palette.Add(this->catalog.keys[proto]);
+        }
+        entry = palette_lookup[proto];
+      }
+      runs.Add(Number_To_Text(run) + ":" + Number_To_Text(entry));
+      cell_index += run;
+    }
+    tObject record;
+    record["tiles"].Set_String(layer);
+    record["tile-w"].Set_Number(tiles.cell_w);
+    record["tile-h"].Set_Number(tiles.cell_h);
+    record["columns"].Set_Number(tiles.columns);
+    record["rows"].Set_Number(tiles.rows);
+    record["palette"].Set_String(Join(palette, ";"));
+    record["cells"].Set_String(Join(runs, ","));
+    return record;
+  }
+
+  /**
+   * Decodes a tile layer record.
+   * @param record The record read from the map.
+   * @throws An error if the record is not valid.
+   */
+  void cMap_Editor::Decode_Tile_Layer(tObject& record) {
+    std::vector<std::string> problems;
+    Check_Tile_Layer(record, [this](const std::string& sprite_id) { return (this->Find_Prototype(sprite_id) != NO_VALUE_FOUND); }, problems);
+    Check_Problems(problems);
+    std::string layer = record["tiles"].string;
+    this->Create_Tile_Layer(layer, record["tile-w"].number, record["tile-h"].number, record["columns"].number, record["rows"].number);
+    cTile_Layer& tiles = this->tile_layers[layer];
+    cArray<std::string> palette = Parse_Sausage_Text(record.Does_Key_Exist("palette") ? record["palette"].string : "", ";");
+    std::vector<int> protos;
+    int palette_count = palette.Count();
+    for (int palette_index = 0; palette_index < palette_count; palette_index++) {
+      int proto = this->Find_Prototype(palette[palette_index]);
+      this->Load_Prototype(proto);
+      protos.push_back(proto);
+    }
+    cArray<std::string> runs = Parse_Sausage_Text(record.Does_Key_Exist("cells") ? record["cells"].string : "", ",");
+    int run_count = runs.Count();
+    int cell_index = 0;
+    for (int run_index = 0; run_index < run_count; run_index++) { // Checked above.
+      cArray<std::string> run = Parse_Sausage_Text(runs[run_index], ":");
+      int length = Text_To_Number(run[0]);
+      int entry = Text_To_Number(run[1]);
+      std::fill(tiles.cells.begin() + cell_index, tiles.cells.begin() + cell_index + length, (entry == NO_VALUE_FOUND) ? NO_VALUE_FOUND : protos[entry]);
+      cell_index += length;
+    }
+  }
+
+  /**
+   * Checks the meta data of a map. The editor and the batch checker share
+   * these checks so they report the same problems.
+   * @param meta_data The meta data record.
+   * @param problems Receives a message for each problem.
+   */
+  void cMap_Editor::Check_Meta_Data(tObject& meta_data, std::vector<std::string>& problems) {
+    if (!meta_data.Does_Key_Exist("background")) {
+      problems.push_back("No background property in meta data.");
+    }
+    if (!meta_data.Does_Key_Exist("music")) {
+      problems.push_back("No music property in meta data.");
+    }
+  }
+
+  /**
+   * Checks that a sprite record names a catalog sprite.
+   * @param sprite_id The catalog name in the record.
+   * @param in_catalog Whether the catalog has the sprite.
+   * @param problems Receives a message for each problem.
+   */
+  void cMap_Editor::Check_Sprite_Id(std::string sprite_id, bool in_catalog, std::vector<std::string>& problems) {
+    if (!in_catalog) {
+      problems.push_back("Sprite " + sprite_id + " is not in the catalog.");
+    }
+  }
+
+  /**
+   * Checks the layer a record is loaded to.
+   * @param has_layer Whether the record has a layer.
+   * @param layer The name of the layer.
+   * @param kind Either sprite or tiles.
+   * @param problems Receives a message for each problem.
+   */
+  void cMap_Editor::Check_Layer(bool has_layer, std::string layer, std::string kind, std::vector<std::string>& problems) {
+    bool found = false;
+    for (int layer_index = 0; layer_index < MAP_LAYER_COUNT; layer_index++) {
+      found = found || (MAP_LAYERS[layer_index] == layer);
+    }
+    if (!has_layer) {
+      problems.push_back("No layer property in " + kind + ".");
+    }
+    else if (!found) {
+      problems.push_back("Trying to load " + kind + " to non-existant layer " + layer + ".");
+    }
+  }
+
+  /**
+   * Checks a tile layer record without decoding it.
+   * @param record The record read from the map.
+   * @param in_catalog Determines if a catalog name is in the catalog.
+   * @param problems Receives a message for each problem.
+   */
+  void cMap_Editor::Check_Tile_Layer(tObject& record, std::function<bool(const std::string&)> in_catalog, std::vector<std::string>& problems) {
+    Check_Layer(true, record["tiles"].string, "tiles", problems);
+    if (!record.Does_Key_Exist("tile-w") || !record.Does_Key_Exist("tile-h") || (record["tile-w"].number <= 0) || (record["tile-h"].number <= 0)) {
+      problems.push_back("Tile layer has no cell size.");
+    }
+    if (!record.Does_Key_Exist("columns") || !record.Does_Key_Exist("rows") || (record["columns"].number < 0) || (record["rows"].number < 0)) {
+      problems.push_back("Tile layer has no dimensions.");
+      return;
+    }
+    cArray<std::string> palette = Parse_Sausage_Text(record.Does_Key_Exist("palette") ? record["palette"].string : "", ";");
+    int palette_count = palette.Count();
+    for (int palette_index = 0; palette_index < palette_count; palette_index++) {
+      if (!in_catalog(palette[palette_index])) {
+        problems.push_back("Tile " + palette[palette_index] + " is not in the catalog.");
+      }
+    }
+    cArray<std::string> runs = Parse_Sausage_Text(record.Does_Key_Exist("cells") ? record["cells"].string : "", ",");
+    long long cell_count = (long long)record["columns"].number * record["rows"].number;
+    long long cell_index = 0;
+    int run_count = runs.Count();
+    for (int run_index = 0; run_index < run_count; run_index++) {
+      cArray<std::string> run = Parse_Sausage_Text(runs[run_index], ":");
+      if (run.Count() != 2) {
+        problems.push_back("Tile run is not formatted correctly.");
+        return;
+      }
+      int length = Text_To_Number(run[0]);
+      int entry = Text_To_Number(run[1]);
+      if (length < 0) {
+        problems.push_back("Tile run has a negative length.");
+        return;
+      }
+      if ((entry < NO_VALUE_FOUND) || (entry >= palette_count)) {
+        problems.push_back("Tile run refers to a missing palette entry.");
+        return;
+      }
+      if (cell_index + length > cell_count) {
+        problems.push_back("Tile runs overflow the layer.");
+        return;
+      }
+      cell_index += length;
+    }
+  }
+
+  /**
+   * Throws the first problem found by the record checks.
+   * @param problems The problems.
+   * @throws An error if there is a problem.
+   */
+  void cMap_Editor::Check_Problems(std::vector<std::string>& problems) {
+    if (!problems.empty()) {
+      throw cError(problems[0]);
+    }
+  }
+
+  /**
+   * Finds every pair of overlapping bump maps across all layers.
+   * @return The number of overlapping pairs.
+   */
+  int cMap_Editor::Analyze_Overlaps() {
+    cOverlap_Finder finder;
+    this->Collect_Boxes(finder);
+    finder.Find(this->overlaps, std::thread::hardware_concurrency());
+    return this->overlaps.size();
+  }
+
+  /**
+   * Adds the bump maps of all layers to an overlap finder. Stale layer grids
+   * are rebuilt in parallel first.
+   * @param finder The finder to add to.
+   */
+  void cMap_Editor::Collect_Boxes(cOverlap_Finder& finder) {
+    int layer_count = this->sprite_layers->Count();
+    cJob_System& jobs = cJob_System::Shared();
+    tJob_Batch batch = cJob_System::New_Batch();
+    for (int layer_index = 0; layer_index < layer_count; layer_index++) {
+      cSpatial_Grid* grid = &this->spatial[this->sprite_layers->keys[layer_index]];
+      tSprite_List* sprites = &this->sprite_layers->values[layer_index];
+      if (grid->dirty) {
+        jobs.Add_Job([grid, sprites]() {
+          try {
+            grid->Build(*sprites);
+          }
+          catch (cError error) { // Left dirty so the rebuild below reports it.
+          }
+        }, eJOB_FRAME, batch, tJob_Token());
+      }
+    }
+    jobs.Wait(batch);
+    for (int layer_index = 0; layer_index < layer_count; layer_index++) {
+      cSpatial_Grid& grid = this->Get_Spatial(this->sprite_layers->keys[layer_index]);
+      int sprite_count = grid.bounds.size();
+      for (int sprite_index = 0; sprite_index < sprite_count; sprite_index++) {
+        if (grid.has_bounds[sprite_index]) {
+          finder.Add(grid.bounds[sprite_index], layer_index, sprite_index);
+        }
+      }
+    }
+  }
+
+  /**
+   * Finds overlapping bump maps in the background. The sweep works on a copy
+   * of the boxes and its result is applied on the main thread, unless the map
+   * was replaced in the meantime.
+   * @param button The button that shows the result.
+   */
+  void cMap_Editor::Start_Overlap_Analysis(tObject& button) {
+    std::shared_ptr<cOverlap_Finder> finder(new cOverlap_Finder());
+    this->Collect_Boxes(*finder);
+    button["label"].Set_String("Overlaps: ...");
+    tJob_Token token = this->map_token;
+    tObject* label = &button;
+    int worker_count = std::thread::hardware_concurrency();
+    cJob_System::Shared().Add_Job([this, finder, token, label, worker_count]() {
+      std::shared_ptr<std::vector<sOverlap>> overlaps(new std::vector<sOverlap>());
+      finder->Find(*overlaps, worker_count);
+      cJob_System::Shared().Post_Main([this, overlaps, label]() {
+        this->overlaps.swap(*overlaps);
+        (*label)["label"].Set_String("Overlaps: " + Number_To_Text(this->overlaps.size()));
+      }, token);
+    }, eJOB_BACKGROUND, tJob_Batch(), token);
+  }
+
+  /**
+   * Abandons background jobs for the map being edited.
+   */
+  void cMap_Editor::Cancel_Map_Jobs() {
+    this->map_token->store(true);
+    this->map_token = cJob_System::New_Token();
+  }
+
+  /**
+   * Outlines the sprites found by the last overlap analysis.
+   * @param map_editor The map editor component.
+   */
+  void cMap_Editor::Render_Overlaps(tObject& map_editor) {
+    int overlap_count = this->overlaps.size();
+    for (int overlap_index = 0; overlap_index < overlap_count; overlap_index++) {
+      sOverlap& overlap = this->overlaps[overlap_index];
+      sSprite_Ref refs[2] = { { overlap.layer_a, overlap.index_a }, { overlap.layer_b, overlap.index_b } };
+      for (int ref_index = 0; ref_index < 2; ref_index++) {
+        cSpatial_Grid& grid = this->Get_Spatial(this->sprite_layers->keys[refs[ref_index].layer]);
+        if (grid.has_bounds[refs[ref_index].index]) {
+          this->Render_Outline(this->To_View(map_editor, grid.bounds[refs[ref_index].index]), 255, 0, 0);
+        }
+      }
+    }
+  }
+
+  /**
+   * Finds the first component of a type.
+   * @param type The type of the component.
+   * @return The component.
+   * @throws An error if there is no such component.
+   */
+  tObject& cMap_Editor::Get_Component(std::string type) {
+    int comp_count = this->components.Count();
+    for (int comp_index = 0; comp_index < comp_count; comp_index++) {
+      tObject& entity = this->components.values[comp_index];
+      if (entity.Does_Key_Exist("type") && (entity["type"].string == type)) {
+        return entity;
+      }
+    }
+    throw cError("No " + type + " component in layout.");
+  }
+
+  /**
+   * Creates a sprite from a map record. Records that name a catalog sprite keep
+   * only their overrides, older records without one keep every property.
+   * @param record The record read from the map file.
+   * @return The sprite instance.
+   */
+  cSprite cMap_Editor::Create_Sprite(tObject& record) {
+    int proto = NO_VALUE_FOUND;
+    if (record.Does_Key_Exist("sprite-id")) {
+      proto = this->Find_Prototype(record["sprite-id"].string);
+      std::vector<std::string> problems;
+      Check_Sprite_Id(record["sprite-id"].string, (proto != NO_VALUE_FOUND), problems);
+      Check_Problems(problems);
+    }
+    if (proto != NO_VALUE_FOUND) {
+      this->Load_Prototype(proto);
+      this->Require_Icon(this->catalog_index.entries[proto].icon);
+    }
+    else if (record.Does_Key_Exist("icon")) {
+      this->Require_Icon(record["icon"].string);
+    }
+    cSprite sprite(&this->catalog_index, &this->arena, proto);
+    sprite.Set_Overrides(record); // Overrides live in the map arena.
+    return sprite;
+  }
+
+  /**
+   * Estimates the number of bytes held by an object.
+   * @param object The object to measure.
+   * @return The size in bytes.
+   */
+  int cMap_Editor::Measure_Object(tObject& object) {
+    int bytes = sizeof(tObject);
+    int prop_count = object.Count();
+    for (int prop_index = 0; prop_index < prop_count; prop_index++) {
+      bytes += sizeof(std::string) + object.keys[prop_index].capacity();
+      bytes += sizeof(cValue) + object.values[prop_index].string.capacity();
+    }
+    return bytes;
+  }
+
+  /**
+   * Compares the memory used by flyweight sprites with full sprite copies.
+   * @return The report text.
+   */
+  std::string cMap_Editor::Get_Sprite_Memory_Report() {
+    int sprite_total = 0;
+    int flyweight_bytes = 0;
+    int copy_bytes = 0;
+    int layer_count = this->sprite_layers->Count();
+    for (int layer_index = 0; layer_index < layer_count; layer_index++) {
+      tSprite_List& layer = this->sprite_layers->values[layer_index];
+      int sprite_count = layer.Count();
+      for (int sprite_index = 0; sprite_index < sprite_count; sprite_index++) {
+        cSprite& sprite = layer[sprite_index];
+        if (!sprite.alive) {
+          continue;
+        }
+        tObject full = sprite.Flatten();
+        flyweight_bytes += sprite.Measure();
+        copy_bytes += this->Measure_Object(full);
+        sprite_total++;
+      }
+    }
+    int catalog_bytes = 0;
+    int catalog_size = this->catalog.Count();
+    for (int catalog_index = 0; catalog_index < catalog_size; catalog_index++) {
+      catalog_bytes += this->Measure_Object(this->catalog.values[catalog_index]);
+    }
+    std::string report = "sprites=" + Number_To_Text(sprite_total) + "\n";
+    report += "catalog-bytes=" + Number_To_Text(catalog_bytes) + "\n";
+    report += "flyweight-bytes=" + Number_To_Text(flyweight_bytes) + "\n";
+    report += "copy-bytes=" + Number_To_Text(copy_bytes) + "\n";
+    if (flyweight_bytes > 0) {
+      int ratio = (int)((double)copy_bytes * 100.0 / (double)(flyweight_bytes + catalog_bytes));
+      report += "copy-to-flyweight=" + Number_To_Text(ratio) + "%\n";
+    }
+    return report;
+  }
+
+  /**
+   * Measures every part of the editor that holds memory. Byte counts are
+   * estimates from container sizes, except the heap line which is counted.
+   * @return The updated report.
+   */
+  cMemory_Report& cMap_Editor::Update_Memory_Report() {
+    this->memory_report.Clear();
+    int layer_count = this->sprite_layers->Count();
+    for (int layer_index = 0; layer_index < layer_count; layer_index++) {
+      tSprite_List& layer = this->sprite_layers->values[layer_index];
+      long long bytes = 0;
+      int sprite_count = layer.Count();
+      for (int sprite_index = 0; sprite_index < sprite_count; sprite_index++) {
+        bytes += layer[sprite_index].Measure();
+      }
+      this->memory_report.Add("layer " + this->sprite_layers->keys[layer_index], bytes, sprite_count);
+    }
+    long long catalog_bytes = 0;
+    int catalog_size = this->catalog.Count();
+    for (int catalog_index = 0; catalog_index < catalog_size; catalog_index++) {
+      catalog_bytes += this->Measure_Object(this->catalog.values[catalog_index]);
+    }
+    int entry_count = this->catalog_index.entries.size();
+    for (int entry_index = 0; entry_index < entry_count; entry_index++) {
+      sCatalog_Entry& entry = this->catalog_index.entries[entry_index];
+      catalog_bytes += sizeof(sCatalog_Entry) + entry.name.capacity() + entry.icon.capacity();
+    }
+    this->memory_report.Add("catalog", catalog_bytes, catalog_size);
+    long long component_bytes = 0;
+    int comp_count = this->components.Count();
+    for (int comp_index = 0; comp_index < comp_count; comp_index++) {
+      component_bytes += this->Measure_Object(this->components.values[comp_index]);
+    }
+    this->memory_report.Add("components", component_bytes, comp_count);
+    this->memory_report.Add("arena", this->arena.Get_Bytes(), this->arena.allocations);
+    this->memory_report.Add("arena free lists", this->arena.free_bytes, this->arena.free_lists.size()); // Part of the arena.
+    long long text_bytes = 0;
+    int text_count = this->arena.texts.size();
+    for (int text_index = 0; text_index < text_count; text_index++) {
+      text_bytes += sizeof(std::string) + this->arena.texts[text_index].capacity();
+    }
+    this->memory_report.Add("sprite ids", text_bytes, text_count);
+    long long document_bytes = 0;
+    int document_count = this->documents.size();
+    for (int document_index = 0; document_index < document_count; document_index++) {
+      sMap_Document& document = *this->documents[document_index];
+      for (int layer_index = 0; layer_index < document.sprite_layers->Count(); layer_index++) {
+        tSprite_List& layer = document.sprite_layers->values[layer_index];
+        for (int sprite_index = 0; sprite_index < layer.Count(); sprite_index++) {
+          document_bytes += layer[sprite_index].Measure();
+        }
+      }
+      document_bytes += document.arena.Get_Bytes();
+    }
+    this->memory_report.Add("other open maps", document_bytes, document_count - 1);
+    long long string_bytes = 0;
+    int string_count = string_table.strings.size();
+    for (int string_index = 0; string_index < string_count; string_index++) {
+      string_bytes += sizeof(std::string) * 2 + sizeof(int) + string_table.strings[string_index].capacity() * 2; // Vector and hash copies.
+    }
+    this->memory_report.Add("string table", string_bytes, string_count);
+    // Images are counted as 32 bit pixels.
+    long long image_bytes = 0;
+    long long image_count = 0;
+    if (this->loader) {
+      for (std::unordered_map<std::string, bool>::iterator image = this->loader->loaded.begin(); image != this->loader->loaded.end(); ++image) {
+        ALLEGRO_BITMAP* bitmap = this->loader->allegro->images[image->first];
+        if (bitmap) {
+          image_bytes += (long long)al_get_bitmap_width(bitmap) * al_get_bitmap_height(bitmap) * 4;
+          image_count++;
+        }
+      }
+    }
+    else {
+      std::unordered_map<std::string, bool> icons;
+      for (int entry_index = 0; entry_index < entry_count; entry_index++) {
+        icons[this->catalog_index.entries[entry_index].icon] = true;
+      }
+      icons[(*this->meta_data)["background"].string] = true;
+      for (std::unordered_map<std::string, bool>::iterator icon = icons.begin(); icon != icons.end(); ++icon) {
+        image_bytes += (long long)this->io->Get_Image_Width(icon->first) * this->io->Get_Image_Height(icon->first) * 4;
+        image_count++;
+      }
+    }
+    this->memory_report.Add("images", image_bytes, image_count);
+    this->memory_report.Add("background tiles", this->tile_cache.bytes, this->tile_cache.tiles.size()); // Part of the images.
+    this->memory_report.Add("failed tiles", 0, this->tile_cache.failed.size());
+    long long history_bytes = 0;
+    std::vector<sEdit>* stacks[2] = { &this->history.undo_stack, &this->history.redo_stack };
+    for (int stack_index = 0; stack_index < 2; stack_index++) {
+      int edit_count = stacks[stack_index]->size();
+      for (int edit_index = 0; edit_index < edit_count; edit_index++) {
+        sEdit& edit = (*stacks[stack_index])[edit_index];
+        history_bytes += sizeof(sEdit) + edit.layer.capacity() + edit.to_layer.capacity() + edit.key.capacity();
+        history_bytes += edit.old_value.string.capacity() + edit.new_value.string.capacity() + edit.tile_changes.capacity() * sizeof(int) + edit.sprites.capacity() * sizeof(sSprite_Ref);
+      }
+    }
+    this->memory_report.Add("undo", history_bytes, this->history.undo_stack.size() + this->history.redo_stack.size());
+    long long spatial_bytes = 0;
+    long long cell_count = 0;
+    for (std::unordered_map<std::string, cSpatial_Grid>::iterator grid = this->spatial.begin(); grid != this->spatial.end(); ++grid) {
+      spatial_bytes += grid->second.bounds.capacity() * sizeof(sRectangle) + grid->second.has_bounds.capacity() / 8 + grid->second.stamps.capacity() * sizeof(int);
+      for (std::unordered_map<long long, std::vector<int>>::iterator cell = grid->second.cells.begin(); cell != grid->second.cells.end(); ++cell) {
+        spatial_bytes += sizeof(*cell) + cell->second.capacity() * sizeof(int);
+      }
+      cell_count += grid->second.cells.size();
+    }
+    this->memory_report.Add("spatial cache", spatial_bytes, cell_count);
+    long long order_bytes = 0;
+    for (std::unordered_map<std::string, cZ_Order>::iterator order = this->z_orders.begin(); order != this->z_orders.end(); ++order) {
+      order_bytes += sizeof(cZ_Order) + (order->second.order.capacity() + order->second.ranks.capacity() + order->second.keys.capacity()) * sizeof(int);
+    }
+    this->memory_report.Add("draw order", order_bytes, this->z_orders.size());
+    long long tile_bytes = 0;
+    for (std::unordered_map<std::string, cTile_Layer>::iterator tiles = this->tile_layers.begin(); tiles != this->tile_layers.end(); ++tiles) {
+      tile_bytes += sizeof(cTile_Layer) + tiles->second.cells.capacity() * sizeof(int);
+    }
+    this->memory_report.Add("tile layers", tile_bytes, this->tile_layers.size());
+    this->memory_report.Add("selection", this->selection.capacity() * sizeof(sSprite_Ref) + this->overlaps.capacity() * sizeof(sOverlap), this->selection.size() + this->overlaps.size());
+    long long level_bytes = 0;
+    for (std::map<std::string, sLevel_Entry>::iterator level = this->level_index.levels.begin(); level != this->level_index.levels.end(); ++level) {
+      level_bytes += sizeof(sLevel_Entry) + level->first.capacity() + level->second.background.capacity() + level->second.music.capacity();
+      level_bytes += level->second.layer_counts.size() * (sizeof(std::string) + sizeof(int));
+    }
+    this->memory_report.Add("level index", level_bytes, this->level_index.levels.size());
+    // Heap totals count every allocation made by the program.
+    this->memory_report.Add("heap", memory_stats.live_bytes.load(), memory_stats.allocations.load() - memory_stats.frees.load());
+    this->memory_report.peaks["heap"] = memory_stats.peak_bytes.load();
+    this->memory_report.entries.back().peak = memory_stats.peak_bytes.load();
+    this->memory_report.Add("allocations", memory_stats.allocated_bytes.load(), memory_stats.allocations.load()); // Every block since the start.
+    return this->memory_report;
+  }
+
+  /**
+   * Renders the memory report over the map editor.
+   * @param map_editor The map editor component.
+   */
+  void cMap_Editor::Render_Memory_Panel(tObject& map_editor) {
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    if ((this->memory_revision != this->map_revision) || (now - this->memory_time >= std::chrono::milliseconds(MEMORY_PANEL_MS))) { // The report walks every sprite.
+      this->memory_text = this->Update_Memory_Report().Get_Text();
+      this->memory_revision = this->map_revision;
+      this->memory_time = now;
+    }
+    cArray<std::string> lines = Parse_Sausage_Text(this->memory_text, "\n");
+    int line_count = lines.Count();
+    int line_height = this->io->Get_Text_Height("M") + 2;
+    this->io->Box(0, 0, map_editor["width"].number * this->cell_w, line_count * line_height + 4, 255, 255, 224);
+    for (int line_index = 0; line_index < line_count; line_index++) {
+      this->io->Output_Text(lines[line_index], 2, 2 + line_index * line_height, 0, 0, 0);
+    }
+  }
+
+  /**
+   * Runs one line of the command language. Commands are:
+   * catalog <name>, load <name>, save <name> [text|compact|packed], open <name>, tab <index>,
+   * close, tabs, jobs, sort <layer> <none|y|z>, tile-cache <MB>, layer <name>,
+   * place <sprite-id> <x> <y> [<count> <dx> <dy>], set <index> <key> <value>,
+   * select <left> <top> <right> <bottom>, set-selection <key> <value>,
+   * delete-selection, diff <name>, merge <base> <theirs>, undo, redo and quit.
+   * @param line The command line.
+   * @param quit Set to true by the quit command.
+   * @return The reply starting with "ok" or "error".
+   */
+  std::string cMap_Editor::Run_Command(std::string line, bool& quit) {
+    std::istringstream words(line);
+    std::string command = "";
+    words >> command;
+    std::string reply = "ok";
+    try {
+      if (command == "") {
+        reply = "";
+      }
+      else if (command == "catalog") {
+        std::string name;
+        words >> name;
+        this->Load_Catalog(name);
+        reply += " " + Number_To_Text(this->catalog.Count());
+      }
+      else if (command == "load") {
+        std::string name;
+        words >> name;
+        this->Load_Map(name);
+        this->documents[this->active_document]->name = name;
+      }
+      else if (command == "open") {
+        std::string name;
+        words >> name;
+        reply += " " + Number_To_Text(this->Open_Map(name));
+      }
+      else if (command == "tab") {
+        int index = NO_VALUE_FOUND;
+        words >> index;
+        this->Switch_Document(index);
+      }
+      else if (command == "close") {
+        this->Close_Document();
+      }
+      else if (command == "sort") {
+        std::string layer;
+        std::string key;
+        words >> layer >> key;
+        Check_Condition(this->sprite_layers->Does_Key_Exist(layer), "No layer " + layer + ".");
+        Check_Condition((key == "none") || (key == "y") || (key == "z"), "Layers sort by none, y or z.");
+        this->Set_Meta_Data("sort-" + layer, cValue((key == "none") ? "" : key));
+      }
+      else if (command == "tile-cache") {
+        int megabytes = NO_VALUE_FOUND;
+        words >> megabytes;
+        Check_Condition((megabytes >= 0), "The tile cache needs a size in megabytes.");
+        this->tile_cache.budget = (long long)megabytes * 1024 * 1024;
+        if (this->tile_cache.loader) {
+          this->tile_cache.Trim();
+        }
+        reply += " " + std::to_string(this->tile_cache.bytes);
+      }
+      else if (command == "jobs") {
+        reply += "\n" + cJob_System::Shared().Get_Stats();
+      }
+      else if (command == "tabs") {
+        int document_count = this->documents.size();
+        reply += " " + Number_To_Text(this->active_document);
+        for (int document_index = 0; document_index < document_count; document_index++) {
+          reply += "\n" + this->documents[document_index]->name;
+        }
+      }
+      else if (command == "save") {
+        std::string name;
+        std::string encoding;
+        words >> name >> encoding;
+        if (encoding.length() > 0) {
+          this->map_encoding = cMap_Codec::Get_Encoding(encoding);
+        }
+        this->Save_Map(name);
+      }
+      else if (command == "layer") {
+        std::string layer;
+        words >> layer;
+        Check_Condition(this->sprite_layers->Does_Key_Exist(layer), "No layer " + layer + ".");
+        this->sel_layer = layer;
+        this->components["layer"]["text"].Set_String(layer);
+      }
+      else if (command == "place") {
+        std::string sprite_id;
+        int x = 0;
+        int y = 0;
+        int count = 1;
+        int dx = 0;
+        int dy = 0;
+        words >> sprite_id >> x >> y;
+        if (!(words >> count >> dx >> dy)) {
+          count = 1;
+        }
+        int proto = this->Find_Prototype(sprite_id);
+        Check_Condition((proto != NO_VALUE_FOUND), "Sprite " + sprite_id + " is not in the catalog.");
+        this->Load_Prototype(proto);
+        this->Require_Icon(this->catalog_index.entries[proto].icon);
+        int first = NO_VALUE_FOUND;
+        this->history.Begin_Group(); // One undo step for the whole row.
+        for (int place_index = 0; place_index < count; place_index++) {
+          cSprite sprite(&this->catalog_index, &this->arena, proto);
+          sprite.Set("layer", cValue(this->sel_layer));
+          sprite.Set("x", cValue(x + place_index * dx));
+          sprite.Set("y", cValue(y + place_index * dy));
+          int index = this->Place_Sprite(sprite);
+          first = (place_index == 0) ? index : first;
+        }
+        this->history.End_Group();
+        reply += " " + Number_To_Text(first);
+      }
+      else if (command == "set") {
+        int index = NO_VALUE_FOUND;
+        std::string key;
+        std::string value;
+        words >> index >> key >> std::ws;
+        std::getline(words, value);
+        Check_Condition((index >= 0) && (index < (*this->sprite_layers)[this->sel_layer].Count()) && (*this->sprite_layers)[this->sel_layer][index].alive, "No sprite " + Number_To_Text(index) + " in layer " + this->sel_layer + ".");
+        this->Set_Sprite_Property(this->sel_layer, index, key, Parse_Value(value));
+      }
+      else if (command == "select") {
+        sRectangle area = { 0, 0, 0, 0 };
+        words >> area.left >> area.top >> area.right >> area.bottom;
+        this->Select_In_Rectangle(area, this->sel_layer, "", false);
+        reply += " " + Number_To_Text(this->selection.size());
+      }
+      else if (command == "set-selection") {
+        std::string key;
+        std::string value;
+        words >> key >> std::ws;
+        std::getline(words, value);
+        this->Set_Selection_Property(key, Parse_Value(value));
+      }
+      else if (command == "delete-selection") {
+        this->Delete_Selection();
+      }
+      else if (command == "undo") {
+        reply = this->Undo() ? "ok" : "error nothing to undo";
+      }
+      else if (command == "redo") {
+        reply = this->Redo() ? "ok" : "error nothing to redo";
+      }
+      else if (command == "diff") {
+        std::string name;
+        words >> name;
+        std::vector<sProperty_Change> changes;
+        this->Diff_Map(name, changes);
+        std::ostringstream lines;
+        cMap_Diff::Write_Changes(changes, lines);
+        reply += " " + Number_To_Text(changes.size()) + "\n" + lines.str();
+        reply.erase(reply.find_last_not_of('\n') + 1);
+      }
+      else if (command == "merge") {
+        std::string base;
+        std::string theirs;
+        words >> base >> theirs;
+        std::vector<sProperty_Change> conflicts;
+        this->Merge_Map(base, theirs, conflicts);
+        std::ostringstream lines;
+        cMap_Diff::Write_Changes(conflicts, lines);
+        reply += " " + Number_To_Text(conflicts.size()) + "\n" + lines.str();
+        reply.erase(reply.find_last_not_of('\n') + 1);
+      }
+      else if (command == "quit") {
+        quit = true;
+      }
+      else {
+        reply = "error unknown command " + command;
+      }
+    }
+    catch (cError error) {
+      std::cerr << error.message << std::endl; // Standard output carries the replies.
+      reply = "error " + command + ": " + error.message;
+    }
+    return reply;
+  }
+
+  // **************************************************************************
+  // Map Codec Implementation
+  // **************************************************************************
+
+  /**
+   * Reads the records of a map file in any encoding.
+   * @param file_name The name of the map file.
+   * @param records Receives the meta data record followed by the other records.
+   * @return The encoding of the file.
+   * @throws An error if the map could not be read.
+   */
+  eMap_Encoding cMap_Codec::Read_Map(std::string file_name, std::vector<tObject>& records) {
+    std::ifstream map_file(file_name, std::ios::binary);
+    Check_Condition(map_file.is_open(), "Could not open map " + file_name + ".");
+    std::string magic(MAP_MAGIC.length(), '\0');
+    map_file.read(&magic[0], magic.length());
+    if (!map_file || (magic != MAP_MAGIC)) { // Text map.
+      map_file.clear();
+      map_file.seekg(0);
+      tObject record;
+      while (Read_Object(map_file, record)) {
+        records.push_back(record);
+        record.Clear();
+      }
+      Check_Condition(!records.empty(), "No meta data in map " + file_name + ".");
+      return eMAP_TEXT;
+    }
+    std::ostringstream contents;
+    contents << map_file.rdbuf();
+    std::string data = contents.str();
+    Check_Condition((data.length() > 0), "Map " + file_name + " has no encoding flags.");
+    eMap_Encoding encoding = (data[0] & 1) ? eMAP_PACKED : eMAP_COMPACT;
+    if (encoding == eMAP_PACKED) {
+      Decode(Decompress(data, 1), 0, records);
+    }
+    else {
+      Decode(data, 1, records);
+    }
+    return encoding;
+  }
+
+  /**
+   * Writes records to a map file.
+   * @param file_name The name of the map file.
+   * @param records The meta data record followed by the other records.
+   * @param encoding How the records are written.
+   * @throws An error if the map could not be written.
+   */
+  void cMap_Codec::Write_Map(std::string file_name, std::vector<tObject>& records, eMap_Encoding encoding) {
+    int record_count = records.size();
+    if (encoding == eMAP_TEXT) {
+      cMap_Writer writer(file_name);
+      for (int record_index = 0; record_index < record_count; record_index++) {
+        writer.Write_Object(records[record_index]);
+      }
+      writer.Commit();
+      return;
+    }
+    std::string data = Encode(records);
+    cMap_Writer writer(file_name); // Written beside the map and renamed over it.
+    writer.Write_Text(MAP_MAGIC);
+    writer.Write_Text(std::string(1, (char)((encoding == eMAP_PACKED) ? 1 : 0)));
+    if (encoding == eMAP_PACKED) {
+      writer.Write_Text(Compress(data));
+    }
+    else {
+      writer.Write_Text(data);
+    }
+    writer.Commit();
+  }
+
+  /**
+   * Gets an encoding by name.
+   * @param name One of text, compact or packed.
+   * @return The encoding.
+   * @throws An error if there is no such encoding.
+   */
+  eMap_Encoding cMap_Codec::Get_Encoding(std::string name) {
+    if (name == "text") {
+      return eMAP_TEXT;
+    }
+    else if (name == "compact") {
+      return eMAP_COMPACT;
+    }
+    else if (name == "packed") {
+      return eMAP_PACKED;
+    }
+    throw cError("Unknown map encoding " + name + ".");
+  }
+
+  /**
+   * Encodes records into the compact format. Every distinct record with its
+   * positions and ids taken out is stored once in a dictionary, so copies of
+   * a catalog sprite cost an index and a few bytes of position each.
+   * Positions are stored as the difference to the previous record.
+   * @param records The records to encode.
+   * @return The strings, the dictionary and the records.
+   */
+  std::string cMap_Codec::Encode(std::vector<tObject>& records) {
+    std::unordered_map<std::string, int> string_ids;
+    std::string strings;
+    std::unordered_map<std::string, int> shape_ids;
+    std::string shapes;
+    std::string instances;
+    long long last[2] = { 0, 0 };
+    auto Intern = [&](const std::string& text) -> int {
+      std::unordered_map<std::string, int>::iterator found = string_ids.find(text);
+      if (found != string_ids.end()) {
+        return found->second;
+      }
+      int id = string_ids.size();
+      string_ids[text] = id;
+      Put_Number(strings, text.length());
+      strings += text;
+      return id;
+    };
+    int record_count = records.size();
+    for (int record_index = 0; record_index < record_count; record_index++) {
+      tObject& record = records[record_index];
+      std::string shape;
+      std::string values;
+      int key_count = record.Count();
+      Put_Number(shape, key_count);
+      for (int key_index = 0; key_index < key_count; key_index++) {
+        std::string& key = record.keys[key_index];
+        cValue& value = record.values[key_index];
+        std::string packed;
+        Put_Number(shape, Intern(key));
+        if ((value.type == eVALUE_NUMBER) && ((key == "x") || (key == "y"))) {
+          int axis = (key == "y") ? 1 : 0;
+          Put_Number(shape, eSLOT_X + axis);
+          Put_Signed(values, value.number - last[axis]);
+          last[axis] = value.number;
         }
-        else if (cell == '[') {
-          entity["x"] = cell_x;
-          entity["y"] = cell_y;
-          entity["width"] = 1;
-          entity["height"] = 1;
-          entity["type"] = "field";
-          this->Parse_Field(entity);
-          // Break out of double loop.
-          cell_y = this->height;
-          break;
+        else if (value.type == eVALUE_NUMBER) {
+          Put_Number(shape, eSLOT_NUMBER);
+          Put_Signed(shape, value.number);
         }
-        else if (cell == '{') {
-          entity["x"] = cell_x;
-          entity["y"] = cell_y;
-          entity["width"] = 1;
-          entity["height"] = 1;
-          entity["type"] = "panel";
-          this->Parse_Panel(entity);
-          // Break out of double loop.
-          cell_y = this->height;
-          break;
+        else if ((key == "uid") && Pack_Uid(value.string, packed)) {
+          Put_Number(shape, eSLOT_UID);
+          values += packed;
         }
-        else if (cell == '(') {
-          entity["x"] = cell_x;
-          entity["y"] = cell_y;
-          entity["width"] = 1;
-          entity["height"] = 1;
-          entity["type"] = "button";
-          this->Parse_Button(entity);
-          // Break out of double loop.
-          cell_y = this->height;
-          break;
+        else {
+          Put_Number(shape, eSLOT_STRING);
+          Put_Number(shape, Intern(value.string));
+        }
+      }
+      std::unordered_map<std::string, int>::iterator found = shape_ids.find(shape);
+      int shape_id = 0;
+      if (found == shape_ids.end()) {
+        shape_id = shape_ids.size();
+        shape_ids[shape] = shape_id;
+        shapes += shape;
+      }
+      else {
+        shape_id = found->second;
+      }
+      Put_Number(instances, shape_id);
+      instances += values;
+    }
+    std::string data;
+    Put_Number(data, string_ids.size());
+    data += strings;
+    Put_Number(data, shape_ids.size());
+    data += shapes;
+    Put_Number(data, record_count);
+    data += instances;
+    return data;
+  }
+
+  /**
+   * Decodes records from the compact format.
+   * @param data The encoded map.
+   * @param pos Where the strings start.
+   * @param records Receives the records.
+   * @throws An error if the data is not valid.
+   */
+  void cMap_Codec::Decode(const std::string& data, size_t pos, std::vector<tObject>& records) {
+    std::vector<std::string> strings(Get_Count(data, pos, 1, "strings"));
+    int string_count = strings.size();
+    for (int string_index = 0; string_index < string_count; string_index++) {
+      unsigned long long length = Get_Number(data, pos);
+      Check_Condition((length <= data.length() - pos), "Map string is cut off.");
+      strings[string_index] = data.substr(pos, length);
+      pos += length;
+    }
+    std::vector<std::vector<sMap_Slot>> shapes(Get_Count(data, pos, 1, "dictionary entries"));
+    int shape_count = shapes.size();
+    for (int shape_index = 0; shape_index < shape_count; shape_index++) {
+      int slot_count = Get_Count(data, pos, 2, "dictionary slots");
+      shapes[shape_index].reserve(slot_count);
+      for (int slot_index = 0; slot_index < slot_count; slot_index++) {
+        unsigned long long key = Get_Number(data, pos); // Checked before narrowing so large ids can not wrap.
+        unsigned long long type = Get_Number(data, pos);
+        Check_Condition((key < strings.size()) && (type <= eSLOT_UID), "Map dictionary entry is not valid.");
+        sMap_Slot slot = { (int)key, (eMap_Slot)type, 0 };
+        if (slot.type == eSLOT_NUMBER) {
+          slot.value = Get_Signed(data, pos);
+        }
+        else if (slot.type == eSLOT_STRING) {
+          unsigned long long string_id = Get_Number(data, pos);
+          Check_Condition((string_id < strings.size()), "Map dictionary string is not valid.");
+          slot.value = string_id;
+        }
+        shapes[shape_index].push_back(slot);
+      }
+    }
+    long long last[2] = { 0, 0 };
+    int record_count = Get_Count(data, pos, 1, "records");
+    Check_Condition((record_count > 0), "No meta data in map.");
+    records.reserve(records.size() + record_count);
+    for (int record_index = 0; record_index < record_count; record_index++) {
+      unsigned long long shape_id = Get_Number(data, pos);
+      Check_Condition((shape_id < shapes.size()), "Map record is not valid.");
+      std::vector<sMap_Slot>& shape = shapes[shape_id];
+      records.push_back(tObject());
+      tObject& record = records.back();
+      int slot_count = shape.size();
+      for (int slot_index = 0; slot_index < slot_count; slot_index++) {
+        sMap_Slot& slot = shape[slot_index];
+        cValue& value = record[strings[slot.key]];
+        switch (slot.type) {
+          case eSLOT_NUMBER:
+            value.Set_Number(slot.value);
+            break;
+          case eSLOT_STRING:
+            value.Set_String(strings[slot.value]);
+            break;
+          case eSLOT_X:
+          case eSLOT_Y:
+            last[slot.type - eSLOT_X] += Get_Signed(data, pos);
+            value.Set_Number(last[slot.type - eSLOT_X]);
+            break;
+          case eSLOT_UID:
+            value.Set_String(Unpack_Uid(data, pos));
+            break;
+        }
+      }
+    }
+  }
+
+  /**
+   * Compresses data in independent blocks with a small LZ coder. Each
+   * sequence is a literal run followed by a back reference into the block.
+   * @param data The data to compress.
+   * @return The blocks followed by an empty block.
+   */
+  std::string cMap_Codec::Compress(const std::string& data) {
+    std::string output;
+    std::vector<int> table(1 << MAP_HASH_BITS);
+    size_t data_size = data.length();
+    for (size_t block_start = 0; block_start < data_size; block_start += MAP_BLOCK_SIZE) {
+      size_t block_size = std::min(data_size - block_start, (size_t)MAP_BLOCK_SIZE);
+      const unsigned char* block = (const unsigned char*)data.data() + block_start;
+      std::string packed;
+      std::fill(table.begin(), table.end(), -1);
+      size_t literal_start = 0;
+      size_t pos = 0;
+      while (pos + 4 <= block_size) {
+        unsigned int sequence = 0;
+        std::memcpy(&sequence, block + pos, 4);
+        unsigned int hash = (sequence * 2654435761u) >> (32 - MAP_HASH_BITS);
+        int candidate = table[hash];
+        table[hash] = pos;
+        if ((candidate >= 0) && (std::memcmp(block + candidate, block + pos, 4) == 0)) {
+          size_t length = 4;
+          while ((pos + length < block_size) && (block[candidate + length] == block[pos + length])) {
+            length++;
+          }
+          Put_Number(packed, pos - literal_start);
+          packed.append((const char*)block + literal_start, pos - literal_start);
+          Put_Number(packed, pos - candidate);
+          Put_Number(packed, length - 4);
+          pos += length;
+          literal_start = pos;
         }
         else {
-          continue; // Ignore but allow looking for other entities.
+          pos++;
         }
       }
+      Put_Number(packed, block_size - literal_start); // Closing literal run, possibly empty.
+      packed.append((const char*)block + literal_start, block_size - literal_start);
+      Put_Number(output, block_size);
+      if (packed.length() < block_size) {
+        Put_Number(output, packed.length());
+        output += packed;
+      }
+      else { // Stored as is.
+        Put_Number(output, block_size);
+        output.append((const char*)block, block_size);
+      }
     }
-    // Add to components.
-    this->components[entity["id"].string] = entity;
+    Put_Number(output, 0);
+    return output;
   }
 
   /**
-   * Parses a box structure.
-   * @param entity The associated entity.
-   * @throws An error if the box is invalid.
+   * Decompresses blocks written by Compress.
+   * @param data The compressed data.
+   * @param pos Where the first block starts.
+   * @return The original data.
+   * @throws An error if the data is not valid.
    */
-  void cLayout::Parse_Box(tObject& entity) {
-    // We'll navigate in this path: right -> down -> left -> up
-    int pos_x = entity["x"].number; // Skip the plus.
-    int pos_y = entity["y"].number;
-    int rev_width = 1;
-    int rev_height = 1;
-    std::string id_str = "";
-    // Clear out first plus.
-    this->grid[pos_y][pos_x] = ' ';
-    // Navigate right.
-    pos_x++;
-    while (pos_x < this->width) {
-      char cell = this->grid[pos_y][pos_x];
-      if (cell == '+') {
-        entity["width"].number++;
-        entity["id"].string = id_str;
-        this->grid[pos_y][pos_x] = ' ';
+  std::string cMap_Codec::Decompress(const std::string& data, size_t pos) {
+    std::string output;
+    while (true) {
+      size_t raw_size = Get_Number(data, pos);
+      if (raw_size == 0) {
         break;
       }
-      else if (this->Is_Identifier(cell)) { // Box Edge
-        if (this->Is_Identifier(cell)) {
-          id_str += cell; // Collect ID letter.
+      size_t packed_size = Get_Number(data, pos);
+      Check_Condition((raw_size <= (size_t)MAP_BLOCK_SIZE) && (packed_size <= raw_size) && (packed_size <= data.length() - pos), "Map block is not valid.");
+      size_t block_start = output.length();
+      if (packed_size == raw_size) {
+        output.append(data, pos, raw_size);
+        pos += raw_size;
+        continue;
+      }
+      size_t block_end = pos + packed_size;
+      while (true) {
+        size_t literal_count = Get_Number(data, pos);
+        Check_Condition((literal_count <= block_end - pos) && (output.length() - block_start + literal_count <= raw_size), "Map literal run is not valid.");
+        output.append(data, pos, literal_count);
+        pos += literal_count;
+        size_t block_length = output.length() - block_start;
+        if (block_length == raw_size) {
+          break;
         }
-        entity["width"].number++;
-        this->grid[pos_y][pos_x] = ' ';
+        size_t offset = Get_Number(data, pos);
+        size_t length = Get_Number(data, pos) + 4;
+        Check_Condition((offset > 0) && (offset <= block_length) && (length <= raw_size - block_length), "Map back reference is not valid.");
+        size_t from = output.length() - offset;
+        for (size_t byte_index = 0; byte_index < length; byte_index++) { // Runs may overlap themselves.
+          output += output[from + byte_index];
+        }
+      }
+      Check_Condition((pos == block_end), "Map block has trailing data.");
+    }
+    return output;
+  }
+
+  /**
+   * Appends a number in seven bit groups, low group first.
+   * @param data The data to append to.
+   * @param number The number.
+   */
+  void cMap_Codec::Put_Number(std::string& data, unsigned long long number) {
+    while (number >= 0x80) {
+      data += (char)((number & 0x7F) | 0x80);
+      number >>= 7;
+    }
+    data += (char)number;
+  }
+
+  /**
+   * Appends a signed number so that small negative numbers stay short.
+   * @param data The data to append to.
+   * @param number The number.
+   */
+  void cMap_Codec::Put_Signed(std::string& data, long long number) {
+    Put_Number(data, ((unsigned long long)number << 1) ^ (unsigned long long)(number >> 63));
+  }
+
+  /**
+   * Reads a number written by Put_Number.
+   * @param data The data.
+   * @param pos The read position. It is moved past the number.
+   * @return The number.
+   * @throws An error if the number is cut off.
+   */
+  unsigned long long cMap_Codec::Get_Number(const std::string& data, size_t& pos) {
+    unsigned long long number = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+      Check_Condition((pos < data.length()), "Map data is cut off.");
+      unsigned char group = data[pos++];
+      number |= (unsigned long long)(group & 0x7F) << shift;
+      if ((group & 0x80) == 0) {
+        return number;
+      }
+    }
+    throw cError("Map number is too long.");
+  }
+
+  /**
+   * Reads a number written by Put_Signed.
+   * @param data The data.
+   * @param pos The read position. It is moved past the number.
+   * @return The number.
+   * @throws An error if the number is cut off.
+   */
+  long long cMap_Codec::Get_Signed(const std::string& data, size_t& pos) {
+    unsigned long long number = Get_Number(data, pos);
+    return (long long)(number >> 1) ^ -(long long)(number & 1);
+  }
+
+  /**
+   * Reads the count of the items that follow. Every item takes at least a
+   * few bytes, so a count the rest of the data cannot hold is not valid.
+   * @param data The data.
+   * @param pos The read position. It is moved past the count.
+   * @param item_size The fewest bytes an item takes.
+   * @param what What is counted, for the error.
+   * @return The count.
+   * @throws An error if the count is larger than the data allows.
+   */
+  size_t cMap_Codec::Get_Count(const std::string& data, size_t& pos, size_t item_size, std::string what) {
+    unsigned long long count = Get_Number(data, pos);
+    Check_Condition((count <= (data.length() - pos) / item_size), "Map count of " + what + " is larger than the map.");
+    return count;
+  }
+
+  /**
+   * Packs an id made by New_Uid into six bytes.
+   * @param uid The id.
+   * @param packed Receives the bytes.
+   * @return False if the id is not twelve lower case hex digits.
+   */
+  bool cMap_Codec::Pack_Uid(const std::string& uid, std::string& packed) {
+    if (uid.length() != 12) {
+      return false;
+    }
+    packed.assign(6, '\0');
+    for (int digit_index = 0; digit_index < 12; digit_index++) {
+      char digit = uid[digit_index];
+      int nibble = 0;
+      if ((digit >= '0') && (digit <= '9')) {
+        nibble = digit - '0';
+      }
+      else if ((digit >= 'a') && (digit <= 'f')) {
+        nibble = digit - 'a' + 10;
       }
       else {
-        throw cError("Not a valid box. (right)");
+        return false;
       }
-      pos_x++;
+      packed[digit_index / 2] |= (char)(nibble << ((digit_index % 2) ? 0 : 4));
     }
-    // Check for truncated object.
-    if (pos_x == this->width) {
-      throw cError("Truncated box. (width)");
+    return true;
+  }
+
+  /**
+   * Reads an id packed by Pack_Uid.
+   * @param data The data.
+   * @param pos The read position. It is moved past the id.
+   * @return The id as twelve hex digits.
+   * @throws An error if the id is cut off.
+   */
+  std::string cMap_Codec::Unpack_Uid(const std::string& data, size_t& pos) {
+    static const char digits[] = "0123456789abcdef";
+    Check_Condition((data.length() - pos >= 6), "Map id is cut off.");
+    std::string uid(12, '0');
+    for (int byte_index = 0; byte_index < 6; byte_index++) {
+      unsigned char packed = data[pos++];
+      uid[byte_index * 2] = digits[packed >> 4];
+      uid[byte_index * 2 + 1] = digits[packed & 15];
+    }
+    return uid;
+  }
+
+  // **************************************************************************
+  // Map Writer Implementation
+  // **************************************************************************
+
+  /**
+   * Starts writing a text map into a temporary file next to the map. The map
+   * itself is only replaced by Commit, so a failed save leaves it intact.
+   * @param file_name The name of the map file.
+   * @throws An error if the temporary file could not be created.
+   */
+  cMap_Writer::cMap_Writer(std::string file_name) {
+    this->file_name = file_name;
+    this->temp_name = file_name + ".tmp";
+    this->file = std::fopen(this->temp_name.c_str(), "wb");
+    Check_Condition((this->file != NULL), "Could not write map " + file_name + ".");
+    this->buffer.resize(MAP_WRITE_BUFFER);
+    this->used = 0;
+  }
+
+  /**
+   * Removes the temporary file of a save that was not committed.
+   */
+  cMap_Writer::~cMap_Writer() {
+    if (this->file) {
+      std::fclose(this->file);
+      std::remove(this->temp_name.c_str());
+    }
+  }
+
+  /**
+   * Writes bytes through the buffer.
+   * @param data The bytes.
+   * @param length The number of bytes.
+   * @throws An error if the file could not be written.
+   */
+  void cMap_Writer::Write(const char* data, size_t length) {
+    if (this->used + length > this->buffer.size()) {
+      this->Flush();
+    }
+    if (length > this->buffer.size()) { // Too large to buffer.
+      Check_Condition((std::fwrite(data, 1, length, this->file) == length), "Could not write map " + this->file_name + ".");
+      return;
+    }
+    std::memcpy(&this->buffer[this->used], data, length);
+    this->used += length;
+  }
+
+  /**
+   * Writes text through the buffer.
+   * @param text The text.
+   */
+  void cMap_Writer::Write_Text(const std::string& text) {
+    this->Write(text.data(), text.length());
+  }
+
+  /**
+   * Writes a number as decimal text.
+   * @param number The number.
+   */
+  void cMap_Writer::Write_Number(int number) {
+    char digits[16];
+    int length = std::snprintf(digits, sizeof(digits), "%d", number);
+    this->Write(digits, length);
+  }
+
+  /**
+   * Writes a key or text value of a key=value line. A line break would end
+   * the line early and be read back as another property.
+   * @param text The text.
+   * @throws An error if the text holds a line break.
+   */
+  void cMap_Writer::Write_Line_Text(const std::string& text) {
+    Check_Condition((text.find('\n') == std::string::npos), "Map text " + text.substr(0, text.find('\n')) + "... has a line break and can not be saved.");
+    this->Write_Text(text);
+  }
+
+  /**
+   * Writes an object as key=value lines followed by the end marker, the
+   * layout that cFile writes and Read_Object parses.
+   * @param object The object.
+   */
+  void cMap_Writer::Write_Object(tObject& object) {
+    int key_count = object.Count();
+    for (int key_index = 0; key_index < key_count; key_index++) {
+      cValue& value = object.values[key_index];
+      this->Write_Line_Text(object.keys[key_index]);
+      this->Write("=", 1);
+      if (value.type == eVALUE_NUMBER) {
+        this->Write_Number(value.number);
+      }
+      else {
+        this->Write_Line_Text(value.string);
+      }
+      this->Write("\n", 1);
+    }
+    this->Write("end\n", 4);
+  }
+
+  /**
+   * Writes the record of a sprite straight from its overrides, in the same
+   * order as cSprite::Get_Record.
+   * @param sprite The sprite.
+   */
+  void cMap_Writer::Write_Sprite(cSprite& sprite) {
+    bool has_sprite_id = (sprite.proto != NO_VALUE_FOUND);
+    bool wrote_sprite_id = false;
+    for (int prop_index = 0; prop_index < sprite.override_count; prop_index++) {
+      sSprite_Property& property = sprite.overrides[prop_index];
+      this->Write_Text(string_table.Get_String(property.key));
+      this->Write("=", 1);
+      if (has_sprite_id && (property.key == eKEY_SPRITE_ID)) { // The prototype wins, as in Get_Record.
+        this->Write_Text(sprite.catalog->entries[sprite.proto].name);
+        wrote_sprite_id = true;
+      }
+      else if (property.text != NO_VALUE_FOUND) {
+        this->Write_Line_Text(sprite.Get_Text(property));
+      }
+      else {
+        this->Write_Number(property.number);
+      }
+      this->Write("\n", 1);
+    }
+    if (has_sprite_id && !wrote_sprite_id) {
+      this->Write("sprite-id=", 10);
+      this->Write_Text(sprite.catalog->entries[sprite.proto].name);
+      this->Write("\n", 1);
+    }
+    this->Write("end\n", 4);
+  }
+
+  /**
+   * Writes the buffered bytes to the file.
+   * @throws An error if the file could not be written.
+   */
+  void cMap_Writer::Flush() {
+    if (this->used > 0) {
+      Check_Condition((std::fwrite(&this->buffer[0], 1, this->used, this->file) == this->used), "Could not write map " + this->file_name + ".");
+      this->used = 0;
+    }
+  }
+
+  /**
+   * Finishes the temporary file and moves it over the map.
+   * @throws An error if the map could not be replaced.
+   */
+  void cMap_Writer::Commit() {
+    this->Flush();
+    bool closed = (std::fclose(this->file) == 0);
+    this->file = NULL;
+    if (!closed) {
+      std::remove(this->temp_name.c_str());
+      throw cError("Could not write map " + this->file_name + ".");
+    }
+    std::error_code error;
+    std::filesystem::rename(this->temp_name, this->file_name, error); // Replaces the old map in one step.
+    if (error) {
+      std::remove(this->temp_name.c_str());
+      throw cError("Could not replace map " + this->file_name + ".");
+    }
+  }
+
+  // **************************************************************************
+  // Map Diff Implementation
+  // **************************************************************************
+
+  /**
+   * Reads the records of a map file.
+   * @param name The name of the map without the extension.
+   * @param records Receives the meta data record followed by the other records.
+   * @throws An error if the map could not be read.
+   */
+  void cMap_Diff::Read_Map(std::string name, std::vector<sMap_Record>& records) {
+    std::vector<tObject> map_records;
+    cMap_Codec::Read_Map(name + ".map", map_records);
+    std::map<std::string, int> layer_counts;
+    sMap_Record meta = { "meta", map_records[0] };
+    records.push_back(meta);
+    int record_count = map_records.size();
+    for (int record_index = 1; record_index < record_count; record_index++) {
+      sMap_Record record = { "", map_records[record_index] };
+      record.uid = Get_Uid(record.record, layer_counts);
+      records.push_back(record);
+    }
+  }
+
+  /**
+   * Writes records to a map file.
+   * @param name The name of the map without the extension.
+   * @param records The meta data record followed by the other records.
+   * @throws An error if the map could not be written.
+   */
+  void cMap_Diff::Write_Map(std::string name, std::vector<sMap_Record>& records) {
+    cMap_Writer writer(name + ".map");
+    int record_count = records.size();
+    for (int record_index = 0; record_index < record_count; record_index++) {
+      writer.Write_Object(records[record_index].record);
+    }
+    writer.Commit();
+  }
+
+  /**
+   * Gets the stable id of a record. Tile layers are matched by layer and
+   * sprites saved before ids existed by their place in the layer.
+   * @param record The record.
+   * @param layer_counts Counts sprites without ids in each layer.
+   * @return The id.
+   */
+  std::string cMap_Diff::Get_Uid(tObject& record, std::map<std::string, int>& layer_counts) {
+    std::string layer = record.Does_Key_Exist("layer") ? record["layer"].string : "";
+    if (record.Does_Key_Exist("tiles")) {
+      return "tiles:" + layer;
+    }
+    if (record.Does_Key_Exist("uid")) {
+      return record["uid"].string;
+    }
+    return "#" + layer + ":" + Number_To_Text(layer_counts[layer]++);
+  }
+
+  /**
+   * Sorts the ids of records for lookups.
+   * @param records The records.
+   * @param index Receives the ids with the record positions, sorted by id.
+   */
+  void cMap_Diff::Index(std::vector<sMap_Record>& records, tUid_Index& index) {
+    int record_count = records.size();
+    index.clear();
+    index.reserve(record_count);
+    for (int record_index = 0; record_index < record_count; record_index++) {
+      index.push_back(std::make_pair(records[record_index].uid, record_index));
+    }
+    std::sort(index.begin(), index.end());
+  }
+
+  /**
+   * Finds a record by id.
+   * @param index The sorted index.
+   * @param uid The id.
+   * @return The position of the record or NO_VALUE_FOUND.
+   */
+  int cMap_Diff::Find(tUid_Index& index, std::string& uid) {
+    tUid_Index::iterator entry = std::lower_bound(index.begin(), index.end(), std::make_pair(uid, std::numeric_limits<int>::min()));
+    return ((entry != index.end()) && (entry->first == uid)) ? entry->second : NO_VALUE_FOUND;
+  }
+
+  /**
+   * Compares a property of two records. A missing property only matches a
+   * missing property.
+   * @param a The first record.
+   * @param b The second record.
+   * @param key The name of the property.
+   * @return True if the property is the same.
+   */
+  bool cMap_Diff::Is_Same_Property(tObject& a, tObject& b, std::string& key) {
+    bool in_a = a.Does_Key_Exist(key);
+    bool in_b = b.Does_Key_Exist(key);
+    return (in_a == in_b) && (!in_a || Is_Same_Value(a[key], b[key]));
+  }
+
+  /**
+   * Compares every property of two records.
+   * @param a The first record.
+   * @param b The second record.
+   * @return True if the records are the same.
+   */
+  bool cMap_Diff::Is_Same_Record(tObject& a, tObject& b) {
+    bool same = (a.Count() == b.Count());
+    int prop_count = a.Count();
+    for (int prop_index = 0; same && (prop_index < prop_count); prop_index++) {
+      same = Is_Same_Property(a, b, a.keys[prop_index]);
     }
-    // Navigate down.
-    pos_y++; // Skip the first plus.
-    while (pos_y < this->height) {
-      char cell = this->grid[pos_y][pos_x];
-      if (cell == '+') {
-        entity["height"].number++;
-        this->grid[pos_y][pos_x] = ' ';
-        break;
-      }
-      else if (cell == '|') {
-        entity["height"].number++;
-        this->grid[pos_y][pos_x] = ' ';
-      }
-      else {
-        throw cError("Not a valid box. (down)");
+    return same;
+  }
+
+  /**
+   * Lists the property changes between two versions of a record.
+   * @param uid The id of the record.
+   * @param a The old record.
+   * @param b The new record.
+   * @param changes Receives the changes.
+   */
+  void cMap_Diff::Diff_Record(std::string& uid, tObject& a, tObject& b, std::vector<sProperty_Change>& changes) {
+    int a_count = a.Count();
+    for (int prop_index = 0; prop_index < a_count; prop_index++) {
+      std::string& key = a.keys[prop_index];
+      if (!Is_Same_Property(a, b, key)) {
+        bool has_new = b.Does_Key_Exist(key);
+        sProperty_Change change = { eCHANGE_CHANGED, uid, key, true, has_new, a.values[prop_index], has_new ? b[key] : cValue() };
+        changes.push_back(change);
       }
-      pos_y++;
     }
-    // Check for truncated object.
-    if (pos_y == this->height) {
-      throw cError("Truncated box. (height)");
-    }
-    // Navigate left.
-    pos_x--; // Skip that first plus.
-    while (pos_x >= 0) {
-      char cell = this->grid[pos_y][pos_x];
-      if (cell == '+') {
-        rev_width++;
-        this->grid[pos_y][pos_x] = ' ';
-        break;
+    int b_count = b.Count();
+    for (int prop_index = 0; prop_index < b_count; prop_index++) {
+      if (!a.Does_Key_Exist(b.keys[prop_index])) {
+        sProperty_Change change = { eCHANGE_CHANGED, uid, b.keys[prop_index], false, true, cValue(), b.values[prop_index] };
+        changes.push_back(change);
       }
-      else if (cell == '-') {
-        rev_width++;
-        this->grid[pos_y][pos_x] = ' ';
+    }
+  }
+
+  /**
+   * Lists the changes from one version of a map to another. Records are
+   * matched through sorted ids, so the diff is O(n log n).
+   * @param a The old records.
+   * @param b The new records.
+   * @param changes Receives removed records, changed properties and added records.
+   */
+  void cMap_Diff::Diff(std::vector<sMap_Record>& a, std::vector<sMap_Record>& b, std::vector<sProperty_Change>& changes) {
+    tUid_Index a_index;
+    tUid_Index b_index;
+    Index(a, a_index);
+    Index(b, b_index);
+    int a_count = a.size();
+    for (int record_index = 0; record_index < a_count; record_index++) {
+      sMap_Record& record = a[record_index];
+      int match = Find(b_index, record.uid);
+      if (match == NO_VALUE_FOUND) {
+        sProperty_Change change = { eCHANGE_REMOVED, record.uid, "", false, false, cValue(), cValue() };
+        changes.push_back(change);
       }
       else {
-        throw cError("Not a valid box. (left)");
+        Diff_Record(record.uid, record.record, b[match].record, changes);
       }
-      pos_x--;
-    }
-    if (rev_width != entity["width"].number) {
-      throw cError("Not a valid box. (width mismatch)");
     }
-    // Navigate up.
-    pos_y--;
-    while (pos_y >= 0) {
-      char cell = this->grid[pos_y][pos_x];
-      if (cell == ' ') { // Plus was removed but validated before.
-        rev_height++;
-        this->grid[pos_y][pos_x] = ' ';
-        break;
-      }
-      else if (cell == '|') {
-        rev_height++;
-        this->grid[pos_y][pos_x] = ' ';
-      }
-      else {
-        throw cError("Not a valid box. (up)");
+    int b_count = b.size();
+    for (int record_index = 0; record_index < b_count; record_index++) {
+      if (Find(a_index, b[record_index].uid) == NO_VALUE_FOUND) {
+        sProperty_Change change = { eCHANGE_ADDED, b[record_index].uid, "", false, false, cValue(), cValue() };
+        changes.push_back(change);
       }
-      pos_y--;
     }
-    if (rev_height != entity["height"].number) {
-      throw cError("Not a valid box. (height mismatch)");
+  }
+
+  /**
+   * Merges one record changed in both copies, property by property. When
+   * both copies changed a property differently ours is kept.
+   * @param base The record both copies started from.
+   * @param ours Our version.
+   * @param theirs Their version.
+   * @param merged Receives the merged record.
+   * @param conflicts Receives the conflicting properties.
+   */
+  void cMap_Diff::Merge_Record(sMap_Record& base, sMap_Record& ours, sMap_Record& theirs, sMap_Record& merged, std::vector<sProperty_Change>& conflicts) {
+    merged.uid = ours.uid;
+    merged.record = ours.record;
+    tObject* versions[2] = { &ours.record, &theirs.record };
+    for (int version_index = 0; version_index < 2; version_index++) {
+      tObject& version = *versions[version_index];
+      int prop_count = version.Count();
+      for (int prop_index = 0; prop_index < prop_count; prop_index++) {
+        std::string& key = version.keys[prop_index];
+        if (Is_Same_Property(ours.record, base.record, key) && !Is_Same_Property(theirs.record, base.record, key)) { // Only they changed it.
+          if (theirs.record.Does_Key_Exist(key)) {
+            merged.record[key] = theirs.record[key];
+          }
+          else {
+            merged.record.Remove(key);
+          }
+        }
+        else if (((version_index == 0) || !ours.record.Does_Key_Exist(key)) && !Is_Same_Property(theirs.record, base.record, key) && !Is_Same_Property(ours.record, theirs.record, key)) {
+          Add_Conflict(ours.uid, key, &ours.record, &theirs.record, conflicts);
+        }
+      }
     }
   }
 
   /**
-   * Parses a field entity.
-   * @param entity The associated entity.
-   * @throws An error if the field is invalid.
+   * Merges two copies of a map made from the same base. Records keep our
+   * order, followed by the records only they added in their order.
+   * @param base The records both copies started from.
+   * @param ours Our records.
+   * @param theirs Their records.
+   * @param merged Receives the merged records.
+   * @param conflicts Receives the records and properties changed differently in both.
    */
-  void cLayout::Parse_Field(tObject& entity) {
-    int pos_x = entity["x"].number;
-    int pos_y = entity["y"].number;
-    std::string id_str = "";
-    // Clear out initial bracket.
-    this->grid[pos_y][pos_x] = ' ';
-    // Parse out field.
-    pos_x++; // Pass over initial bracket.
-    while (pos_x < this->width) {
-      char cell = this->grid[pos_y][pos_x];
-      if (cell == ']') {
-        entity["width"].number++;
-        entity["id"].string = id_str;
-        this->grid[pos_y][pos_x] = ' ';
-        break;
+  void cMap_Diff::Merge(std::vector<sMap_Record>& base, std::vector<sMap_Record>& ours, std::vector<sMap_Record>& theirs, std::vector<sMap_Record>& merged, std::vector<sProperty_Change>& conflicts) {
+    tUid_Index base_index;
+    tUid_Index our_index;
+    tUid_Index their_index;
+    Index(base, base_index);
+    Index(ours, our_index);
+    Index(theirs, their_index);
+    int our_count = ours.size();
+    for (int record_index = 0; record_index < our_count; record_index++) {
+      sMap_Record& our_record = ours[record_index];
+      int base_match = Find(base_index, our_record.uid);
+      int their_match = Find(their_index, our_record.uid);
+      if ((base_match != NO_VALUE_FOUND) && (their_match != NO_VALUE_FOUND)) {
+        sMap_Record record;
+        Merge_Record(base[base_match], our_record, theirs[their_match], record, conflicts);
+        merged.push_back(record);
       }
-      else if (this->Is_Identifier(cell) || (cell == ' ')) {
-        if (this->Is_Identifier(cell)) {
-          id_str += cell;
+      else if (base_match != NO_VALUE_FOUND) { // They deleted it.
+        if (!Is_Same_Record(our_record.record, base[base_match].record)) {
+          Add_Conflict(our_record.uid, "", &our_record.record, NULL, conflicts);
+          merged.push_back(our_record);
         }
-        entity["width"].number++;
-        this->grid[pos_y][pos_x] = ' ';
+      }
+      else if (their_match != NO_VALUE_FOUND) { // Both added the same id.
+        if (!Is_Same_Record(our_record.record, theirs[their_match].record)) {
+          Add_Conflict(our_record.uid, "", &our_record.record, &theirs[their_match].record, conflicts);
+        }
+        merged.push_back(our_record);
       }
       else {
-        throw cError("Not a valid field.");
+        merged.push_back(our_record);
       }
-      pos_x++;
     }
-    // Check for truncated object.
-    if (pos_x == this->width) {
-      throw cError("Truncated field.");
+    int their_count = theirs.size();
+    for (int record_index = 0; record_index < their_count; record_index++) {
+      sMap_Record& their_record = theirs[record_index];
+      if (Find(our_index, their_record.uid) == NO_VALUE_FOUND) {
+        int base_match = Find(base_index, their_record.uid);
+        if (base_match == NO_VALUE_FOUND) { // They added it.
+          merged.push_back(their_record);
+        }
+        else if (!Is_Same_Record(their_record.record, base[base_match].record)) { // We deleted what they changed.
+          Add_Conflict(their_record.uid, "", NULL, &their_record.record, conflicts);
+          merged.push_back(their_record);
+        }
+      }
     }
   }
 
   /**
-   * Parses a panel entity.
-   * @param entity The associated entity.
-   * @throws An error if the panel is invalid.
+   * Records a conflict.
+   * @param uid The id of the record.
+   * @param key The property or an empty string for the whole record.
+   * @param ours Our record or NULL if we deleted it.
+   * @param theirs Their record or NULL if they deleted it.
+   * @param conflicts Receives the conflict.
    */
-  void cLayout::Parse_Panel(tObject& entity) {
-    int pos_x = entity["x"].number;
-    int pos_y = entity["y"].number;
-    std::string id_str = "";
-    // Clear out initial curly.
-    this->grid[pos_y][pos_x] = ' ';
-    // Skip over initial curly.
-    pos_x++;
-    // Go ahead and parse the rest.
-    while (pos_x < this->width) {
-      char cell = this->grid[pos_y][pos_x];
-      if (cell == '}') {
-        entity["width"].number++;
-        entity["id"].string = id_str;
-        this->grid[pos_y][pos_x] = ' ';
-        break;
+  void cMap_Diff::Add_Conflict(std::string& uid, std::string key, tObject* ours, tObject* theirs, std::vector<sProperty_Change>& conflicts) {
+    bool has_old = ours && ((key == "") || ours->Does_Key_Exist(key));
+    bool has_new = theirs && ((key == "") || theirs->Does_Key_Exist(key));
+    sProperty_Change conflict = { eCHANGE_CONFLICT, uid, key, has_old, has_new, (has_old && (key != "")) ? (*ours)[key] : cValue(), (has_new && (key != "")) ? (*theirs)[key] : cValue() };
+    conflicts.push_back(conflict);
+  }
+
+  /**
+   * Writes changes as one JSON object per line.
+   * @param changes The changes.
+   * @param output The output stream.
+   */
+  void cMap_Diff::Write_Changes(std::vector<sProperty_Change>& changes, std::ostream& output) {
+    const char* types[] = { "added", "removed", "changed", "conflict" };
+    int change_count = changes.size();
+    for (int change_index = 0; change_index < change_count; change_index++) {
+      sProperty_Change& change = changes[change_index];
+      output << "{\"change\":\"" << types[change.type] << "\",\"uid\":\"" << cMap_Checker::Escape_Json(change.uid) << "\"";
+      if (change.key != "") {
+        output << ",\"key\":\"" << cMap_Checker::Escape_Json(change.key) << "\"";
       }
-      else if (this->Is_Identifier(cell) || (cell == ' ')) {
-        if (this->Is_Identifier(cell)) {
-          id_str += cell;
+      cValue* values[2] = { change.has_old ? &change.old_value : NULL, change.has_new ? &change.new_value : NULL };
+      const char* names[2] = { "old", "new" };
+      for (int value_index = 0; (value_index < 2) && (change.key != ""); value_index++) {
+        if (values[value_index]) {
+          output << ",\"" << names[value_index] << "\":";
+          if (values[value_index]->type == eVALUE_NUMBER) {
+            output << values[value_index]->number;
+          }
+          else {
+            output << "\"" << cMap_Checker::Escape_Json(values[value_index]->string) << "\"";
+          }
         }
-        entity["width"].number++;
-        this->grid[pos_y][pos_x] = ' ';
       }
-      else {
-        throw cError("Not a valid panel.");
+      output << "}\n";
+    }
+  }
+
+  // **************************************************************************
+  // Map Checker Implementation
+  // **************************************************************************
+
+  /**
+   * Creates a headless map checker.
+   * @param layout The name of the layout holding the map editor.
+   * @param config The name of the layout config.
+   * @param resource_folder The folder holding the images.
+   * @throws An error if the layout could not be loaded.
+   */
+  cMap_Checker::cMap_Checker(std::string layout, std::string config, std::string resource_folder) {
+    this->resource_folder = resource_folder;
+    this->tile_folder = (std::filesystem::path(resource_folder).parent_path() / TILE_FOLDER).string(); // Beside the resource folder, as the editor slices them.
+    this->find_overlaps = false;
+    this->map_width = 0;
+    this->map_height = 0;
+    // The layout is only parsed, never rendered.
+    cLayout editor_layout(layout, config, NULL);
+    int comp_count = editor_layout.components.Count();
+    for (int comp_index = 0; comp_index < comp_count; comp_index++) {
+      tObject& entity = editor_layout.components.values[comp_index];
+      if (entity.Does_Key_Exist("type") && (entity["type"].string == "map-editor")) {
+        this->map_width = entity["width"].number * editor_layout.cell_w;
+        this->map_height = entity["height"].number * editor_layout.cell_h;
       }
-      pos_x++;
     }
-    // Check for truncated object.
-    if (pos_x == this->width) {
-      throw cError("Truncated panel.");
+    // Folder listing without an I/O control.
+    Check_Condition(std::filesystem::is_directory(resource_folder), "Resource folder " + resource_folder + " is missing.");
+    for (std::filesystem::directory_iterator file(resource_folder); file != std::filesystem::directory_iterator(); ++file) {
+      if (cResource_Loader::Is_Image_Type(cResource_Loader::Get_File_Type(file->path().filename().string()))) { // Named like the loader names them.
+        this->images[file->path().stem().string()] = file->path().string();
+      }
     }
   }
 
   /**
-   * Parses a button entity.
-   * @param entity The associated entity.
-   * @throws An error if the button is invalid.
+   * Loads every catalog entry and checks the icons.
+   * @param name The name of the catalog.
+   * @return The result of the catalog checks.
+   * @throws An error if the catalog could not be read.
    */
-  void cLayout::Parse_Button(tObject& entity) {
-    int pos_x = entity["x"].number;
-    int pos_y = entity["y"].number;
-    std::string id_str = "";
-    this->grid[pos_y][pos_x] = ' ';
-    pos_x++;
-    while (pos_x < this->width) {
-      char cell = this->grid[pos_y][pos_x];
-      if (cell == ')') {
-        entity["width"].number++;
-        entity["id"].string = id_str;
-        this->grid[pos_y][pos_x] = ' ';
-        break;
+  sCheck_Result cMap_Checker::Load_Catalog(std::string name) {
+    sCheck_Result result = { name + ".txt", 0, false, std::vector<sMap_Issue>() };
+    cCatalog_Index index;
+    index.Load(name);
+    int entry_count = index.entries.size();
+    for (int entry_index = 0; entry_index < entry_count; entry_index++) {
+      sCatalog_Entry& entry = index.entries[entry_index];
+      tObject& sprite = this->catalog[entry.name];
+      index.Read_Entry(entry_index, sprite);
+      cMap_Editor::Destar_Sprite(sprite);
+      if (this->images.find(entry.icon) == this->images.end()) {
+        sMap_Issue issue = { entry_index, "Icon " + entry.icon + " of sprite " + entry.name + " is not in " + this->resource_folder + "." };
+        result.issues.push_back(issue);
       }
-      else if (this->Is_Identifier(cell) || (cell == ' ')) {
-        if (this->Is_Identifier(cell)) {
-          id_str += cell;
+      this->icon_sprites[entry.icon].push_back(entry.name); // Icons shared by sprites can not be converted.
+    }
+    result.sprite_count = entry_count;
+    return result;
+  }
+
+  /**
+   * Checks a map the way the editor loads and renders it, collecting every
+   * problem instead of stopping at the first.
+   * @param file The path of the map file.
+   * @return The result of the checks.
+   * @throws An error if the map could not be read.
+   */
+  sCheck_Result cMap_Checker::Check_Map(std::string file) {
+    sCheck_Result result = { file, 0, false, std::vector<sMap_Issue>() };
+    std::vector<tObject> map_records;
+    eMap_Encoding encoding = cMap_Codec::Read_Map(file, map_records); // Any encoding the editor reads.
+    tObject& meta_data = map_records[0];
+    std::vector<std::string> problems;
+    cMap_Editor::Check_Meta_Data(meta_data, problems);
+    this->Add_Issues(NO_VALUE_FOUND, problems, result);
+    if (meta_data.Does_Key_Exist("background") && (meta_data["background"].string != "")) {
+      int bkg_width = 0;
+      int bkg_height = 0;
+      sTiled_Background tiled;
+      if (cTile_Cache::Read_Manifest(this->tile_folder, meta_data["background"].string, tiled)) { // Sliced backgrounds are not in the resource folder.
+        bkg_width = tiled.width;
+        bkg_height = tiled.height;
+      }
+      else if (this->images.find(meta_data["background"].string) == this->images.end()) {
+        sMap_Issue issue = { NO_VALUE_FOUND, "Background " + meta_data["background"].string + " is not in " + this->resource_folder + "." };
+        result.issues.push_back(issue);
+      }
+      else if (!Read_Image_Size(this->images[meta_data["background"].string], bkg_width, bkg_height)) {
+        sMap_Issue issue = { NO_VALUE_FOUND, "The size of background " + meta_data["background"].string + " could not be read." };
+        result.issues.push_back(issue);
+      }
+      else if ((bkg_width != this->map_width) || (bkg_height != this->map_height)) {
+        sMap_Issue issue = { NO_VALUE_FOUND, "The size of the background must match the map size. (" + Number_To_Text(this->map_width) + "x" + Number_To_Text(this->map_height) + ")" };
+        result.issues.push_back(issue);
+      }
+    }
+    std::vector<tObject> records;
+    cOverlap_Finder finder;
+    int map_record_count = map_records.size();
+    for (int map_record_index = 1; map_record_index < map_record_count; map_record_index++) {
+      tObject& record = map_records[map_record_index];
+      int sprite_index = records.size();
+      problems.clear();
+      if (record.Does_Key_Exist("tiles")) { // Tile layers only need their palette in the catalog.
+        cMap_Editor::Check_Tile_Layer(record, [this](const std::string& sprite_id) { return (this->catalog.find(sprite_id) != this->catalog.end()); }, problems);
+        this->Add_Issues(sprite_index, problems, result);
+        records.push_back(record);
+        continue;
+      }
+      tObject sprite = record; // Flattened with the prototype for checking.
+      if (record.Does_Key_Exist("sprite-id")) {
+        std::unordered_map<std::string, tObject>::iterator proto = this->catalog.find(record["sprite-id"].string);
+        cMap_Editor::Check_Sprite_Id(record["sprite-id"].string, (proto != this->catalog.end()), problems);
+        if (proto != this->catalog.end()) {
+          sprite = proto->second;
+          int prop_count = record.Count();
+          for (int prop_index = 0; prop_index < prop_count; prop_index++) {
+            sprite[record.keys[prop_index]] = record.values[prop_index];
+          }
         }
-        entity["width"].number++;
-        this->grid[pos_y][pos_x] = ' ';
+      }
+      else if ((this->convert_folder != "") && record.Does_Key_Exist("icon")) {
+        std::unordered_map<std::string, std::vector<std::string>>::iterator match = this->icon_sprites.find(record["icon"].string);
+        if ((match != this->icon_sprites.end()) && (match->second.size() > 1)) {
+          cArray<std::string> names;
+          for (int name_index = 0; name_index < (int)match->second.size(); name_index++) {
+            names.Add(match->second[name_index]);
+          }
+          problems.push_back("Icon " + record["icon"].string + " is used by sprites " + Join(names, ", ") + ", so the sprite can not be converted.");
+        }
+      }
+      cMap_Editor::Check_Layer(sprite.Does_Key_Exist("layer"), sprite.Does_Key_Exist("layer") ? sprite["layer"].string : "", "sprite", problems);
+      this->Add_Issues(sprite_index, problems, result);
+      if (!sprite.Does_Key_Exist("x")) {
+        sMap_Issue issue = { sprite_index, "Sprite has no X coordinate." };
+        result.issues.push_back(issue);
+      }
+      if (!sprite.Does_Key_Exist("y")) {
+        sMap_Issue issue = { sprite_index, "Sprite has no Y coordinate." };
+        result.issues.push_back(issue);
+      }
+      if (!sprite.Does_Key_Exist("bump-map")) {
+        sMap_Issue issue = { sprite_index, "No bump map present in sprite." };
+        result.issues.push_back(issue);
       }
       else {
-        throw cError("Not a valid button.");
+        try {
+          sRectangle bump_map = cMap_Editor::Parse_Rectangle(sprite["bump-map"].string);
+          if (sprite.Does_Key_Exist("x") && sprite.Does_Key_Exist("y")) {
+            bump_map.left += sprite["x"].number;
+            bump_map.right += sprite["x"].number;
+            bump_map.top += sprite["y"].number;
+            bump_map.bottom += sprite["y"].number;
+            finder.Add(bump_map, 0, sprite_index); // Records are numbered across layers.
+          }
+        }
+        catch (cError error) {
+          sMap_Issue issue = { sprite_index, "Bump map " + sprite["bump-map"].string + " is not a valid rectangle." };
+          result.issues.push_back(issue);
+        }
       }
-      pos_x++;
+      if (!sprite.Does_Key_Exist("icon")) {
+        sMap_Issue issue = { sprite_index, "Icon property missing in sprite." };
+        result.issues.push_back(issue);
+      }
+      else if (this->images.find(sprite["icon"].string) == this->images.end()) {
+        sMap_Issue issue = { sprite_index, "Icon " + sprite["icon"].string + " is not in " + this->resource_folder + "." };
+        result.issues.push_back(issue);
+      }
+      records.push_back(record);
     }
-    // Check for truncated object.
-    if (pos_x == this->width) {
-      throw cError("Truncated button.");
+    result.sprite_count = records.size();
+    if (this->find_overlaps) {
+      finder.Find(result.overlaps, 1); // Files already run in parallel.
     }
+    if ((this->convert_folder != "") && result.issues.empty()) {
+      std::string title = std::filesystem::path(file).stem().string();
+      std::vector<tObject> converted;
+      converted.push_back(meta_data);
+      int record_count = records.size();
+      for (int record_index = 0; record_index < record_count; record_index++) {
+        converted.push_back(this->Convert_Record(records[record_index]));
+      }
+      cMap_Codec::Write_Map(this->convert_folder + "/" + title + ".map", converted, encoding); // Kept in the encoding it was read in.
+      result.converted = true;
+    }
+    return result;
   }
 
   /**
-   * Parses the properties associated with the layout.
-   * @param file The instance of the layout file.
-   * @throws An error if there is a problem with the layout.
+   * Converts a full sprite record into a catalog reference with overrides.
+   * @param record The record to convert.
+   * @return The converted record. Records that cannot be matched are unchanged.
    */
-  void cLayout::Parse_Properties(cFile& file) {
-    while (file.Has_More_Lines()) {
-      std::string line = file.Get_Line();
-      cArray<std::string> pair = Parse_Sausage_Text(line, "->");
-      if (pair.Count() == 2) { // Property signature.
-        std::string entity_id = pair[0];
-        std::string value = pair[1];
-        if (this->components.Does_Key_Exist(entity_id)) {
-          cArray<std::string> props = Parse_Sausage_Text(value, ",");
-          int prop_count = props.Count();
-          for (int prop_index = 0; prop_index < prop_count; prop_index++) {
-            cArray<std::string> prop = Parse_Sausage_Text(props[prop_index], "=");
-            if (prop.Count() == 2) {
-              std::string name = prop[0];
-              std::string value = prop[1];
-              try {
-                this->components[entity_id][name] = cValue(Text_To_Number(value));
-              }
-              catch (cError number_error) { // A string.
-                this->components[entity_id][name] = cValue(value);
-              }
-            }
-            else {
-              throw cError("Property is missing value.");
-            }
+  tObject cMap_Checker::Convert_Record(tObject& record) {
+    if (record.Does_Key_Exist("sprite-id") || record.Does_Key_Exist("tiles") || !record.Does_Key_Exist("icon")) {
+      return record;
+    }
+    std::unordered_map<std::string, std::vector<std::string>>::iterator match = this->icon_sprites.find(record["icon"].string);
+    if ((match == this->icon_sprites.end()) || (match->second.size() != 1)) { // Ambiguous icons are reported by Check_Map.
+      return record;
+    }
+    std::unordered_map<std::string, tObject>::iterator found = this->catalog.find(match->second[0]); // Shared by the workers, so never inserted into.
+    if (found == this->catalog.end()) {
+      return record;
+    }
+    tObject& proto = found->second;
+    tObject converted;
+    converted["sprite-id"].Set_String(match->second[0]);
+    int prop_count = record.Count();
+    for (int prop_index = 0; prop_index < prop_count; prop_index++) {
+      std::string& key = record.keys[prop_index];
+      if (!proto.Does_Key_Exist(key) || !Is_Same_Value(proto[key], record.values[prop_index])) {
+        converted[key] = record.values[prop_index];
+      }
+    }
+    return converted;
+  }
+
+  /**
+   * Checks files on a pool of workers and writes one result line per file in
+   * the order the files were given.
+   * @param files The map files to check.
+   * @param worker_count The number of worker threads.
+   * @param output The stream to write the results to.
+   */
+  void cMap_Checker::Run(cArray<std::string>& files, int worker_count, std::ostream& output) {
+    int file_count = files.Count();
+    std::vector<sCheck_Result> results(file_count);
+    {
+      cJob_System& jobs = cJob_System::Shared();
+      tJob_Batch batch = cJob_System::New_Batch();
+      for (int file_index = 0; file_index < file_count; file_index++) {
+        std::string file = files[file_index];
+        sCheck_Result* result = &results[file_index];
+        jobs.Add_Job([this, file, result]() {
+          try {
+            *result = this->Check_Map(file);
           }
-        }
-        else {
-          throw cError("Entity " + entity_id + " is not defined.");
-        }
+          catch (cError error) {
+            result->file = file;
+            result->sprite_count = 0;
+            result->converted = false;
+            sMap_Issue issue = { NO_VALUE_FOUND, error.message };
+            result->issues.push_back(issue);
+          }
+        }, eJOB_NORMAL, batch, tJob_Token());
+      }
+      jobs.Wait(batch);
+    }
+    for (int file_index = 0; file_index < file_count; file_index++) {
+      this->Write_Result(results[file_index], output);
+    }
+  }
+
+  /**
+   * Adds the problems found by the shared record checks as issues.
+   * @param sprite The index of the record or NO_VALUE_FOUND for the meta data.
+   * @param problems The problems.
+   * @param result The result to add to.
+   */
+  void cMap_Checker::Add_Issues(int sprite, std::vector<std::string>& problems, sCheck_Result& result) {
+    int problem_count = problems.size();
+    for (int problem_index = 0; problem_index < problem_count; problem_index++) {
+      sMap_Issue issue = { sprite, problems[problem_index] };
+      result.issues.push_back(issue);
+    }
+  }
+
+  /**
+   * Writes a result as one line of JSON.
+   * @param result The result to write.
+   * @param output The output stream.
+   */
+  void cMap_Checker::Write_Result(sCheck_Result& result, std::ostream& output) {
+    output << "{\"file\":\"" << Escape_Json(result.file) << "\",\"sprites\":" << result.sprite_count;
+    output << ",\"ok\":" << (result.issues.empty() ? "true" : "false") << ",\"converted\":" << (result.converted ? "true" : "false") << ",\"issues\":[";
+    int issue_count = result.issues.size();
+    for (int issue_index = 0; issue_index < issue_count; issue_index++) {
+      sMap_Issue& issue = result.issues[issue_index];
+      output << ((issue_index > 0) ? "," : "") << "{\"sprite\":" << issue.sprite << ",\"message\":\"" << Escape_Json(issue.message) << "\"}";
+    }
+    output << "]";
+    if (this->find_overlaps) {
+      output << ",\"overlaps\":[";
+      int overlap_count = result.overlaps.size();
+      for (int overlap_index = 0; overlap_index < overlap_count; overlap_index++) {
+        output << ((overlap_index > 0) ? "," : "") << "[" << result.overlaps[overlap_index].index_a << "," << result.overlaps[overlap_index].index_b << "]";
+      }
+      output << "]";
+    }
+    output << "}\n";
+  }
+
+  /**
+   * Reads the size of a PNG or BMP from its header without decoding it.
+   * @param path The path of the image file.
+   * @param width The width output.
+   * @param height The height output.
+   * @return True if the size was read, false otherwise.
+   */
+  bool cMap_Checker::Read_Image_Size(std::string path, int& width, int& height) {
+    std::ifstream image(path, std::ios::binary);
+    unsigned char header[26];
+    bool has_size = false;
+    if (image.read((char*)header, sizeof(header))) {
+      if ((header[1] == 'P') && (header[2] == 'N') && (header[3] == 'G')) {
+        width = (header[16] << 24) | (header[17] << 16) | (header[18] << 8) | header[19]; // IHDR chunk.
+        height = (header[20] << 24) | (header[21] << 16) | (header[22] << 8) | header[23];
+        has_size = true;
+      }
+      else if ((header[0] == 'B') && (header[1] == 'M')) {
+        width = header[18] | (header[19] << 8) | (header[20] << 16) | (header[21] << 24); // Info header, little endian.
+        height = std::abs(header[22] | (header[23] << 8) | (header[24] << 16) | (header[25] << 24)); // Negative when stored top down.
+        has_size = true;
+      }
+    }
+    return has_size;
+  }
+
+  /**
+   * Escapes text for a JSON string.
+   * @param text The text to escape.
+   * @return The escaped text.
+   */
+  std::string cMap_Checker::Escape_Json(std::string text) {
+    std::string escaped = "";
+    int length = text.length();
+    for (int char_index = 0; char_index < length; char_index++) {
+      char letter = text[char_index];
+      if ((letter == '"') || (letter == '\\')) {
+        escaped += '\\';
+        escaped += letter;
+      }
+      else if ((unsigned char)letter < ' ') {
+        escaped += ' ';
       }
       else {
-        throw cError("Entity ID is missing properties.");
+        escaped += letter;
       }
     }
+    return escaped;
   }
 
+  // **************************************************************************
+  // Headless I/O Implementation
+  // **************************************************************************
+
   /**
-   * Renders the entities.
+   * Creates an I/O control that draws nothing. Images have the sizes set in
+   * the image size table.
    */
-  void cLayout::Render() {
-    // Render a background color.
-    this->io->Color(this->red, this->green, this->blue);
-    int entity_count = this->components.Count();
-    this->clicked = "";
-    for (int entity_index = 0; entity_index < entity_count; entity_index++) {
-      tObject& entity = this->components.values[entity_index];
-      // Read a mouse signal.
-      sSignal signal = this->io->Read_Signal();
-      if (signal.code == eSIGNAL_MOUSE) {
-        sRectangle bump_map = this->Get_Entity_Dimensions(entity);
-        if (Is_Point_In_Box(signal.coords, bump_map) && ((signal.button == eBUTTON_LEFT) || (signal.button == eBUTTON_RIGHT)) && this->not_clicked) { // Input focus.
-          this->sel_component = this->components.keys[entity_index];
-          this->clicked = this->components.keys[entity_index];
-          // Normalize mouse coordinates to entity space.
-          this->mouse_coords.x = signal.coords.x - entity["x"].number;
-          this->mouse_coords.y = signal.coords.y - entity["y"].number;
-          this->not_clicked = false;
-        }
-        else if (signal.button == eBUTTON_UP) {
-          this->not_clicked = true;
+  cHeadless_IO::cHeadless_IO() {
+    this->draw_count = 0;
+  }
+
+  /**
+   * Fills the image size table from the headers of the images in a folder.
+   * Images are named like the resource loader names them.
+   * @param folder The resource folder. Nothing is read if it is missing.
+   */
+  void cHeadless_IO::Load_Image_Sizes(std::string folder) {
+    if (!std::filesystem::is_directory(folder)) {
+      return;
+    }
+    for (std::filesystem::directory_iterator file(folder); file != std::filesystem::directory_iterator(); ++file) {
+      if (cResource_Loader::Is_Image_Type(cResource_Loader::Get_File_Type(file->path().filename().string()))) {
+        sPoint size = { 0, 0 };
+        if (cMap_Checker::Read_Image_Size(file->path().string(), size.x, size.y)) {
+          this->image_sizes[file->path().stem().string()] = size;
         }
       }
-      this->On_Component_Render(this->components.values[entity_index]);
     }
-    // Render the screen.
-    this->io->Refresh();
   }
 
   /**
-   * Called when the component is initialized.
-   * @param entity The associated entity.
+   * Ignores the background color.
+   * @param red The red component.
+   * @param green The green component.
+   * @param blue The blue component.
    */
-  void cLayout::On_Component_Init(tObject& entity) {
-    // To be implemented in app.
+  void cHeadless_IO::Color(int red, int green, int blue) {
+    // Nothing is drawn.
   }
 
   /**
-   * Called when the component is rendered.
-   * @param entity The associated entity.
+   * Ignores the screen refresh.
    */
-  void cLayout::On_Component_Render(tObject& entity) {
-    // To be implemented in app.
+  void cHeadless_IO::Refresh() {
+    // Nothing is drawn.
   }
 
   /**
-   * Gets the dimensions of an entity.
-   * @param entity The entity.
-   * @return The rectangle with the dimensions.
+   * Reads a signal. There is never any input.
+   * @return An empty signal.
    */
-  sRectangle cLayout::Get_Entity_Dimensions(tObject& entity) {
-    sRectangle dimensions;
-    dimensions.left = entity["x"].number;
-    dimensions.top = entity["y"].number;
-    dimensions.right = dimensions.left + entity["width"].number - 1;
-    dimensions.bottom = dimensions.top + entity["height"].number - 1;
-    return dimensions;
+  sSignal cHeadless_IO::Read_Signal() {
+    sSignal signal;
+    signal.code = eSIGNAL_NONE;
+    signal.button = eBUTTON_NONE;
+    signal.coords.x = 0;
+    signal.coords.y = 0;
+    return signal;
   }
 
   /**
-   * Determines if a letter is part of an identifier.
-   * @param letter The letter to test.
-   * @return True if the letter is an identifier, false if not.
+   * Reads a key. There is never any input.
+   * @return An empty signal.
    */
-  bool cLayout::Is_Identifier(char letter) {
-    return (((letter >= 'a') && (letter <= 'z')) || ((letter >= 'A') && (letter <= 'Z')) || ((letter >= '0') && (letter <= '9')) || (letter == '_'));
+  sSignal cHeadless_IO::Read_Key() {
+    return this->Read_Signal();
   }
 
   /**
-   * Called when layout is initialized.
+   * Counts an image draw.
+   * @param name The name of the image.
+   * @param x The x coordinate.
+   * @param y The y coordinate.
+   * @param width The width of the image.
+   * @param height The height of the image.
+   * @param angle The rotation angle.
+   * @param h_flip Whether the image is flipped horizontally.
+   * @param v_flip Whether the image is flipped vertically.
    */
-  void cLayout::On_Init() {
-    // To be implemented in the app.
+  void cHeadless_IO::Draw_Image(std::string name, int x, int y, int width, int height, int angle, bool h_flip, bool v_flip) {
+    this->draw_count++;
   }
 
-  // **************************************************************************
-  // Map Editor Implementation
-  // **************************************************************************
+  /**
+   * Gets the width of an image from the size table.
+   * @param name The name of the image.
+   * @return The width or zero if the image is unknown.
+   */
+  int cHeadless_IO::Get_Image_Width(std::string name) {
+    std::unordered_map<std::string, sPoint>::iterator size = this->image_sizes.find(name);
+    return (size != this->image_sizes.end()) ? size->second.x : 0;
+  }
 
   /**
-   * Creates a new map editor.
-   * @param name The name of the layout file.
-   * @param config The config file name.
-   * @param io The I/O control.
+   * Gets the height of an image from the size table.
+   * @param name The name of the image.
+   * @return The height or zero if the image is unknown.
    */
-  cMap_Editor::cMap_Editor(std::string name, std::string config, cIO_Control* io) : cLayout(name, config, io) {
-    this->sprite_layers["background"] = tObject_List();
-    this->sprite_layers["platform"] = tObject_List();
-    this->sprite_layers["character"] = tObject_List();
-    this->sprite_layers["foreground"] = tObject_List();
-    this->sprite_layers["overlay"] = tObject_List();
-    this->meta_data["background"].Set_String("");
-    this->meta_data["music"].Set_String("");
-    this->sel_layer = "background";
-    this->sel_sprite = NO_VALUE_FOUND;
-    Check_Condition(this->components.Does_Key_Exist("layer"), "No layer field.");
-    this->components["layer"]["text"].Set_String(this->sel_layer);
+  int cHeadless_IO::Get_Image_Height(std::string name) {
+    std::unordered_map<std::string, sPoint>::iterator size = this->image_sizes.find(name);
+    return (size != this->image_sizes.end()) ? size->second.y : 0;
   }
 
   /**
-   * Called when a component is initialized.
-   * @param entity The entity that is initialized.
+   * Counts a box draw.
+   * @param x The x coordinate.
+   * @param y The y coordinate.
+   * @param width The width of the box.
+   * @param height The height of the box.
+   * @param red The red component.
+   * @param green The green component.
+   * @param blue The blue component.
    */
-  void cMap_Editor::On_Component_Init(tObject& entity) {
-    if (entity["id"].string == "field") {
-      this->Init_Field(entity);
-    }
-    else if (entity["id"].string == "grid-view") {
-      this->Init_Grid_View(entity);
-    }
-    else if (entity["id"].string == "list") {
-      this->Init_List(entity);
-    }
-    else if (entity["id"].string == "toolbar") {
-      this->Init_Toolbar(entity);
-    }
-    else if (entity["id"].string == "map-editor") {
-      this->Init_Map_Editor(entity);
-    }
+  void cHeadless_IO::Box(int x, int y, int width, int height, int red, int green, int blue) {
+    this->draw_count++;
   }
 
   /**
-   * Called when a component needs to be rendered.
-   * @param entity The entity to be rendered.
+   * Counts a text draw.
+   * @param text The text to output.
+   * @param x The x coordinate.
+   * @param y The y coordinate.
+   * @param red The red component.
+   * @param green The green component.
+   * @param blue The blue component.
    */
-  void cMap_Editor::On_Component_Render(tObject& entity) {
-    // Clear out the component. Make background white.
-    this->io->Color(255, 255, 255);
-    if (entity["id"].string == "field") {
-      this->Render_Field(entity);
-    }
-    else if (entity["id"].string == "label") {
-      this->Render_Label(entity);
-    }
-    else if (entity["id"].string == "grid-view") {
-      this->Render_Grid_View(entity);
-    }
-    else if (entity["id"].string == "button") {
-      this->Render_Button(entity);
-    }
-    else if (entity["id"].string == "toolbar") {
-      this->Render_Toolbar(entity);
-    }
-    else if (entity["id"].string == "list") {
-      this->Render_List(entity);
-    }
-    else if (entity["id"].string == "map-editor") {
-      this->Render_Map_Editor(entity);
-    }
-    // Draw the canvas of the component.
-    this->io->Draw_Canvas(entity["x"].number * this->cell_w, entity["y"].number * this->cell_h, entity["width"].number * this->cell_w, entity["height"].number * this->cell_h);
+  void cHeadless_IO::Output_Text(std::string text, int x, int y, int red, int green, int blue) {
+    this->draw_count++;
   }
 
   /**
-   * Called when the map editor is initialized.
+   * Measures text as if every letter were 8 pixels wide.
+   * @param text The text to measure.
+   * @return The width of the text.
    */
-  void cMap_Editor::On_Init() {
-    this->io->Set_Canvas_Target(); // We need to render to canvas for clipping.
+  int cHeadless_IO::Get_Text_Width(std::string text) {
+    return text.length() * 8;
   }
 
   /**
-   * Loads the catalog from a file.
-   * @param name The name of the file to load.
-   * @throws An error if there was something wrong.
+   * Measures text as one 16 pixel line.
+   * @param text The text to measure.
+   * @return The height of the text.
    */
-  void cMap_Editor::Load_Catalog(std::string name) {
-    cFile catalog_file(name + ".txt");
-    catalog_file.Read();
-    while (catalog_file.Has_More_Lines()) {
-      std::string sprite_name = catalog_file.Get_Line();
-      tObject sprite;
-      catalog_file >>= sprite;
-      this->Destar_Sprite(sprite);
-      this->catalog[sprite_name] = sprite;
-    }
-    if (this->catalog.Count() > 0) { // Select the first catalog key.
-      this->sel_sprite_id = this->catalog.keys[0];
-    }
-    else {
-      throw cError("No sprites in catalog!");
-    }
+  int cHeadless_IO::Get_Text_Height(std::string text) {
+    return 16;
   }
 
+  // **************************************************************************
+  // Benchmark Implementation
+  // **************************************************************************
+
   /**
-   * Loads a map from a file.
-   * @param name The name of the file to load.
-   * @throws An error if the map could not be loaded.
+   * Creates a benchmark that writes its generated files to a folder.
+   * @param folder The folder for generated layouts, catalogs and maps.
+   * @param runs The number of timed runs of each operation.
+   * @throws An error if the folder could not be created.
    */
-  void cMap_Editor::Load_Map(std::string name) {
-    cFile map_file(name + ".map");
-    map_file.Read();
-    this->Clear_Map();
-    map_file >>= this->meta_data;
-    Check_Condition(this->meta_data.Does_Key_Exist("background"), "No background property in meta data.");
-    Check_Condition(this->meta_data.Does_Key_Exist("music"), "No music property in meta data.");
-    while (map_file.Has_More_Lines()) {
-      tObject sprite;
-      map_file >>= sprite;
-      Check_Condition(sprite.Does_Key_Exist("layer"), "No layer property in sprite.");
-      Check_Condition(this->sprite_layers.Does_Key_Exist(sprite["layer"].string), "Trying to load sprite to non-existant layer " + sprite["layer"].string + ".");
-      this->sprite_layers[sprite["layer"].string].Add(sprite); // Add sprite to respective layer.
-    }
-    // Set fields.
-    Check_Condition(this->components.Does_Key_Exist("level_name"), "No level name field.");
-    Check_Condition(this->components.Does_Key_Exist("background"), "No background field.");
-    Check_Condition(this->components.Does_Key_Exist("music"), "No music field.");
-    this->components["level_name"]["text"].Set_String(name);
-    this->components["background"]["text"].Set_String(this->meta_data["background"].string);
-    this->components["music"]["text"].Set_String(this->meta_data["music"].string);
+  cBenchmark::cBenchmark(std::string folder, int runs) {
+    this->folder = folder;
+    this->runs = std::max(1, runs);
+    this->seed = 1;
+    std::error_code folder_error;
+    std::filesystem::create_directories(folder, folder_error);
+    Check_Condition(std::filesystem::is_directory(folder), "Could not create benchmark folder " + folder + ".");
   }
 
   /**
-   * Saves a map to a file.
-   * @param name The name of the file to save to.
-   * @throws An error if the map could not be saved.
+   * Times an operation and records the best and mean time with the mean
+   * number of heap allocations per run.
+   * @param name The name of the operation.
+   * @param size The size of the input.
+   * @param runs The number of runs.
+   * @param job The operation to time.
    */
-  void cMap_Editor::Save_Map(std::string name) {
-    cFile map_file(name + ".map");
-    map_file.Add(this->meta_data);
-    int layer_count = this->sprite_layers.Count();
-    for (int layer_index = 0; layer_index < layer_count; layer_index++) {
-      std::string name = this->sprite_layers.keys[layer_index];
-      tObject_List& sprites = this->sprite_layers[name];
-      int sprite_count = sprites.Count();
-      for (int sprite_index = 0; sprite_index < sprite_count; sprite_index++) {
-        tObject& sprite = sprites[sprite_index];
-        map_file.Add(sprite);
-      }
+  void cBenchmark::Time(std::string name, int size, int runs, std::function<void()> job) {
+    this->Time(name, size, runs, []() {}, job);
+  }
+
+  /**
+   * Times an operation that needs its input reset before each run. The
+   * reset is neither timed nor counted.
+   * @param name The name of the operation.
+   * @param size The size of the input.
+   * @param runs The number of runs.
+   * @param setup Resets the input before a run.
+   * @param job The operation to time.
+   */
+  void cBenchmark::Time(std::string name, int size, int runs, std::function<void()> setup, std::function<void()> job) {
+    sBenchmark_Result result = { name, size, runs, 0.0, 0.0, 0, 0.0 };
+    long long allocations = 0;
+    for (int run_index = 0; run_index < runs; run_index++) {
+      setup();
+      long long start_allocations = memory_stats.allocations.load();
+      std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+      job();
+      double elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+      allocations += memory_stats.allocations.load() - start_allocations;
+      result.best_ms = (run_index == 0) ? elapsed : std::min(result.best_ms, elapsed);
+      result.mean_ms += elapsed / runs;
     }
-    map_file.Write();
+    result.allocations = allocations / runs;
+    this->results.push_back(result);
   }
 
   /**
-   * Initializes the field component.
-   * @param entity The field entity.
+   * Gets a pseudo random number. The sequence is the same on every run so
+   * generated files do not change between benchmarks.
+   * @param limit The number after the largest value.
+   * @return A number from zero to limit - 1.
    */
-  void cMap_Editor::Init_Field(tObject& entity) {
-    entity["text"].Set_String("");
+  int cBenchmark::Random(int limit) {
+    this->seed = this->seed * 1103515245 + 12345;
+    return (int)((this->seed >> 8) % (unsigned int)std::max(1, limit));
   }
 
   /**
-   * Renders a field entity.
-   * @param entity The field component.
+   * Generates a layout of boxes, fields and buttons with its config.
+   * @param component_count The number of components.
+   * @return The name of the layout. The config has the same name with "_Config".
    */
-  void cMap_Editor::Render_Field(tObject& entity) {
-    int dy = entity["height"].number - this->io->Get_Text_Height(entity["text"].string) / 2;
-    int width = this->io->Get_Text_Width(entity["text"].string);
-    int limit = entity["width"].number - 4;
-    if (this->sel_component == entity["id"].string) { // Does field have input focus?
-      if (width < limit) { // Only allow text if input has space.
-        sSignal signal = this->io->Read_Key();
-        if ((signal.code >= ' ') && (signal.code <= '~')) {
-          entity["text"].string += (char)signal.code;
+  std::string cBenchmark::Generate_Layout(int component_count) {
+    std::string name = this->folder + "/Layout_" + Number_To_Text(component_count);
+    int slot_columns = 8;
+    int slot_rows = (component_count + slot_columns - 1) / slot_columns;
+    int width = slot_columns * 12;
+    int height = std::max(1, slot_rows * 3);
+    std::ofstream config_file(name + "_Config.txt", std::ios::binary);
+    config_file << "width=" << (width * 8) << "\ncell-w=8\nheight=" << (height * 16) << "\ncell-h=16\nred=255\ngreen=255\nblue=255\n";
+    std::vector<std::string> grid(height, std::string(width, ' '));
+    std::ofstream layout_file(name + ".txt", std::ios::binary);
+    std::string properties = "";
+    for (int component_index = 0; component_index < component_count; component_index++) {
+      int x = (component_index % slot_columns) * 12;
+      int y = (component_index / slot_columns) * 3;
+      std::string id = Number_To_Text(component_index);
+      switch (component_index % 3) {
+        case 0: { // Box
+          id = "x" + id;
+          grid[y].replace(x, 11, "+-" + id + std::string(8 - id.length(), '-') + "+");
+          grid[y + 1].replace(x, 11, "|" + std::string(9, ' ') + "|");
+          grid[y + 2].replace(x, 11, "+" + std::string(9, '-') + "+");
+          break;
         }
-        else if (signal.code == eSIGNAL_BACKSPACE) {
-          entity["text"].string = entity["text"].string.substr(0, entity["text"].string.length() - 1); // Decrease string.
+        case 1: { // Field
+          id = "f" + id;
+          grid[y].replace(x, 11, "[ " + id + std::string(8 - id.length(), ' ') + "]");
+          break;
         }
-        else if (signal.code = eSIGNAL_DELETE) {
-          entity["text"].string = ""; // Clear out
+        case 2: { // Button
+          id = "b" + id;
+          grid[y].replace(x, 11, "( " + id + std::string(8 - id.length(), ' ') + ")");
+          properties += id + "->label=" + id + ",red=0,green=0,blue=0\n";
         }
       }
-      // Highlight the field.
-      this->io->Box(0, 0, entity["width"].number * this->cell_w, entity["height"].number * this->cell_h, 0, 255, 0);
     }
-    else {
-      this->io->Box(0, 0, entity["width"].number * this->cell_w, entity["height"].number * this->cell_h, 0, 0, 0);
+    for (int row_index = 0; row_index < height; row_index++) {
+      layout_file << grid[row_index] << "\n";
     }
-    // Render the field.
-    this->io->Box(1, 1, entity["width"].number * this->cell_w - 2, entity["height"].number * this->cell_h - 2, 255, 255, 255);
-    this->io->Output_Text(entity["text"].string, 2, dy, 0, 0, 0);
+    layout_file << "\n" << properties;
+    return name;
   }
 
   /**
-   * Initializes a grid view component.
-   * @param entity The grid view entity.
+   * Generates a catalog of sprite prototypes.
+   * @param prototype_count The number of prototypes.
+   * @return The name of the catalog.
    */
-  void cMap_Editor::Init_Grid_View(tObject& entity) {
-    Check_Condition(entity.Does_Key_Exist("columns"), "No column count specified for grid view.");
-    entity["grid-x"].Set_Number(NO_VALUE_FOUND);
-    entity["grid-y"].Set_Number(NO_VALUE_FOUND);
-    entity["scroll-x"].Set_Number(0);
-    entity["scroll-y"].Set_Number(0);
-    entity["text"].Set_String("");
+  std::string cBenchmark::Generate_Catalog(int prototype_count) {
+    std::string name = this->folder + "/Catalog_" + Number_To_Text(prototype_count);
+    std::ofstream catalog_file(name + ".txt", std::ios::binary);
+    for (int proto_index = 0; proto_index < prototype_count; proto_index++) {
+      int width = 8 + (proto_index % 4) * 8;
+      int height = 8 + (proto_index % 3) * 8;
+      this->io.image_sizes["icon_" + Number_To_Text(proto_index)] = { width, height };
+      catalog_file << "sprite_" << proto_index << "\n";
+      catalog_file << "icon=icon_" << proto_index << "\n";
+      catalog_file << "width=" << width << "\nheight=" << height << "\n";
+      catalog_file << "bump-map=0," << "0," << (width - 1) << "," << (height - 1) << "\n";
+      catalog_file << "frame=0\nend\n\n";
+    }
+    std::remove((name + ".idx").c_str()); // Index is rebuilt on the first load.
+    return name;
   }
 
   /**
-   * Renders a grid view component.
-   * @param entity The grid view entity.
+   * Fills the editor with sprites spread over an area and the five layers.
+   * @param editor The map editor with a loaded catalog.
+   * @param sprite_count The number of sprites.
+   * @param prototype_count The number of prototypes in the catalog.
+   * @param width The width of the area the sprites are spread over.
+   * @param height The height of the area the sprites are spread over.
    */
-  void cMap_Editor::Render_Grid_View(tObject& entity) {
-    cArray<std::string> data = Parse_Sausage_Text(entity["text"].string, ";");
-    if ((data.Count() % entity["columns"].number) == 0) { // Does data match column count?
-      int row_count = data.Count() / entity["columns"].number;
-      int col_count = entity["columns"].number;
-      int cell_width = entity["width"].number / col_count;
-      int cell_height = this->io->Get_Text_Height(entity["text"].string) + 4;
-      for (int grid_y = 0; grid_y < row_count; grid_y++) {
-        for (int grid_x = 0; grid_x < col_count; grid_x++) {
-          std::string& text = data[grid_y * col_count + grid_x];
-          if (this->sel_component == entity["id"].string) { // Does field have input focus?
-            sRectangle cell_map = { grid_x * cell_width - entity["scroll-x"].number,
-                                    grid_y * cell_height - entity["scroll-y"].number,
-                                    grid_x * cell_width + cell_width - 1 - entity["scroll-x"].number,
-                                    grid_y * cell_height + cell_height - 1 - entity["scroll-y"].number };
-            if (Is_Point_In_Box(this->mouse_coords, cell_map)) { // Check to see if we clicked into the cell.
-              int width = this->io->Get_Text_Width(text);
-              if (width < cell_width) { // Only allow text if input has space.
-                sSignal signal = this->io->Read_Key();
-                if ((signal.code >= ' ') && (signal.code <= '~')) {
-                  text += (char)signal.code;
-                }
-                else if (signal.code == eSIGNAL_BACKSPACE) {
-                  text = text.substr(0, text.length() - 1); // Decrease string.
-                }
-                else if (signal.code = eSIGNAL_DELETE) {
-                  text = ""; // Clear out
-                }
-                this->Scroll_Component(entity, signal);
-                entity["grid-x"].Set_Number(grid_x);
-                entity["grid-y"].Set_Number(grid_y);
-                entity["text"].Set_String(Join(data, ";")); // Update text.
-              }
-              // Highlight the field.
-              this->io->Box(0 - entity["scroll-x"].number, 0 - entity["scroll-y"].number, entity["width"].number * this->cell_w, entity["height"].number * this->cell_h, 0, 255, 0);
-            }
-          }
-          else {
-            this->io->Box(0 - entity["scroll-x"].number, 0 - entity["scroll-y"].number, entity["width"].number * this->cell_w, entity["height"].number * this->cell_h, 0, 0, 0);
-          }
-          this->io->Box(grid_x * cell_width - entity["scroll-x"].number, grid_y * cell_height - entity["scroll-y"].number, cell_width, cell_height, 0, 0, 0);
-          this->io->Box(grid_x * cell_width + 1 - entity["scroll-x"].number, grid_y * cell_height + 1 - entity["scroll-y"].number, cell_width - 2, cell_height - 2, 255, 255, 255);
-          this->io->Output_Text(text, grid_x * cell_width + 2 - entity["scroll-x"].number, grid_y * cell_height + 2 - entity["scroll-y"].number, 0, 0, 0);
-        }
-      }
+  void cBenchmark::Generate_Map(cMap_Editor& editor, int sprite_count, int prototype_count, int width, int height) {
+    tObject& map_editor = editor.Get_Component("map-editor");
+    int map_width = map_editor["width"].number * editor.cell_w;
+    int map_height = map_editor["height"].number * editor.cell_h;
+    editor.Clear_Map();
+    (*editor.meta_data)["background"].Set_String("bench_background");
+    (*editor.meta_data)["music"].Set_String("bench_music");
+    this->io.image_sizes["bench_background"] = { map_width, map_height };
+    for (int sprite_index = 0; sprite_index < sprite_count; sprite_index++) {
+      tObject record;
+      record["sprite-id"] = cValue("sprite_" + Number_To_Text(this->Random(prototype_count)));
+      record["layer"] = cValue(MAP_LAYERS[sprite_index % MAP_LAYER_COUNT]);
+      record["x"] = cValue(this->Random(width));
+      record["y"] = cValue(this->Random(height));
+      cSprite sprite = editor.Create_Sprite(record);
+      (*editor.sprite_layers)[record["layer"].string].Add(sprite);
+    }
+    for (int layer_index = 0; layer_index < MAP_LAYER_COUNT; layer_index++) {
+      editor.Invalidate_Layer(MAP_LAYERS[layer_index]);
+    }
+  }
+
+  /**
+   * Times layout parsing for each component count.
+   * @param sizes The component counts.
+   * @throws An error if a layout could not be parsed.
+   */
+  void cBenchmark::Run_Layouts(std::vector<int>& sizes) {
+    int size_count = sizes.size();
+    for (int size_index = 0; size_index < size_count; size_index++) {
+      std::string name = this->Generate_Layout(sizes[size_index]);
+      this->Time("Parse_Layout", sizes[size_index], this->runs, [&]() {
+        cLayout layout(name, name + "_Config", &this->io);
+      });
     }
   }
 
   /**
-   * Renders the label component.
-   * @param entity The label entity.
+   * Times catalog and map operations for each sprite count. The editor uses
+   * the program's own layout and config.
+   * @param sizes The sprite counts.
+   * @throws An error if an operation failed.
    */
-  void cMap_Editor::Render_Label(tObject& entity) {
-    Check_Condition(entity.Does_Key_Exist("label"), "No label specified for label.");
-    Check_Condition(entity.Does_Key_Exist("red"), "Red component missing for label color.");
-    Check_Condition(entity.Does_Key_Exist("green"), "Green component missing for label color.");
-    Check_Condition(entity.Does_Key_Exist("blue"), "Blue component missing for label color.");
-    this->io->Output_Text(entity["label"].string, 0, 0, entity["red"].number, entity["green"].number, entity["blue"].number);
+  void cBenchmark::Run_Maps(std::vector<int>& sizes) {
+    int prototype_count = 256;
+    int pick_count = 1000;
+    cMap_Editor editor("Editor_Screen", "Config", &this->io, NULL);
+    tObject& map_editor = editor.Get_Component("map-editor");
+    editor.Init_Map_Editor(map_editor);
+    std::string catalog = this->Generate_Catalog(prototype_count);
+    this->Time("Load_Catalog_Build", prototype_count, this->runs, [&]() {
+      std::remove((catalog + ".idx").c_str()); // Forces the scan of the catalog.
+    }, [&]() {
+      editor.Load_Catalog(catalog);
+    });
+    this->Time("Load_Catalog_Read", prototype_count, this->runs, [&]() {
+      editor.Load_Catalog(catalog); // The index was written by the last build.
+    });
+    int size_count = sizes.size();
+    for (int size_index = 0; size_index < size_count; size_index++) {
+      int size = sizes[size_index];
+      std::string map_name = this->folder + "/Map_" + Number_To_Text(size);
+      this->seed = size; // Same map for the same size.
+      this->Generate_Map(editor, size, prototype_count, map_editor["width"].number * editor.cell_w, map_editor["height"].number * editor.cell_h);
+      const char* encodings[] = { "", "_Compact", "_Packed" };
+      for (int encoding_index = eMAP_TEXT; encoding_index <= eMAP_PACKED; encoding_index++) {
+        editor.map_encoding = (eMap_Encoding)encoding_index;
+        this->Time(std::string("Save_Map") + encodings[encoding_index], size, this->runs, [&]() {
+          editor.Save_Map(map_name);
+        });
+        this->Time(std::string("Load_Map") + encodings[encoding_index], size, this->runs, [&]() {
+          editor.Load_Map(map_name);
+        });
+      }
+      this->Check_Round_Trip(editor, map_name);
+      this->Time("Render_Sprites", size, this->runs, [&]() {
+        editor.Render_Sprites(map_editor);
+      });
+      int map_width = map_editor["width"].number * editor.cell_w;
+      int map_height = map_editor["height"].number * editor.cell_h;
+      sSignal signal;
+      signal.code = eSIGNAL_MOUSE;
+      signal.button = eBUTTON_LEFT;
+      this->Time("Select_Sprite", size, this->runs, [&]() {
+        this->seed = size; // Clicks on empty space place sprites, so every run starts from the same map.
+        this->Generate_Map(editor, size, prototype_count, map_width, map_height);
+      }, [&]() {
+        for (int pick_index = 0; pick_index < pick_count; pick_index++) {
+          editor.sel_layer = MAP_LAYERS[pick_index % MAP_LAYER_COUNT];
+          editor.mouse_coords.x = this->Random(map_width);
+          editor.mouse_coords.y = this->Random(map_height);
+          signal.coords = editor.mouse_coords;
+          map_editor["sel-sprite"].Set_Number(NO_VALUE_FOUND);
+          editor.Select_Sprite(signal, map_editor);
+        }
+      });
+    }
   }
 
   /**
-   * Initializes a list component.
-   * @param entity The list entity.
+   * Times the overlap analysis against a time budget. The sprites are spread
+   * over a large world so the density is like a real level, not the screen.
+   * @param sprite_count The number of sprites.
+   * @param budget_ms The time the best run has to stay under.
+   * @throws An error if an operation failed.
    */
-  void cMap_Editor::Init_List(tObject& entity) {
-    entity["scroll-x"].Set_Number(0);
-    entity["scroll-y"].Set_Number(0);
-    entity["text"].Set_String("");
-    entity["sel-item"].Set_Number(NO_VALUE_FOUND);
+  void cBenchmark::Run_Overlaps(int sprite_count, double budget_ms) {
+    int prototype_count = 256;
+    cMap_Editor editor("Editor_Screen", "Config", &this->io, NULL);
+    tObject& map_editor = editor.Get_Component("map-editor");
+    editor.Init_Map_Editor(map_editor);
+    editor.Load_Catalog(this->Generate_Catalog(prototype_count));
+    this->seed = sprite_count;
+    this->Generate_Map(editor, sprite_count, prototype_count, OVERLAP_BENCH_WORLD, OVERLAP_BENCH_WORLD);
+    this->Time("Analyze_Overlaps", sprite_count, this->runs, [&]() {
+      for (int layer_index = 0; layer_index < MAP_LAYER_COUNT; layer_index++) { // Grids are part of the analysis.
+        editor.Invalidate_Layer(MAP_LAYERS[layer_index]);
+      }
+      editor.Analyze_Overlaps();
+    });
+    this->results.back().budget_ms = budget_ms;
   }
 
   /**
-   * Renders a list entity.
-   * @param entity The entity component.
+   * Checks that the streamed text save writes the same bytes as cFile and
+   * that Read_Object reads back the records it was given.
+   * @param editor The editor with the map to save.
+   * @param map_name The name of the map without the extension.
+   * @throws An error if the files or the records differ.
    */
-  void cMap_Editor::Render_List(tObject& entity) {
-    cArray<std::string> items = Parse_Sausage_Text(entity["text"].string, ";");
-    int item_count = items.Count();
-    int dy = entity["width"].number - this->io->Get_Text_Height(entity["text"].string) / 2;
-    int height = this->io->Get_Text_Height(entity["text"].string) + 2;
-    if (this->sel_component == entity["id"].string) { // Do we have input focus.
-      sSignal signal = this->io->Read_Key();
-      this->Scroll_Component(entity, signal);
+  void cBenchmark::Check_Round_Trip(cMap_Editor& editor, std::string map_name) {
+    editor.map_encoding = eMAP_TEXT;
+    editor.Save_Map(map_name);
+    std::vector<sMap_Record> expected;
+    editor.Get_Map_Records(expected);
+    cFile reference(map_name + "_cFile.map");
+    int record_count = expected.size();
+    for (int record_index = 0; record_index < record_count; record_index++) {
+      reference.Add(expected[record_index].record);
     }
-    for (int item_index = 0; item_index < item_count; item_index++) {
-      std::string item = items[item_index];
-      if (entity["sel-item"].number == item_index) {
-        this->io->Box(0 - entity["scroll-x"].number, item_index * height - entity["scroll-y"].number, entity["width"].number, height, 0, 0, 128);
-      }
-      else {
-        this->io->Box(0 - entity["scroll-x"].number, item_index * height - entity["scroll-y"].number, entity["width"].number, height, 255, 255, 255);
-      }
-      this->io->Output_Text(entity["text"].string, 2 - entity["scroll-x"].number, item_index * height + 2 - entity["scroll-y"].number, 0, 0, 0);
-      if (this->clicked == entity["id"].string) { // Was item clicked?
-        sRectangle item_map = { 0, item_index * height, entity["width"].number - 1, item_index * height + height - 1 };
-        if (Is_Point_In_Box(this->mouse_coords, item_map)) { // Was item clicked on?
-          entity["sel-item"].Set_Number(item_index);
-          this->On_List_Click(entity, item);
-        }
+    reference.Write();
+    std::ifstream streamed_file(map_name + ".map", std::ios::binary);
+    std::ifstream reference_file(map_name + "_cFile.map", std::ios::binary);
+    std::ostringstream streamed;
+    std::ostringstream referenced;
+    streamed << streamed_file.rdbuf();
+    referenced << reference_file.rdbuf();
+    Check_Condition((streamed.str() == referenced.str()), "Saved map " + map_name + " differs from the cFile output.");
+    std::vector<tObject> records;
+    cMap_Codec::Read_Map(map_name + ".map", records);
+    Check_Condition(((int)records.size() == record_count), "Saved map " + map_name + " reads back " + Number_To_Text(records.size()) + " records instead of " + Number_To_Text(record_count) + ".");
+    for (int record_index = 0; record_index < record_count; record_index++) {
+      tObject& record = expected[record_index].record;
+      int key_count = record.Count();
+      Check_Condition((records[record_index].Count() == key_count), "Record " + Number_To_Text(record_index) + " of map " + map_name + " reads back with other keys.");
+      for (int key_index = 0; key_index < key_count; key_index++) {
+        std::string& key = record.keys[key_index];
+        Check_Condition(records[record_index].Does_Key_Exist(key) && Is_Same_Value(records[record_index][key], record.values[key_index]), "Property " + key + " of record " + Number_To_Text(record_index) + " of map " + map_name + " reads back changed.");
       }
     }
   }
 
   /**
-   * Renders a button component.
-   * @param entity The button entity.
+   * Writes the results as one JSON object per line.
+   * @param output The output stream.
    */
-  void cMap_Editor::Render_Button(tObject& entity) {
-    Check_Condition(entity.Does_Key_Exist("label"), "No label for button.");
-    Check_Condition(entity.Does_Key_Exist("red"), "Missing red component for button color.");
-    Check_Condition(entity.Does_Key_Exist("green"), "Missing green component for button color.");
-    Check_Condition(entity.Does_Key_Exist("blue"), "Missing blue component for button color.");
-    int dx = (entity["width"].number - this->io->Get_Text_Width(entity["label"].string)) / 2;
-    int dy = (entity["height"].number - this->io->Get_Text_Height(entity["label"].string)) / 2;
-    this->io->Box(0, 0, entity["width"].number * this->cell_w, entity["height"].number * this->cell_h, entity["red"].number, entity["green"].number, entity["blue"].number);
-    this->io->Output_Text(entity["label"].string, dx, dy, entity["red"].number, entity["green"].number, entity["blue"].number);
-    if (this->clicked == entity["id"].string) { // Was the button clicked?
-      this->On_Button_Click(entity);
+  void cBenchmark::Write_Results(std::ostream& output) {
+    int result_count = this->results.size();
+    output << std::fixed << std::setprecision(3);
+    for (int result_index = 0; result_index < result_count; result_index++) {
+      sBenchmark_Result& result = this->results[result_index];
+      output << "{\"benchmark\":\"" << result.name << "\",\"size\":" << result.size << ",\"runs\":" << result.runs;
+      output << ",\"best-ms\":" << result.best_ms << ",\"mean-ms\":" << result.mean_ms << ",\"allocations\":" << result.allocations;
+      if (result.budget_ms > 0.0) {
+        output << ",\"budget-ms\":" << result.budget_ms << ",\"within-budget\":" << ((result.best_ms < result.budget_ms) ? "true" : "false");
+      }
+      output << "}\n";
     }
   }
 
+  // **************************************************************************
+  // Session Replay Implementation
+  // **************************************************************************
+
   /**
-   * Called when the button was clicked.
-   * @param entity The button entity.
+   * Starts recording the input of an editing session.
+   * @param name The name of the session file.
+   * @throws An error if the file could not be created.
    */
-  void cMap_Editor::On_Button_Click(tObject& entity) {
-    
+  cSession_Recorder::cSession_Recorder(std::string name) {
+    this->file.open(name + SESSION_EXTENSION, std::ios::binary);
+    Check_Condition(this->file.is_open(), "Could not create session " + name + ".");
+    this->file << std::fixed << std::setprecision(3);
+    this->start = std::chrono::steady_clock::now();
   }
 
   /**
-   * Initializes a toolbar component.
-   * @param entity The toolbar entity.
+   * Starts a frame with its time since the start of the session.
    */
-  void cMap_Editor::Init_Toolbar(tObject& entity) {
-    Check_Condition(entity.Does_Key_Exist("columns"), "No column count specified for toolbar.");
-    entity["scroll-x"].Set_Number(0);
-    entity["scroll-y"].Set_Number(0);
-    entity["text"].Set_String("");
-    entity["item-x"].Set_Number(NO_VALUE_FOUND);
-    entity["item-y"].Set_Number(NO_VALUE_FOUND);
+  void cSession_Recorder::Begin_Frame() {
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - this->start;
+    this->file << "frame " << elapsed.count() << "\n";
   }
 
   /**
-   * Renders the toolbar component.
-   * @param entity The toolbar entity.
+   * Records a signal read in the current frame.
+   * @param kind Either mouse or key, after the call that read it.
+   * @param signal The signal.
    */
-  void cMap_Editor::Render_Toolbar(tObject& entity) {
-    cArray<std::string> data = Parse_Sausage_Text(entity["text"].string, ";");
-    if ((data.Count() % entity["columns"].number) == 0) {
-      int row_count = data.Count() / entity["columns"].number;
-      int col_count = entity["columns"].number;
-      int cell_width = entity["width"].number / entity["columns"].number;
-      if (this->sel_component == entity["id"].string) { // Do we have input focus.
-        sSignal signal = this->io->Read_Key();
-        this->Scroll_Component(entity, signal);
+  void cSession_Recorder::Add_Signal(std::string kind, sSignal& signal) {
+    this->file << kind << " " << signal.code << " " << signal.button << " " << signal.coords.x << " " << signal.coords.y << "\n";
+  }
+
+  /**
+   * Records a command run after the current frame.
+   * @param line The command line.
+   */
+  void cSession_Recorder::Add_Command(std::string line) {
+    this->file << "command " << line << "\n";
+  }
+
+  /**
+   * Loads a recorded session to play back.
+   * @param name The name of the session file.
+   * @throws An error if the session could not be read.
+   */
+  cReplay_IO::cReplay_IO(std::string name) {
+    std::ifstream session(name + SESSION_EXTENSION, std::ios::binary);
+    Check_Condition(session.is_open(), "Could not open session " + name + ".");
+    std::string line;
+    while (std::getline(session, line)) {
+      std::istringstream words(line);
+      std::string kind;
+      words >> kind;
+      if (kind == "frame") {
+        sReplay_Frame frame;
+        words >> frame.time_ms;
+        this->frames.push_back(frame);
       }
-      for (int grid_y = 0; grid_y < row_count; grid_y++) {
-        for (int grid_x = 0; grid_x < col_count; grid_x++) {
-          cArray<std::string> pair = Parse_Sausage_Text(data[grid_y * col_count + grid_x], ":");
-          Check_Condition((pair.Count() == 2), "Invalid data format in toolbar item.");
-          std::string label = pair[0];
-          std::string icon = pair[1];
-          int image_width = this->io->Get_Image_Width(icon);
-          int image_height = this->io->Get_Image_Height(icon);
-          int dx = (cell_width - image_width) / 2;
-          int dy = (cell_width - image_height) / 2;
-          int text_x = (cell_width - this->io->Get_Text_Width(label)) / 2;
-          int text_y = dy + image_height + 1;
-          if (this->clicked == entity["id"].string) {
-            sRectangle box = { grid_x * cell_width - entity["scroll-x"].number,
-                               grid_y * cell_width - entity["scroll-y"].number,
-                               grid_x * cell_width + cell_width - 1 - entity["scroll-x"].number,
-                               grid_y * cell_width + cell_width - 1 - entity["scroll-y"].number };
-            if (Is_Point_In_Box(this->mouse_coords, box)) {
-              entity["item-x"].Set_Number(grid_x);
-              entity["item-y"].Set_Number(grid_y);
-              this->On_Toolbar_Click(entity, label);
-            }
-          }
-          this->io->Draw_Image(icon, dx - entity["scroll-x"].number, dy - entity["scroll-y"].number, image_width, image_height, 0, false, false);
-          if ((entity["item-x"].number == grid_x) && (entity["item-y"].number == grid_y)) {
-            this->io->Output_Text(label, text_x - entity["scroll-x"].number, text_y - entity["scroll-y"].number, 0, 128, 0); // Mark with green as this is selected.
-          }
-          else {
-            this->io->Output_Text(label, text_x - entity["scroll-x"].number, text_y - entity["scroll-y"].number, 0, 0, 0);
-          }
-        }
+      else if ((kind == "mouse") || (kind == "key")) {
+        Check_Condition(!this->frames.empty(), "Signal before the first frame in session " + name + ".");
+        sSignal signal;
+        words >> signal.code >> signal.button >> signal.coords.x >> signal.coords.y;
+        Check_Condition(!words.fail(), "Signal is not formatted correctly in session " + name + ".");
+        std::deque<sSignal>& signals = (kind == "mouse") ? this->frames.back().mouse : this->frames.back().keys;
+        signals.push_back(signal);
+      }
+      else if (kind == "command") {
+        Check_Condition(!this->frames.empty(), "Command before the first frame in session " + name + ".");
+        this->frames.back().commands.push_back(line.substr(kind.length() + 1));
       }
     }
+    this->frame = 0;
   }
 
   /**
-   * Initializes the map editor component.
-   * @param entity The map editor entity.
+   * Ends the current frame.
    */
-  void cMap_Editor::Init_Map_Editor(tObject& entity) {
-    entity["scroll-x"].Set_Number(0);
-    entity["scroll-y"].Set_Number(0);
+  void cReplay_IO::Refresh() {
+    this->frame++;
   }
 
   /**
-   * Renders the map editor component.
-   * @param entity The map editor entity.
+   * Reads the next mouse signal recorded in the current frame.
+   * @return The signal or an empty signal when the frame has no more.
    */
-  void cMap_Editor::Render_Map_Editor(tObject& entity) {
-    
+  sSignal cReplay_IO::Read_Signal() {
+    if (this->Has_More_Frames() && !this->frames[this->frame].mouse.empty()) {
+      sSignal signal = this->frames[this->frame].mouse.front();
+      this->frames[this->frame].mouse.pop_front();
+      return signal;
+    }
+    return cHeadless_IO::Read_Signal();
   }
 
   /**
-   * Fires when a list item is clicked.
-   * @param entity The list entity.
-   * @param text The text of the item that was clicked.
+   * Reads the next key recorded in the current frame.
+   * @return The signal or an empty signal when the frame has no more.
    */
-  void cMap_Editor::On_List_Click(tObject& entity, std::string text) {
-
+  sSignal cReplay_IO::Read_Key() {
+    if (this->Has_More_Frames() && !this->frames[this->frame].keys.empty()) {
+      sSignal signal = this->frames[this->frame].keys.front();
+      this->frames[this->frame].keys.pop_front();
+      return signal;
+    }
+    return cHeadless_IO::Read_Key();
   }
 
   /**
-   * Fires when a toolbar item is clicked.
-   * @param entity The toolbar entity.
-   * @param label The label of the clicked item.
+   * Determines if frames are left to play.
+   * @return True if there are more frames, false otherwise.
    */
-  void cMap_Editor::On_Toolbar_Click(tObject& entity, std::string label) {
+  bool cReplay_IO::Has_More_Frames() {
+    return (this->frame < (int)this->frames.size());
+  }
+
+  // **************************************************************************
+  // Command Pipe Implementation
+  // **************************************************************************
 
+  /**
+   * Creates a command pipe with no source.
+   */
+  cCommand_Pipe::cCommand_Pipe() {
+    this->listener = NO_VALUE_FOUND;
+    this->socket_path = "";
+    this->closed = false;
+    this->stopping = false;
   }
 
   /**
-   * Loads an object from a grid view.
-   * @param object The object to load.
-   * @param grid_view The grid view to load the object from.
-   * @throws An error if there aren't two columns in the grid view.
+   * Stops the readers, closes the socket and removes its path. The listener
+   * is shut down first so a blocked accept returns.
    */
-  void cMap_Editor::Load_Object_From_Grid_View(tObject& object, tObject& grid_view) {
-    Check_Condition((grid_view["columns"].number == 2), "There needs to be two columns in grid view.");
-    object.Clear();
-    cArray<std::string> items = Parse_Sausage_Text(grid_view["text"].string, ";");
-    int item_count = items.Count();
-    Check_Condition((item_count % 2 == 0), "Data is not column aligned for object.");
-    for (int item_index = 0; item_index < item_count; item_index += 2) {
-      std::string& key = items[item_index + 0];
-      cValue value = items[item_index + 1];
-      object[key] = value;
+  cCommand_Pipe::~cCommand_Pipe() {
+    this->stopping = true;
+#ifdef __linux__
+    if (this->listener != NO_VALUE_FOUND) {
+      shutdown(this->listener, SHUT_RDWR);
+      close(this->listener);
+      unlink(this->socket_path.c_str());
+    }
+#endif
+    int reader_count = this->readers.size();
+    for (int reader_index = 0; reader_index < reader_count; reader_index++) {
+      this->readers[reader_index].join();
     }
   }
 
   /**
-   * Saves an object into a grid view.
-   * @param object The object to save.
-   * @param grid_view The grid view entity.
-   * @throws An error if the grid view does not have two columns.
+   * Reads commands from standard input on a reader thread.
    */
-  void cMap_Editor::Save_Object_To_Grid_View(tObject& object, tObject& grid_view) {
-    Check_Condition((grid_view["columns"].number == 2), "There needs to be two columns in grid view.");
-    this->Init_Grid_View(grid_view);
-    int prop_count = object.Count();
-    cArray<std::string> items;
-    for (int prop_index = 0; prop_index < prop_count; prop_index++) {
-      std::string& key = object.keys[prop_index];
-      items.Add(key);
-      cValue& value = object.values[prop_index];
-      if (value.type == eVALUE_NUMBER) {
-        value.Convert_To_String();
-        items.Add(value.string);
-      }
-      else if (value.type == eVALUE_STRING) {
-        items.Add(value.string);
-      }
-    }
-    grid_view["text"].Set_String(Join(items, ";"));
+  void cCommand_Pipe::Open_Stdin() {
+#ifdef __linux__
+    this->readers.push_back(std::thread([this]() {
+      this->Read_Lines(STDIN_FILENO, NO_VALUE_FOUND);
+      std::lock_guard<std::mutex> guard(this->lock);
+      this->closed = true;
+      this->command_ready.notify_all();
+    }));
+#else
+    throw cError("Command input is not supported on this platform.");
+#endif
   }
 
   /**
-   * Updates the sprite palette.
-   * @param toolbar The toolbar representing the sprite palette.
+   * Listens on a local socket. Clients are served one at a time and get
+   * their replies on the same connection.
+   * @param path The path of the socket.
+   * @throws An error if the socket could not be opened.
    */
-  void cMap_Editor::Update_Sprite_Palette(tObject& toolbar) {
-    this->Init_Toolbar(toolbar);
-    int catalog_size = this->catalog.Count();
-    cArray<std::string> items;
-    for (int catalog_index = 0; catalog_index < catalog_size; catalog_index++) {
-      std::string& sprite_name = this->catalog.keys[catalog_index];
-      tObject& sprite = this->catalog.values[catalog_index];
-      Check_Condition(sprite.Does_Key_Exist("icon"), "Icon property missing in sprite.");
-      items.Add(sprite_name + ":" + sprite["icon"].string);
-    }
-    toolbar["text"].Set_String(Join(items, ";"));
+  void cCommand_Pipe::Open_Socket(std::string path) {
+#ifdef __linux__
+    sockaddr_un address;
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    Check_Condition((path.length() < sizeof(address.sun_path)), "Socket path " + path + " is too long.");
+    std::strcpy(address.sun_path, path.c_str());
+    unlink(path.c_str());
+    this->listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    Check_Condition((this->listener >= 0), "Could not create command socket.");
+    Check_Condition((bind(this->listener, (sockaddr*)&address, sizeof(address)) == 0) && (listen(this->listener, 4) == 0), "Could not listen on " + path + ".");
+    this->socket_path = path;
+    this->readers.push_back(std::thread([this]() {
+      this->Read_Socket();
+    }));
+#else
+    throw cError("Command sockets are not supported on this platform.");
+#endif
   }
 
   /**
-   * Scrolls a component when the user presses the arrow keys.
-   * @param entity The component to scroll.
-   * @param signal The user signal.
+   * Queues every line read from a descriptor. The descriptor is polled so
+   * the reader notices when the pipe is stopping and can be joined.
+   * @param source The descriptor to read.
+   * @param client The socket to reply to or NO_VALUE_FOUND for standard output.
+   * @return True if the source ended, false if the pipe is stopping.
    */
-  void cMap_Editor::Scroll_Component(tObject& entity, sSignal& signal) {
-    Check_Condition(entity.Does_Key_Exist("scroll-x"), "Scroll x coordinate missing.");
-    Check_Condition(entity.Does_Key_Exist("scroll-y"), "Scroll y coordinate missing.");
-    switch (signal.code) {
-      case eSIGNAL_LEFT: {
-        entity["scroll-x"].number--;
+  bool cCommand_Pipe::Read_Lines(int source, int client) {
+#ifdef __linux__
+    std::string line = "";
+    char buffer[4096];
+    while (!this->stopping) {
+      pollfd ready = { source, POLLIN, 0 };
+      int ready_count = poll(&ready, 1, COMMAND_POLL_MS);
+      if ((ready_count < 0) && (errno != EINTR)) {
         break;
       }
-      case eSIGNAL_RIGHT: {
-        entity["scroll-x"].number++;
-        break;
+      if (ready_count <= 0) {
+        continue;
       }
-      case eSIGNAL_UP: {
-        entity["scroll-y"].number--;
+      ssize_t count = read(source, buffer, sizeof(buffer));
+      if (count <= 0) { // End of the source.
         break;
       }
-      case eSIGNAL_DOWN: {
-        entity["scroll-y"].number++;
+      for (ssize_t char_index = 0; char_index < count; char_index++) {
+        if (buffer[char_index] == '\n') {
+          this->Push(line, client, false);
+          line = "";
+        }
+        else {
+          line += buffer[char_index];
+        }
       }
     }
-  }
-
-  /**
-   * Updates the level list.
-   * @param list The list component.
-   */
-  void cMap_Editor::Update_Levels(tObject& list) {
-    cArray<std::string> files = this->io->Get_File_List(this->io->Get_Current_Folder());
-    this->Init_List(list);
-    cArray<std::string> levels;
-    int file_count = files.Count();
-    for (int file_index = 0; file_index < file_count; file_index++) {
-      std::string file = files[file_index];
-      levels.Add(this->io->Get_File_Title(file));
+    if (line.length() > 0) {
+      this->Push(line, client, false);
     }
-    list["text"] = Join(levels, ";");
+#endif
+    return !this->stopping;
   }
 
   /**
-   * Selects a sprite or created a new one.
-   * @param signal The input signal.
-   * @param map_editor The map editor component.
+   * Accepts clients and queues the lines they send.
    */
-  void cMap_Editor::Select_Sprite(sSignal& signal, tObject& map_editor) {
-    tObject_List& sprites = this->sprite_layers[this->sel_layer];
-    int sprite_count = sprites.Count();
-    bool sprite_found = false;
-    for (int sprite_index = sprite_count - 1; sprite_index >  0; sprite_index--) { // Select top-down sprites.
-      tObject& sprite = sprites[sprite_index];
-      Check_Condition(sprite.Does_Key_Exist("bump-map"), "No bump map present in sprite.");
-      sRectangle bump_map = Parse_Rectangle(sprite["bump-map"].string);
-      if (signal.code == eSIGNAL_MOUSE) {
-        Check_Condition(sprite.Does_Key_Exist("x"), "Sprite has no X coordinate.");
-        Check_Condition(sprite.Does_Key_Exist("y"), "Sprite has no Y coordinate.");
-        // Augment bump map with sprite coordinates.
-        bump_map.left += sprite["x"].number;
-        bump_map.right += sprite["x"].number;
-        bump_map.top += sprite["y"].number;
-        bump_map.bottom += sprite["y"].number;
-        if (Is_Point_In_Box(this->mouse_coords, bump_map)) {
-          if (signal.button == eBUTTON_LEFT) {
-            if (map_editor["sel-sprite"].number == NO_VALUE_FOUND) { // Sprite not selected.
-              map_editor["sel-sprite"].Set_Number(sprite_index);
-              sprite_found = true;
-              break;
-            }
-          }
-        }
+  void cCommand_Pipe::Read_Socket() {
+#ifdef __linux__
+    while (!this->stopping) {
+      int client = accept(this->listener, NULL, NULL);
+      if (client < 0) { // Listener was shut down.
+        break;
       }
-    }
-    if (!sprite_found) { // Lay down sprite if no sprite found.
-      if (map_editor["sel-sprite"].number == NO_VALUE_FOUND) {
-        tObject& new_sprite = this->catalog[this->sel_sprite_id];
-        sprites.Add(new_sprite);
-        map_editor["sel-sprite"].Set_Number(sprites.Count() - 1);
+      if (this->Read_Lines(client, client)) {
+        this->Push("", client, true); // Closes the client once its commands are answered.
+      }
+      else {
+        close(client);
       }
     }
+#endif
   }
 
   /**
-   * Parses a rectangle from text.
-   * @param text The text containing the rectangle string.
-   * @return A rectangle object.
-   * @throws An error if the rectangle is not valid.
-   */
-  sRectangle cMap_Editor::Parse_Rectangle(std::string text) {
-    cArray<std::string> str_rect = Parse_Sausage_Text(text, ",");
-    sRectangle rect;
-    Check_Condition((str_rect.Count() == 4), "Rectangle is not formatted correctly.");
-    rect.left = Text_To_Number(str_rect[0]);
-    rect.top = Text_To_Number(str_rect[1]);
-    rect.right = Text_To_Number(str_rect[2]);
-    rect.bottom = Text_To_Number(str_rect[3]);
-    return rect;
-  }
-
-  /**
-   * Renders sprites to the map control.
-   * @param map_editor The map editor component.
+   * Adds a command to the queue.
+   * @param line The command line.
+   * @param client The client that sent it.
+   * @param end Whether this marks the end of the client.
    */
-  void cMap_Editor::Render_Sprites(tObject& map_editor) {
-    int bkg_width = this->io->Get_Image_Width(this->meta_data["background"].string);
-    int bkg_height = this->io->Get_Image_Height(this->meta_data["background"].string);
-    int map_width = map_editor["width"].number * this->cell_w;
-    int map_height = map_editor["height"].number * this->cell_h;
-    Check_Condition((bkg_width == map_width) && (bkg_height == map_height), "The size of the background must match the map size. (" + Number_To_Text(map_width) + "x" + Number_To_Text(map_height) + ")");
-    this->io->Draw_Image(this->meta_data["background"].string, 0, 0, map_width, map_height, 0, false, false);
-    int layer_count = this->sprite_layers.Count();
-    for (int layer_index = 0; layer_index < layer_count; layer_index++) {
-      tObject_List& layer = this->sprite_layers.values[layer_index];
-      int sprite_count = layer.Count();
-      for (int sprite_index = 0; sprite_index < sprite_count; sprite_index++) {
-        tObject& sprite = layer[sprite_index];
-        Check_Condition(sprite.Does_Key_Exist("x"), "No X coordinate in sprite.");
-        Check_Condition(sprite.Does_Key_Exist("y"), "No Y coordinate in sprite.");
-        Check_Condition(sprite.Does_Key_Exist("width"), "Sprite has no width set.");
-        Check_Condition(sprite.Does_Key_Exist("height"), "Sprite has no height set.");
-        this->io->Draw_Image(sprite["icon"].string, sprite["x"].number - map_editor["scroll-x"].number, sprite["y"].number - map_editor["scroll-y"].number, sprite["width"].number, sprite["height"].number, 0, false, false);
-      }
+  void cCommand_Pipe::Push(std::string line, int client, bool end) {
+    if ((line.length() > 0) && (line[line.length() - 1] == '\r')) {
+      line.erase(line.length() - 1);
     }
+    std::lock_guard<std::mutex> guard(this->lock);
+    sCommand command = { line, client, end };
+    this->commands.push_back(command);
+    this->command_ready.notify_one();
   }
 
   /**
-   * Clears out the map data.
+   * Takes queued commands up to a limit so the caller can check its clock
+   * between batches.
+   * @param batch Receives the commands in order.
+   * @param wait Whether to wait for a command if none are queued.
+   * @param limit The most commands to take.
+   * @return False if the source closed and no commands are left.
    */
-  void cMap_Editor::Clear_Map() {
-    this->sel_layer = "background";
-    this->sel_sprite = NO_VALUE_FOUND;
-    this->meta_data.Clear();
-    int layer_count = this->sprite_layers.Count();
-    for (int layer_index = 0; layer_index < layer_count; layer_index++) {
-      tObject_List& layer = this->sprite_layers.values[layer_index];
-      layer.Clear();
+  bool cCommand_Pipe::Take_Commands(std::vector<sCommand>& batch, bool wait, int limit) {
+    std::unique_lock<std::mutex> guard(this->lock);
+    batch.clear();
+    if (wait) {
+      this->command_ready.wait(guard, [this]() {
+        return !this->commands.empty() || this->closed;
+      });
     }
+    int take_count = std::min(limit, (int)this->commands.size());
+    batch.assign(this->commands.begin(), this->commands.begin() + take_count);
+    this->commands.erase(this->commands.begin(), this->commands.begin() + take_count);
+    return !batch.empty() || !this->closed;
   }
 
   /**
-   * Destars starred sprite properties.
-   * @param sprite The sprite properties to destar.
+   * Sends the reply of a command to whoever sent it.
+   * @param command The command.
+   * @param reply The reply line.
    */
-  void cMap_Editor::Destar_Sprite(tObject& sprite) {
-    int prop_count = sprite.Count();
-    for (int prop_index = 0; prop_index < prop_count; prop_index++) {
-      Check_Condition((sprite.keys[prop_index].length() > 0), "Key is NULL.");
-      if (sprite.keys[prop_index][0] == '*') {
-        sprite.keys[prop_index] = sprite.keys[prop_index].substr(1); // Destar the key.
-      }
+  void cCommand_Pipe::Reply(sCommand& command, std::string reply) {
+    if ((reply == "") && !command.end) { // Blank lines get no reply.
+      return;
+    }
+    if (command.client == NO_VALUE_FOUND) {
+      std::cout << reply << "\n";
+      std::cout.flush();
     }
+#ifdef __linux__
+    else if (command.end) {
+      close(command.client);
+    }
+    else {
+      reply += "\n";
+      send(command.client, reply.c_str(), reply.length(), MSG_NOSIGNAL);
+    }
+#endif
   }
 
-}
\ No newline at end of file
+}
@@ -5,9 +5,549 @@
 
 #include "..\Code_Helper\Codeloader.hpp"
 #include "..\Code_Helper\Allegro.hpp"
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include <fstream>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <deque>
+#include <chrono>
+#include <map>
+#include <filesystem>
+#include <atomic>
+#include <random>
+#include <memory>
+#include <list>
 
 namespace Codeloader {
 
+  const int MAP_LAYER_COUNT = 5;
+  const std::string MAP_LAYERS[MAP_LAYER_COUNT] = { "background", "platform", "character", "foreground", "overlay" };
+
+  class cArena {
+
+    public:
+      std::vector<char*> blocks;
+      std::vector<size_t> block_sizes;
+      std::deque<std::string> texts;
+      std::vector<std::vector<void*>> free_lists;
+      long long free_bytes;
+      size_t block_size;
+      size_t used;
+      size_t capacity;
+      long long allocations;
+
+      cArena();
+      ~cArena();
+      cArena(const cArena& other) = delete;
+      cArena& operator=(const cArena& other) = delete;
+      void* Allocate(size_t size);
+      void* Reuse(size_t size);
+      void Release(void* memory, size_t size);
+      int Add_Text(const std::string& text);
+      const std::string& Get_Text(int index);
+      const char* Copy_String(const std::string& text);
+      void Clear();
+      long long Get_Bytes();
+      void Swap(cArena& other);
+
+  };
+
+  enum eProperty_Key {
+    eKEY_X,
+    eKEY_Y,
+    eKEY_LAYER,
+    eKEY_ICON,
+    eKEY_WIDTH,
+    eKEY_HEIGHT,
+    eKEY_BUMP_MAP,
+    eKEY_SPRITE_ID,
+    eKEY_UID
+  };
+
+  class cString_Table {
+
+    public:
+      std::vector<std::string> strings;
+      std::unordered_map<std::string, int> ids;
+
+      cString_Table();
+      int Intern(const std::string& text);
+      int Find(const std::string& text);
+      const std::string& Get_String(int id);
+
+  };
+
+  extern cString_Table string_table;
+
+  const int ARENA_TEXT = -2; // Property texts from here down are kept in the arena.
+
+  struct sSprite_Property {
+    int key;
+    int text;
+    int number;
+  };
+
+  class cCatalog_Index;
+
+  class cSprite {
+
+    public:
+      cCatalog_Index* catalog;
+      cArena* arena;
+      int proto;
+      sSprite_Property* overrides;
+      int override_count;
+      int override_capacity;
+      bool alive;
+
+      cSprite();
+      cSprite(cCatalog_Index* catalog, cArena* arena, int proto);
+      bool Does_Key_Exist(std::string key);
+      bool Does_Key_Exist(int key);
+      cValue Get(std::string key);
+      cValue Get(int key);
+      const std::string& Get_Text(int key);
+      sSprite_Property* Find_Property(int key);
+      void Set(std::string key, cValue value);
+      void Detach();
+      void Set_Overrides(tObject& record);
+      int Find_Override(int key);
+      bool Has_Override(std::string key);
+      void Remove_Override(std::string key);
+      std::string Get_Sprite_Id();
+      tObject Get_Record();
+      tObject Flatten();
+      int Measure();
+      cValue Get_Value(sSprite_Property& property);
+      const std::string& Get_Text(sSprite_Property& property);
+      sSprite_Property Make_Override(int key, cValue& value, int index);
+      static sSprite_Property Make_Property(int key, cValue& value);
+
+  };
+
+  typedef cArray<cSprite> tSprite_List;
+
+  enum eEdit_Type {
+    eEDIT_PLACE,
+    eEDIT_DELETE,
+    eEDIT_MOVE,
+    eEDIT_MOVE_GROUP,
+    eEDIT_PROPERTY,
+    eEDIT_LAYER,
+    eEDIT_META,
+    eEDIT_TILES
+  };
+
+  struct sSprite_Ref {
+    int layer;
+    int index;
+  };
+
+  struct sEdit {
+    eEdit_Type type;
+    int group;
+    std::string layer;
+    int index;
+    std::string to_layer;
+    int to_index;
+    std::string key;
+    bool overridden;
+    cValue old_value;
+    cValue new_value;
+    sPoint old_coords;
+    sPoint new_coords;
+    std::vector<int> tile_changes;
+    std::vector<sSprite_Ref> sprites;
+  };
+
+  class cHistory {
+
+    public:
+      std::vector<sEdit> undo_stack;
+      std::vector<sEdit> redo_stack;
+      int next_group;
+      int open_group;
+
+      cHistory();
+      void Record(sEdit edit);
+      void Begin_Group();
+      void End_Group();
+      void Clear();
+
+  };
+
+  class cTile_Layer {
+
+    public:
+      int cell_w;
+      int cell_h;
+      int columns;
+      int rows;
+      std::vector<int> cells;
+
+      cTile_Layer();
+      void Resize(int columns, int rows);
+      bool Is_Inside(int column, int row);
+      int Get(int column, int row);
+      void Set(int column, int row, int value, std::vector<int>& changes);
+      void Paint(int column, int row, int size, int value, std::vector<int>& changes);
+      void Fill_Rectangle(int left, int top, int right, int bottom, int value, std::vector<int>& changes);
+      void Flood_Fill(int column, int row, int value, std::vector<int>& changes);
+
+  };
+
+  struct sMemory_Stats {
+    std::atomic<long long> allocations;
+    std::atomic<long long> allocated_bytes;
+    std::atomic<long long> frees;
+    std::atomic<long long> live_bytes;
+    std::atomic<long long> peak_bytes;
+  };
+
+  extern sMemory_Stats memory_stats;
+
+  const int MEMORY_PANEL_MS = 500;
+
+  struct sMemory_Entry {
+    std::string name;
+    long long bytes;
+    long long count;
+    long long peak;
+  };
+
+  class cMemory_Report {
+
+    public:
+      std::vector<sMemory_Entry> entries;
+      std::unordered_map<std::string, long long> peaks;
+
+      void Clear();
+      void Add(std::string name, long long bytes, long long count);
+      std::string Get_Text();
+      void Write(std::string name);
+
+  };
+
+  class cSpatial_Grid {
+
+    public:
+      int cell_size;
+      bool dirty;
+      std::vector<sRectangle> bounds;
+      std::vector<bool> has_bounds;
+      std::unordered_map<long long, std::vector<int>> cells;
+      std::vector<int> stamps;
+      int stamp;
+      int margin;
+
+      cSpatial_Grid();
+      void Build(tSprite_List& sprites);
+      void Query(sRectangle area, std::vector<int>& found);
+      static bool Get_Bounds(cSprite& sprite, sRectangle& bounds);
+      static long long Get_Cell_Key(int cell_x, int cell_y);
+
+  };
+
+  class cZ_Order {
+
+    public:
+      std::string sort_key;
+      std::vector<int> order;
+      std::vector<int> ranks;
+      std::vector<int> keys;
+
+      void Build(tSprite_List& sprites, std::string sort_key);
+      void Update(tSprite_List& sprites, int index);
+      bool Is_Before(int a, int b);
+      static int Get_Key(cSprite& sprite, std::string& sort_key);
+
+  };
+
+  struct sBox {
+    sRectangle box;
+    int layer;
+    int index;
+  };
+
+  struct sOverlap {
+    int layer_a;
+    int index_a;
+    int layer_b;
+    int index_b;
+  };
+
+  class cOverlap_Finder {
+
+    public:
+      std::vector<sBox> boxes;
+
+      void Add(sRectangle box, int layer, int index);
+      void Find(std::vector<sOverlap>& overlaps, int worker_count);
+      void Sweep(int top, int bottom, std::vector<sOverlap>& overlaps);
+
+  };
+
+  struct sCatalog_Entry {
+    std::string name;
+    long offset;
+    std::string icon;
+    bool parsed;
+    std::vector<sSprite_Property> properties;
+  };
+
+  class cCatalog_Index {
+
+    public:
+      std::string name;
+      std::vector<sCatalog_Entry> entries;
+      std::ifstream catalog_file;
+
+      void Load(std::string name);
+      bool Is_Current();
+      void Build();
+      void Save();
+      void Read_Entry(int index, tObject& sprite);
+
+  };
+
+  enum eJob_Priority {
+    eJOB_FRAME,
+    eJOB_NORMAL,
+    eJOB_BACKGROUND,
+    eJOB_PRIORITY_COUNT
+  };
+
+  typedef std::shared_ptr<std::atomic<int>> tJob_Batch;
+  typedef std::shared_ptr<std::atomic<bool>> tJob_Token;
+
+  struct sJob {
+    std::function<void()> work;
+    tJob_Batch batch;
+    tJob_Token token;
+  };
+
+  class cJob_Queue {
+
+    public:
+      std::mutex lock;
+      std::deque<sJob> jobs[eJOB_PRIORITY_COUNT];
+      std::atomic<long long> jobs_run;
+      std::atomic<long long> jobs_stolen;
+      std::atomic<long long> jobs_cancelled;
+      std::atomic<long long> busy_us;
+
+      cJob_Queue();
+
+  };
+
+  class cJob_System {
+
+    public:
+      std::vector<std::thread> workers;
+      std::vector<std::unique_ptr<cJob_Queue>> queues;
+      std::atomic<int> queued;
+      std::atomic<int> running;
+      std::atomic<long long> added;
+      std::atomic<int> next_queue;
+      std::mutex sleep_lock;
+      std::condition_variable job_ready;
+      std::condition_variable job_done;
+      std::mutex main_lock;
+      std::deque<sJob> main_jobs;
+      std::chrono::steady_clock::time_point start;
+      bool stopping;
+      static int worker_count;
+
+      cJob_System(int worker_count);
+      ~cJob_System();
+      static cJob_System& Shared();
+      static tJob_Batch New_Batch();
+      static tJob_Token New_Token();
+      static bool Is_Cancelled(tJob_Token& token);
+      void Add_Job(std::function<void()> work, eJob_Priority priority, tJob_Batch batch, tJob_Token token);
+      void Post_Main(std::function<void()> work, tJob_Token token);
+      void Run_Main_Jobs(double budget_ms);
+      void Wait(tJob_Batch batch);
+      bool Run_One(int worker, tJob_Batch batch);
+      void Run_Job(sJob& job, int worker);
+      void Run_Worker(int worker);
+      void Drain();
+      std::string Get_Stats();
+
+  };
+
+  struct sDecoded_Image {
+    std::string name;
+    ALLEGRO_BITMAP* bitmap;
+    double decode_ms;
+  };
+
+  struct sLoad_Time {
+    std::string name;
+    double decode_ms;
+    double upload_ms;
+  };
+
+  const int RESOURCE_FONT_SIZE = 16;
+
+  class cResource_Loader {
+
+    public:
+      cAllegro_IO* allegro;
+      std::string folder;
+      std::unordered_map<std::string, std::string> paths;
+      std::unordered_map<std::string, bool> loaded;
+      std::vector<sLoad_Time> load_times;
+      std::unordered_map<std::string, std::string> sound_paths;
+      std::unordered_map<std::string, std::string> font_paths;
+      std::unordered_map<std::string, ALLEGRO_SAMPLE*> sounds;
+      std::unordered_map<std::string, ALLEGRO_FONT*> fonts;
+
+      cResource_Loader(cAllegro_IO* allegro, std::string folder);
+      ~cResource_Loader();
+      bool Is_Loaded(std::string name);
+      void Load_Image(std::string name);
+      void Load_Images(std::vector<std::string>& names);
+      void Load_Sounds_And_Fonts();
+      std::string Get_Scaled_Image(std::string name, int zoom);
+      void Register_Image(std::string name, ALLEGRO_BITMAP* bitmap);
+      void Unload_Image(std::string name);
+      long long Get_Image_Bytes(std::string name);
+      void Write_Load_Report(std::string name);
+      static int Slice_Image(std::string file, std::string name, int tile_size);
+      static std::string Get_File_Type(std::string file);
+      static bool Is_Image_Type(std::string type);
+
+  };
+
+  const std::string TILE_FOLDER = "Tiles";
+  const int TILE_MAX_LEVELS = 5; // Down to 1/16x like the zoom.
+  const int TILE_CACHE_MB = 64;
+
+  struct sTiled_Background {
+    std::string name;
+    int tile_size;
+    int width;
+    int height;
+    int levels;
+  };
+
+  struct sCached_Tile {
+    std::list<std::string>::iterator place;
+    long long bytes;
+    int frame;
+  };
+
+  class cTile_Cache {
+
+    public:
+      cResource_Loader* loader;
+      std::list<std::string> recent;
+      std::unordered_map<std::string, sCached_Tile> tiles;
+      std::unordered_set<std::string> pending;
+      std::unordered_set<std::string> failed;
+      tJob_Token token;
+      long long budget;
+      long long bytes;
+      int frame;
+
+      cTile_Cache();
+      ~cTile_Cache();
+      bool Request(std::string name, std::string path);
+      bool Is_Cached(std::string name);
+      void Add_Tile(std::string name, ALLEGRO_BITMAP* bitmap);
+      void Trim();
+      void Clear();
+      static std::string Get_Tile_Name(std::string name, int level, int col, int row);
+      static bool Read_Manifest(std::string folder, std::string name, sTiled_Background& tiled);
+      static int Get_Level_Size(int size, int level);
+      static sRectangle Get_Tile_Area(sTiled_Background& tiled, int level, int col, int row);
+
+  };
+
+  const int LEVEL_POLL_MS = 1000; // Without a folder watch.
+
+  struct sLevel_Entry {
+    std::string name;
+    long mtime;
+    long size;
+    std::map<std::string, int> layer_counts;
+    std::string background;
+    std::string music;
+  };
+
+  class cLevel_Index {
+
+    public:
+      cIO_Control* io;
+      std::string folder;
+      std::map<std::string, sLevel_Entry> levels;
+      int watch_fd;
+      bool changed;
+      std::chrono::steady_clock::time_point last_poll;
+
+      cLevel_Index();
+      ~cLevel_Index();
+      void Open(cIO_Control* io, std::string folder);
+      void Close();
+      bool Refresh();
+      void Poll();
+      void Read_Events();
+      void Update_Level(std::string file);
+      void Scan_Level(sLevel_Entry& entry);
+      void Load();
+      void Save();
+      std::string Get_Level_List();
+      static std::string Escape_Field(std::string text);
+      static cArray<std::string> Split_Fields(std::string line);
+
+  };
+
+  bool Read_Object(std::istream& stream, tObject& object);
+  cValue Parse_Value(std::string text);
+  bool Is_Same_Value(const cValue& a, const cValue& b);
+
+  struct sInput_Event {
+    sSignal signal;
+    int repeat;
+    std::string target;
+  };
+
+  const std::string SESSION_EXTENSION = ".session"; // Kept apart from layouts and configs.
+
+  class cSession_Recorder {
+
+    public:
+      std::ofstream file;
+      std::chrono::steady_clock::time_point start;
+
+      cSession_Recorder(std::string name);
+      void Begin_Frame();
+      void Add_Signal(std::string kind, sSignal& signal);
+      void Add_Command(std::string line);
+
+  };
+
+  class cInput_Queue {
+
+    public:
+      std::deque<sInput_Event> events;
+      int limit;
+      cSession_Recorder* recorder;
+
+      cInput_Queue();
+      void Drain(cIO_Control* io);
+      void Add(sSignal& signal);
+      bool Next_Key(std::string target, sInput_Event& event);
+      void Clear();
+      static bool Is_Scroll_Key(int code);
+
+  };
+
   class cLayout {
 
     public:
@@ -24,7 +564,10 @@ namespace Codeloader {
       char** grid;
       cIO_Control* io;
       sPoint mouse_coords;
+      sPoint drag_coords;
+      int clicked_button;
       bool not_clicked;
+      cInput_Queue input;
 
       cLayout(std::string name, std::string config, cIO_Control* io);
       ~cLayout();
@@ -39,32 +582,210 @@ namespace Codeloader {
       void Parse_Button(tObject& entity);
       void Parse_Properties(cFile& file);
       void Render();
+      void Route_Mouse(sSignal& signal);
       virtual void On_Component_Init(tObject& entity);
       virtual void On_Component_Render(tObject& entity);
+      virtual void On_Focus_Lost(tObject& entity);
       sRectangle Get_Entity_Dimensions(tObject& entity);
       bool Is_Identifier(char letter);
       virtual void On_Init();
 
   };
 
+  enum eMap_Encoding {
+    eMAP_TEXT,
+    eMAP_COMPACT,
+    eMAP_PACKED
+  };
+
+  enum eMap_Slot {
+    eSLOT_NUMBER,
+    eSLOT_STRING,
+    eSLOT_X,
+    eSLOT_Y,
+    eSLOT_UID
+  };
+
+  const std::string MAP_MAGIC = "CLMAP1";
+  const int MAP_BLOCK_SIZE = 65536;
+  const int MAP_HASH_BITS = 14;
+  const int MAP_WRITE_BUFFER = 65536;
+
+  struct sMap_Slot {
+    int key;
+    eMap_Slot type;
+    long long value;
+  };
+
+  class cMap_Codec {
+
+    public:
+      static eMap_Encoding Read_Map(std::string file_name, std::vector<tObject>& records);
+      static void Write_Map(std::string file_name, std::vector<tObject>& records, eMap_Encoding encoding);
+      static eMap_Encoding Get_Encoding(std::string name);
+      static std::string Encode(std::vector<tObject>& records);
+      static void Decode(const std::string& data, size_t pos, std::vector<tObject>& records);
+      static std::string Compress(const std::string& data);
+      static std::string Decompress(const std::string& data, size_t pos);
+      static void Put_Number(std::string& data, unsigned long long number);
+      static void Put_Signed(std::string& data, long long number);
+      static unsigned long long Get_Number(const std::string& data, size_t& pos);
+      static long long Get_Signed(const std::string& data, size_t& pos);
+      static size_t Get_Count(const std::string& data, size_t& pos, size_t item_size, std::string what);
+      static bool Pack_Uid(const std::string& uid, std::string& packed);
+      static std::string Unpack_Uid(const std::string& data, size_t& pos);
+
+  };
+
+  class cMap_Writer {
+
+    public:
+      std::string file_name;
+      std::string temp_name;
+      std::FILE* file;
+      std::vector<char> buffer;
+      size_t used;
+
+      cMap_Writer(std::string file_name);
+      ~cMap_Writer();
+      void Write(const char* data, size_t length);
+      void Write_Text(const std::string& text);
+      void Write_Number(int number);
+      void Write_Line_Text(const std::string& text);
+      void Write_Object(tObject& object);
+      void Write_Sprite(cSprite& sprite);
+      void Flush();
+      void Commit();
+
+  };
+
+  enum eChange_Type {
+    eCHANGE_ADDED,
+    eCHANGE_REMOVED,
+    eCHANGE_CHANGED,
+    eCHANGE_CONFLICT
+  };
+
+  struct sMap_Record {
+    std::string uid;
+    tObject record;
+  };
+
+  struct sProperty_Change {
+    eChange_Type type;
+    std::string uid;
+    std::string key;
+    bool has_old;
+    bool has_new;
+    cValue old_value;
+    cValue new_value;
+  };
+
+  typedef std::vector<std::pair<std::string, int>> tUid_Index;
+
+  class cMap_Diff {
+
+    public:
+      static void Read_Map(std::string name, std::vector<sMap_Record>& records);
+      static void Write_Map(std::string name, std::vector<sMap_Record>& records);
+      static std::string Get_Uid(tObject& record, std::map<std::string, int>& layer_counts);
+      static void Index(std::vector<sMap_Record>& records, tUid_Index& index);
+      static int Find(tUid_Index& index, std::string& uid);
+      static bool Is_Same_Property(tObject& a, tObject& b, std::string& key);
+      static bool Is_Same_Record(tObject& a, tObject& b);
+      static void Diff_Record(std::string& uid, tObject& a, tObject& b, std::vector<sProperty_Change>& changes);
+      static void Diff(std::vector<sMap_Record>& a, std::vector<sMap_Record>& b, std::vector<sProperty_Change>& changes);
+      static void Merge_Record(sMap_Record& base, sMap_Record& ours, sMap_Record& theirs, sMap_Record& merged, std::vector<sProperty_Change>& conflicts);
+      static void Merge(std::vector<sMap_Record>& base, std::vector<sMap_Record>& ours, std::vector<sMap_Record>& theirs, std::vector<sMap_Record>& merged, std::vector<sProperty_Change>& conflicts);
+      static void Add_Conflict(std::string& uid, std::string key, tObject* ours, tObject* theirs, std::vector<sProperty_Change>& conflicts);
+      static void Write_Changes(std::vector<sProperty_Change>& changes, std::ostream& output);
+
+  };
+
+  struct sInspector_Binding {
+    std::string layer;
+    int index;
+    std::string uid;
+    int revision;
+    int edit_row;
+    std::vector<std::string> keys;
+    std::vector<bool> numbers;
+  };
+
+  struct sMap_Document {
+    std::string name;
+    std::unique_ptr<cHash<std::string, tSprite_List>> sprite_layers;
+    std::unique_ptr<tObject> meta_data;
+    cHistory history;
+    std::vector<sSprite_Ref> selection;
+    std::unordered_map<std::string, cSpatial_Grid> spatial;
+    std::unordered_map<std::string, cZ_Order> z_orders;
+    std::unordered_map<std::string, cTile_Layer> tile_layers;
+    std::vector<sOverlap> overlaps;
+    cArena arena;
+    std::string sel_layer;
+    eMap_Encoding map_encoding;
+    tObject view;
+  };
+
   class cMap_Editor : public cLayout {
     
     public:
+      cArena arena;
       cHash<std::string, tObject> catalog;
-      cHash<std::string, tObject_List> sprite_layers;
-      tObject meta_data;
+      std::unordered_map<std::string, int> catalog_lookup;
+      cCatalog_Index catalog_index;
+      cResource_Loader* loader;
+      cLevel_Index level_index;
+      cHistory history;
+      std::vector<sSprite_Ref> selection;
+      std::unordered_map<std::string, cSpatial_Grid> spatial;
+      std::unordered_map<std::string, cZ_Order> z_orders;
+      std::unordered_map<std::string, cTile_Layer> tile_layers;
+      std::vector<sOverlap> overlaps;
+      cTile_Cache tile_cache;
+      std::unordered_map<std::string, sTiled_Background> tiled_backgrounds;
+      cMemory_Report memory_report;
+      std::mt19937_64 uid_source;
+      std::vector<std::unique_ptr<sMap_Document>> documents;
+      int active_document;
+      eMap_Encoding map_encoding;
+      tJob_Token map_token;
+      sInspector_Binding inspector;
+      int map_revision;
+      int memory_revision;
+      std::chrono::steady_clock::time_point memory_time;
+      std::string memory_text;
+      std::unique_ptr<cHash<std::string, tSprite_List>> sprite_layers; // Held by pointer so switching maps does not copy them.
+      std::unique_ptr<tObject> meta_data;
       std::string sel_layer;
       int sel_sprite;
       std::string sel_sprite_id;
 
-      cMap_Editor(std::string name, std::string config, cIO_Control* io);
+      cMap_Editor(std::string name, std::string config, cIO_Control* io, cResource_Loader* loader);
+      ~cMap_Editor();
       void On_Component_Init(tObject& entity);
       void On_Component_Render(tObject& entity);
       void On_Init();
+      void On_Focus_Lost(tObject& entity);
       void Load_Catalog(std::string name);
       void Load_Map(std::string name);
       void Save_Map(std::string name);
+      void Add_Record(tObject& record, std::map<std::string, int>& layer_counts, std::unordered_set<std::string>& uids);
+      std::string New_Uid();
+      void Get_Map_Records(std::vector<sMap_Record>& records);
+      std::string Get_Map_Hash();
+      void Diff_Map(std::string name, std::vector<sProperty_Change>& changes);
+      void Merge_Map(std::string base, std::string theirs, std::vector<sProperty_Change>& conflicts);
+      sMap_Document* Create_Document(std::string name);
+      void Swap_Document(sMap_Document& document);
+      void Switch_Document(int index);
+      int Open_Map(std::string name);
+      bool Is_Map_Empty();
+      void Close_Document();
+      int Find_Document(std::string name);
       void Init_Field(tObject& entity);
+      void Commit_Field(tObject& entity);
       void Render_Field(tObject& entity);
       void Init_Grid_View(tObject& entity);
       void Render_Grid_View(tObject& entity);
@@ -79,16 +800,233 @@ namespace Codeloader {
       void Render_Map_Editor(tObject& entity);
       void On_List_Click(tObject& entity, std::string text);
       void On_Toolbar_Click(tObject& entity, std::string label);
-      void Load_Object_From_Grid_View(tObject& object, tObject& grid_view);
-      void Save_Object_To_Grid_View(tObject& object, tObject& grid_view);
+      void Sync_Inspector(tObject& grid_view);
+      void Bind_Inspector(tObject& grid_view);
+      void Commit_Inspector_Row(tObject& grid_view);
+      static bool Is_Read_Only_Key(std::string key);
+      bool Find_Sprite(std::string uid, std::string& layer, int& index);
+      static bool Affects_Bounds(std::string key);
       void Update_Sprite_Palette(tObject& toolbar);
-      void Scroll_Component(tObject& entity, sSignal& signal);
+      void Scroll_Component(tObject& entity, sSignal& signal, int repeat);
       void Update_Levels(tObject& list);
       void Select_Sprite(sSignal& signal, tObject& map_editor);
-      sRectangle Parse_Rectangle(std::string text);
+      static sRectangle Parse_Rectangle(std::string text);
       void Render_Sprites(tObject& map_editor);
+      void Render_Background(tObject& map_editor);
+      sTiled_Background* Find_Tiled_Background(std::string name);
+      void Forget_Missing_Backgrounds();
       void Clear_Map();
-      void Destar_Sprite(tObject& sprite);
+      static void Destar_Sprite(tObject& sprite);
+      int Find_Prototype(std::string sprite_id);
+      void Load_Prototype(int proto);
+      void Require_Icon(std::string icon);
+      void Prefetch_Images(std::vector<tObject>& records);
+      cArray<std::string> Get_Used_Sprites(std::string name);
+      cSprite Create_Sprite(tObject& record);
+      int Place_Sprite(cSprite sprite);
+      void Delete_Sprite(std::string layer, int index);
+      void Move_Sprite(std::string layer, int index, int x, int y);
+      void Set_Sprite_Property(std::string layer, int index, std::string key, cValue value);
+      int Change_Sprite_Layer(std::string layer, int index, std::string to_layer);
+      void Set_Meta_Data(std::string key, cValue value);
+      bool Undo();
+      bool Redo();
+      static bool Refers_To_Slot(sEdit& edit);
+      void Drop_Dead_Selection();
+      void Compact_Layers();
+      void Apply_Edit(sEdit& edit, bool forward);
+      tObject& Get_Component(std::string type);
+      void Invalidate_Layer(std::string layer);
+      cSpatial_Grid& Get_Spatial(std::string layer);
+      cZ_Order* Get_Z_Order(std::string layer);
+      void Update_Z_Order(std::string layer, int index);
+      int Find_Layer(std::string layer);
+      void Select_In_Rectangle(sRectangle area, std::string layer_filter, std::string sprite_filter, bool add);
+      void Select_By_Filter(std::string layer_filter, std::string sprite_filter, bool add);
+      void Move_Selection(int dx, int dy);
+      void Duplicate_Selection(int dx, int dy);
+      void Delete_Selection();
+      void Set_Selection_Property(std::string key, cValue value);
+      void Render_Selection(tObject& map_editor);
+      void Render_Outline(sRectangle box, int red, int green, int blue);
+      void Create_Tile_Layer(std::string layer, int cell_w, int cell_h, int columns, int rows);
+      void Edit_Tiles(std::string layer, std::string tool, sRectangle area, int brush);
+      void Render_Tiles(std::string layer, tObject& map_editor);
+      tObject Encode_Tile_Layer(std::string layer);
+      void Decode_Tile_Layer(tObject& record);
+      static void Check_Meta_Data(tObject& meta_data, std::vector<std::string>& problems);
+      static void Check_Sprite_Id(std::string sprite_id, bool in_catalog, std::vector<std::string>& problems);
+      static void Check_Layer(bool has_layer, std::string layer, std::string kind, std::vector<std::string>& problems);
+      static void Check_Tile_Layer(tObject& record, std::function<bool(const std::string&)> in_catalog, std::vector<std::string>& problems);
+      static void Check_Problems(std::vector<std::string>& problems);
+      int Analyze_Overlaps();
+      void Collect_Boxes(cOverlap_Finder& finder);
+      void Start_Overlap_Analysis(tObject& button);
+      void Cancel_Map_Jobs();
+      void Render_Overlaps(tObject& map_editor);
+      void Set_Zoom(tObject& map_editor, int zoom);
+      sPoint To_World(tObject& map_editor, sPoint view);
+      sRectangle To_View(tObject& map_editor, sRectangle world);
+      static int Scale_Size(int size, int zoom);
+      std::string Get_Zoomed_Icon(std::string icon, int zoom);
+      int Measure_Object(tObject& object);
+      std::string Get_Sprite_Memory_Report();
+      cMemory_Report& Update_Memory_Report();
+      std::string Run_Command(std::string line, bool& quit);
+      void Render_Memory_Panel(tObject& map_editor);
+
+  };
+
+  struct sMap_Issue {
+    int sprite;
+    std::string message;
+  };
+
+  struct sCheck_Result {
+    std::string file;
+    int sprite_count;
+    bool converted;
+    std::vector<sMap_Issue> issues;
+    std::vector<sOverlap> overlaps;
+  };
+
+  class cMap_Checker {
+
+    public:
+      std::unordered_map<std::string, tObject> catalog;
+      std::unordered_map<std::string, std::vector<std::string>> icon_sprites;
+      std::unordered_map<std::string, std::string> images;
+      std::string resource_folder;
+      std::string tile_folder;
+      std::string convert_folder;
+      bool find_overlaps;
+      int map_width;
+      int map_height;
+
+      cMap_Checker(std::string layout, std::string config, std::string resource_folder);
+      sCheck_Result Load_Catalog(std::string name);
+      sCheck_Result Check_Map(std::string file);
+      tObject Convert_Record(tObject& record);
+      void Run(cArray<std::string>& files, int worker_count, std::ostream& output);
+      void Add_Issues(int sprite, std::vector<std::string>& problems, sCheck_Result& result);
+      void Write_Result(sCheck_Result& result, std::ostream& output);
+      static bool Read_Image_Size(std::string path, int& width, int& height);
+      static std::string Escape_Json(std::string text);
+
+  };
+
+  class cHeadless_IO : public cIO_Control {
+
+    public:
+      std::unordered_map<std::string, sPoint> image_sizes;
+      int draw_count;
+
+      cHeadless_IO();
+      void Load_Image_Sizes(std::string folder);
+      void Color(int red, int green, int blue) override;
+      void Refresh() override;
+      sSignal Read_Signal() override;
+      sSignal Read_Key() override;
+      void Draw_Image(std::string name, int x, int y, int width, int height, int angle, bool h_flip, bool v_flip) override;
+      int Get_Image_Width(std::string name) override;
+      int Get_Image_Height(std::string name) override;
+      void Box(int x, int y, int width, int height, int red, int green, int blue) override;
+      void Output_Text(std::string text, int x, int y, int red, int green, int blue) override;
+      int Get_Text_Width(std::string text) override;
+      int Get_Text_Height(std::string text) override;
+
+  };
+
+  struct sReplay_Frame {
+    double time_ms;
+    std::deque<sSignal> mouse;
+    std::deque<sSignal> keys;
+    std::vector<std::string> commands;
+  };
+
+  class cReplay_IO : public cHeadless_IO {
+
+    public:
+      std::vector<sReplay_Frame> frames;
+      int frame;
+
+      cReplay_IO(std::string name);
+      void Refresh() override;
+      sSignal Read_Signal() override;
+      sSignal Read_Key() override;
+      bool Has_More_Frames();
+
+  };
+
+  const int OVERLAP_BENCH_SPRITES = 200000;
+  const double OVERLAP_BENCH_BUDGET_MS = 1000.0;
+  const int OVERLAP_BENCH_WORLD = 16384; // Size of a large level, not one screen.
+
+  struct sBenchmark_Result {
+    std::string name;
+    int size;
+    int runs;
+    double best_ms;
+    double mean_ms;
+    long long allocations;
+    double budget_ms;
+  };
+
+  class cBenchmark {
+
+    public:
+      std::string folder;
+      int runs;
+      unsigned int seed;
+      cHeadless_IO io;
+      std::vector<sBenchmark_Result> results;
+
+      cBenchmark(std::string folder, int runs);
+      void Time(std::string name, int size, int runs, std::function<void()> job);
+      void Time(std::string name, int size, int runs, std::function<void()> setup, std::function<void()> job);
+      int Random(int limit);
+      std::string Generate_Layout(int component_count);
+      std::string Generate_Catalog(int prototype_count);
+      void Generate_Map(cMap_Editor& editor, int sprite_count, int prototype_count, int width, int height);
+      void Run_Layouts(std::vector<int>& sizes);
+      void Run_Maps(std::vector<int>& sizes);
+      void Check_Round_Trip(cMap_Editor& editor, std::string map_name);
+      void Run_Overlaps(int sprite_count, double budget_ms);
+      void Write_Results(std::ostream& output);
+
+  };
+
+  const int COMMAND_BATCH = 64; // Commands taken at once without a window.
+  const int COMMAND_FRAME_MS = 8;
+  const int COMMAND_POLL_MS = 100; // How often readers check for a stop.
+
+  struct sCommand {
+    std::string line;
+    int client;
+    bool end;
+  };
+
+  class cCommand_Pipe {
+
+    public:
+      std::deque<sCommand> commands;
+      std::mutex lock;
+      std::condition_variable command_ready;
+      int listener;
+      std::string socket_path;
+      bool closed;
+      std::atomic<bool> stopping;
+      std::vector<std::thread> readers;
+
+      cCommand_Pipe();
+      ~cCommand_Pipe();
+      void Open_Stdin();
+      void Open_Socket(std::string path);
+      bool Read_Lines(int source, int client);
+      void Read_Socket();
+      void Push(std::string line, int client, bool end);
+      bool Take_Commands(std::vector<sCommand>& batch, bool wait, int limit);
+      void Reply(sCommand& command, std::string reply);
 
   };
 